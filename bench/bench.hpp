@@ -0,0 +1,64 @@
+// Scaffolding shared by the benchmarks, each of which is built as its own executable.
+
+#ifndef _QUETZALCOATL_BENCH_BENCH_HPP
+#define _QUETZALCOATL_BENCH_BENCH_HPP
+
+#include "frontend/source_buffer.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <utility>
+#include <cstddef>
+#include <cstdlib>
+
+// Runs f the given number of times and returns the time of the fastest run in seconds.
+template <typename F>
+double measure(F&& f, size_t repeats) {
+    auto best = std::chrono::duration<double>::max();
+    for(size_t i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        if(elapsed < best)
+            best = elapsed;
+    }
+    return best.count();
+}
+
+// Results of measured work are stored here, so that the work is not optimized out.
+inline volatile size_t sink;
+
+inline void keep(size_t value) {
+    sink = value;
+}
+
+inline double nsPer(double seconds, size_t count) {
+    return seconds * 1e9 / count;
+}
+
+inline double megabytesPerSecond(size_t bytes, double seconds) {
+    return bytes / seconds / 1e6;
+}
+
+// Stream to print results to, with times and rates rounded to two decimals.
+inline std::ostream& report() {
+    return std::cout << std::fixed << std::setprecision(2);
+}
+
+// The file named by the first argument if there is one, otherwise the source returned by
+// generate. Exits if the file cannot be opened.
+template <typename F>
+SourceBuffer loadSource(int argc, char* argv[], F&& generate) {
+    if(argc <= 1)
+        return SourceBuffer(generate());
+
+    auto buffer = SourceBuffer::open(argv[1]);
+    if(!buffer) {
+        std::cerr << "could not open " << argv[1] << std::endl;
+        std::exit(1);
+    }
+    return std::move(*buffer);
+}
+
+#endif
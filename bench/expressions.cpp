@@ -0,0 +1,201 @@
+// Benchmark for the expression parser. Parses a pre-lexed source made of return
+// statements with operators of every precedence level, both by recursive descent and
+// iteratively, and checks that both build the same tree. A digest of the tree is printed
+// so that changes to the parser can be checked to build the same one too. Then parses
+// deeply nested input iteratively, and statements starting with identifiers, which are parsed
+// tentatively as declarations first. A file to parse may be given as the argument, otherwise
+// a synthetic source is generated.
+
+#include "parser/parser.hpp"
+#include "lexer/lexer.hpp"
+#include "frontend/compile_info.hpp"
+#include "frontend/source_buffer.hpp"
+#include "frontend/ast.hpp"
+#include "bench.hpp"
+
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+namespace {
+    const char* const BINARY_OPERATORS[] = {
+        ".*", "->*", "*", "/", "%", "+", "-", "<<", ">>", "<", ">", "<=", ">=",
+        "==", "!=", "&", "^", "|", "&&", "||", "=", "+=", "<<=", "|=", ",",
+    };
+
+    const char* const PREFIX_OPERATORS[] = {
+        "- ", "+ ", "!", "~", "* ", "& ", "++ ", "-- ", "sizeof ",
+    };
+
+    void makeExpr(std::string& source, size_t depth, std::mt19937& rng) {
+        if(depth == 0 || rng() % 8 == 0) {
+            source += std::to_string(rng() % 1000);
+            return;
+        }
+
+        switch(rng() % 16) {
+            case 0:
+                source += PREFIX_OPERATORS[rng() % std::size(PREFIX_OPERATORS)];
+                makeExpr(source, depth - 1, rng);
+                break;
+            case 1:
+                source += '(';
+                makeExpr(source, depth - 1, rng);
+                source += ')';
+                break;
+            case 2:
+                makeExpr(source, depth - 1, rng);
+                source += " ? ";
+                makeExpr(source, depth - 1, rng);
+                source += " : ";
+                makeExpr(source, depth - 1, rng);
+                break;
+            case 3:
+                source += '(';
+                makeExpr(source, depth - 1, rng);
+                source += ")[";
+                makeExpr(source, depth - 1, rng);
+                source += "]++";
+                break;
+            default:
+                makeExpr(source, depth - 1, rng);
+                source += ' ';
+                source += BINARY_OPERATORS[rng() % std::size(BINARY_OPERATORS)];
+                source += ' ';
+                makeExpr(source, depth - 1, rng);
+                break;
+        }
+    }
+
+    std::string makeSource(size_t count, std::mt19937& rng) {
+        std::string source;
+        for(size_t i = 0; i < count; ++i) {
+            source += "return ";
+            makeExpr(source, 6, rng);
+            source += ";\n";
+        }
+        return source;
+    }
+
+    // Declarations and expression statements that start the same way, so that some of the
+    // tentative parses backtrack
+    std::string makeStatements(size_t count, std::mt19937& rng) {
+        const char* const starts[] = {"T x", "T * x", "T (x)", "T x[4]", "a * b", "a = b", "f(a)", "a[1]"};
+        std::string source;
+        for(size_t i = 0; i < count; ++i) {
+            source += starts[rng() % std::size(starts)];
+            source += " = (";
+            makeExpr(source, 3, rng);
+            source += ");\n";
+        }
+        return source;
+    }
+
+    // Nested constructs repeated `depth` times
+    std::string makeNested(const char* prefix, const char* open, const char* inner, const char* close, size_t depth) {
+        std::string source = prefix;
+        for(size_t i = 0; i < depth; ++i)
+            source += open;
+        source += inner;
+        for(size_t i = 0; i < depth; ++i)
+            source += close;
+        return source;
+    }
+
+    // Hash of the nodes in pre-order with their number of children, which determines the shape of
+    // the tree. Nodes are visited without recursion, as deep input builds deep trees.
+    uint64_t digest(const AstTable& ast, size_t root) {
+        uint64_t result = 0xcbf29ce484222325;
+        std::vector<size_t> pending = {root};
+        while(!pending.empty()) {
+            const AstNode& node = ast.getNode(pending.back());
+            pending.pop_back();
+            result = (result ^ (uint64_t(node.type) << 32 | node.children.size())) * 0x100000001b3;
+            for(auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+                if(*it != INVALID_ASTNODE_ID)
+                    pending.push_back(*it);
+            }
+        }
+        return result;
+    }
+
+    struct Result {
+        double time;
+        uint64_t digest;
+        Parser::Stats stats;
+    };
+
+    Result parse(const SourceBuffer& buffer, bool iterative, size_t repeats) {
+        CompileInfo compile_info;
+        Lexer lexer(buffer, compile_info);
+        TokenBuffer tokens = lexer.lexAll();
+
+        std::optional<AstTable> ast;
+        size_t root = 0;
+        Parser::Stats stats = {};
+        double time = measure([&] {
+            ast.emplace();
+            Parser parser(tokens, compile_info, *ast);
+            parser.setIterative(iterative);
+            root = parser.parse();
+            stats = parser.stats();
+        }, repeats);
+
+        if(!compile_info.diagnostics.messages().empty()) {
+            compile_info.printDiagnostics(std::cerr, false);
+            std::exit(1);
+        }
+        return {nsPer(time, tokens.size()), digest(*ast, root), stats};
+    }
+}
+
+int main(int argc, char* argv[]) {
+    SourceBuffer buffer = loadSource(argc, argv, [] {
+        std::mt19937 rng(42);
+        return makeSource(20000, rng);
+    });
+
+    Result recursive = parse(buffer, false, 10);
+    Result iterative = parse(buffer, true, 10);
+    if(recursive.digest != iterative.digest) {
+        std::cerr << "iterative parser built a different tree" << std::endl;
+        return 1;
+    }
+
+    report() << "digest " << std::hex << recursive.digest << std::dec << '\n'
+        << "recursive: " << recursive.time << " ns/token\n"
+        << "iterative: " << iterative.time << " ns/token\n";
+
+    std::mt19937 rng(42);
+    SourceBuffer statements(makeStatements(20000, rng));
+    Result tentative = parse(statements, false, 10);
+    if(parse(statements, true, 1).digest != tentative.digest) {
+        std::cerr << "iterative parser built a different tree" << std::endl;
+        return 1;
+    }
+    std::cout << "declarations: " << tentative.time << " ns/token, "
+        << tentative.stats.backtracks << " of " << tentative.stats.tentative_parses << " tentative parses backtracked, "
+        << tentative.stats.backtracked_tokens << " tokens read again\n";
+
+    // Too deep for the recursive parser
+    constexpr const size_t DEPTH = 100000;
+    const std::pair<const char*, std::string> nested[] = {
+        {"parentheses", makeNested("return ", "(", "1", ")", DEPTH) + ";"},
+        {"prefix operators", makeNested("return ", "- ", "1", "", DEPTH) + ";"},
+        {"assignments", makeNested("return ", "1 = ", "1", "", DEPTH) + ";"},
+        {"conditionals", makeNested("return ", "1 ? 1 : ", "1", "", DEPTH) + ";"},
+        {"blocks", makeNested("", "{", "", "}", DEPTH)},
+        {"else if chain", makeNested("", "if(1) ; else ", ";", "", DEPTH)},
+    };
+    for(const auto& [name, source] : nested) {
+        SourceBuffer nested_buffer(source);
+        std::cout << "iterative, " << DEPTH << " nested " << name << ": "
+            << parse(nested_buffer, true, 3).time << " ns/token\n";
+    }
+    return 0;
+}
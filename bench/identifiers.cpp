@@ -0,0 +1,161 @@
+// Micro-benchmark for identifier lexing. Pure ASCII identifiers should take the table
+// based fast path at the same cost as before Unicode identifiers were supported, while
+// identifiers with non-ASCII characters go through the two-stage XID tables. As a baseline
+// for ASCII input, the identifier loop of the lexer before Unicode identifiers is timed
+// against the current one on the same source.
+
+#include "lexer/lexer.hpp"
+#include "frontend/compile_info.hpp"
+#include "frontend/source_buffer.hpp"
+#include "unicode.hpp"
+#include "bench.hpp"
+
+#include <array>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+    const char* const ASCII_IDENTIFIERS[] = {
+        "i", "x", "n", "buf", "size", "count", "value", "result", "node", "next", "prev", "index",
+        "data_ptr", "m_length", "kMaxEntries", "parse_header", "TokenBuffer", "assign_impl",
+        "__builtin_expect", "_M_impl", "std_allocator_traits", "very_long_generated_identifier_name_0",
+    };
+
+    const char* const UNICODE_IDENTIFIERS[] = {
+        "café", "naïve", "größe", "αβγ", "Δx", "λ", "переменная", "значение", "変数", "結果",
+        "데이터", "מספר", "résumé_count", "ωmega", "x_ñ", "𝐀𝐁",
+    };
+
+    constexpr std::array<bool, 256> buildIdChars() {
+        std::array<bool, 256> result = {};
+        for(int c = 0; c < 256; ++c)
+            result[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        return result;
+    }
+
+    constexpr const std::array<bool, 256> ID_CHARS = buildIdChars();
+
+    // Decodes a valid UTF-8 sequence of 2 to 4 bytes and returns its length.
+    size_t decode(const unsigned char* p, uint32_t& cp) {
+        size_t length = p[0] >= 0xF0 ? 4 : p[0] >= 0xE0 ? 3 : 2;
+        cp = p[0] & (0x7F >> length);
+        for(size_t i = 1; i < length; ++i)
+            cp = (cp << 6) | (p[i] & 0x3F);
+        return length;
+    }
+
+    // The identifier loop of the lexer before Unicode identifiers. Returns the number of
+    // identifiers in a source of identifiers separated by spaces.
+    size_t scanAsciiIdentifiers(const std::string& source) {
+        auto p = reinterpret_cast<const unsigned char*>(source.c_str());
+        size_t ids = 0;
+        while(*p) {
+            while(*p == ' ')
+                ++p;
+            if(!*p)
+                break;
+            while(ID_CHARS[*p])
+                ++p;
+            ++ids;
+        }
+        return ids;
+    }
+
+    // The identifier loop of the lexer now, where only bytes of 0x80 and above leave the table
+    // based loop for a Unicode lookup.
+    size_t scanIdentifiers(const std::string& source) {
+        auto p = reinterpret_cast<const unsigned char*>(source.c_str());
+        size_t ids = 0;
+        while(*p) {
+            while(*p == ' ')
+                ++p;
+            if(!*p)
+                break;
+            while(true) {
+                while(ID_CHARS[*p])
+                    ++p;
+                if(*p < 0x80)
+                    break;
+                uint32_t cp;
+                size_t length = decode(p, cp);
+                if(!CodePoint{cp}.isXidContinue())
+                    break;
+                p += length;
+            }
+            ++ids;
+        }
+        return ids;
+    }
+
+    std::string makeSource(const char* const* words, size_t num_words, size_t count, std::mt19937& rng) {
+        std::string source;
+        for(size_t i = 0; i < count; ++i) {
+            source += words[rng() % num_words];
+            source += ' ';
+        }
+        return source;
+    }
+
+    void run(const char* name, const std::string& source, size_t count) {
+        SourceBuffer buffer(source);
+
+        double lex_time = measure([&] {
+            CompileInfo compile_info;
+            Lexer lexer(buffer, compile_info);
+            size_t ids = 0;
+            for(Token token = lexer.lex(); token.type != TokenType::EOI; token = lexer.lex()) {
+                if(token.type != TokenType::ID) {
+                    std::cerr << "unexpected token " << tokenTypeToString(token.type) << std::endl;
+                    std::exit(1);
+                }
+                ++ids;
+            }
+            keep(ids);
+        }, 10);
+
+        report() << name << ":\n"
+            << "  lexer throughput: " << megabytesPerSecond(source.size(), lex_time) << " MB/s, "
+            << nsPer(lex_time, count) << " ns/identifier\n";
+    }
+
+    void runBaseline(const std::string& source, size_t count) {
+        if(scanAsciiIdentifiers(source) != count || scanIdentifiers(source) != count) {
+            std::cerr << "identifier loops found a different number of identifiers" << std::endl;
+            std::exit(1);
+        }
+
+        double ascii_time = measure([&] { keep(scanAsciiIdentifiers(source)); }, 10);
+        double unicode_time = measure([&] { keep(scanIdentifiers(source)); }, 10);
+
+        report() << "ASCII identifier loops:\n"
+            << "  before Unicode identifiers: " << nsPer(ascii_time, count) << " ns/identifier\n"
+            << "  with Unicode identifiers:   " << nsPer(unicode_time, count) << " ns/identifier\n";
+    }
+
+    void runLookup() {
+        constexpr uint32_t CODE_POINTS = 0x30000;
+        double time = measure([&] {
+            size_t matches = 0;
+            for(uint32_t cp = 0; cp < CODE_POINTS; ++cp)
+                matches += CodePoint{cp}.isXidContinue();
+            keep(matches);
+        }, 20);
+
+        report() << "XID_Continue lookup: " << nsPer(time, CODE_POINTS) << " ns/code point\n";
+    }
+}
+
+int main() {
+    constexpr size_t WORDS = 2000000;
+
+    std::mt19937 rng(42);
+    std::string ascii = makeSource(ASCII_IDENTIFIERS, std::size(ASCII_IDENTIFIERS), WORDS, rng);
+    run("ASCII identifiers", ascii, WORDS);
+    runBaseline(ascii, WORDS);
+    run("Unicode identifiers", makeSource(UNICODE_IDENTIFIERS, std::size(UNICODE_IDENTIFIERS), WORDS, rng), WORDS);
+    runLookup();
+    return 0;
+}
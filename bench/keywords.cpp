@@ -0,0 +1,135 @@
+// Micro-benchmark for keyword recognition. Compares the perfect hash used by the
+// lexer against the std::unordered_map lookup it replaced, both on the bare lookup
+// and on lexing a whole keyword-dense or identifier-dense input.
+
+#include "lexer/lexer.hpp"
+#include "lexer/keywords.hpp"
+#include "frontend/compile_info.hpp"
+#include "frontend/source_buffer.hpp"
+#include "bench.hpp"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+    const std::unordered_map<std::string_view, TokenType> MAP_KEYWORD_TYPES = {
+        {"and", TokenType::AND}, {"and_eq", TokenType::BITAND_ASSIGN}, {"asm", TokenType::KEY_ASM},
+        {"auto", TokenType::KEY_AUTO}, {"bitand", TokenType::BITAND}, {"bitor", TokenType::BITOR},
+        {"bool", TokenType::KEY_BOOL}, {"break", TokenType::KEY_BREAK}, {"case", TokenType::KEY_CASE},
+        {"class", TokenType::KEY_CLASS}, {"compl", TokenType::BITNOT}, {"const", TokenType::KEY_CONST},
+        {"const_cast", TokenType::KEY_CONST_CAST}, {"continue", TokenType::KEY_CONTINUE},
+        {"default", TokenType::KEY_DEFAULT}, {"delete", TokenType::KEY_DELETE}, {"do", TokenType::KEY_DO},
+        {"double", TokenType::KEY_DOUBLE}, {"dynamic_cast", TokenType::KEY_DYNAMIC_CAST},
+        {"else", TokenType::KEY_ELSE}, {"enum", TokenType::KEY_ENUM}, {"explicit", TokenType::KEY_EXPLICIT},
+        {"export", TokenType::KEY_EXPORT}, {"extern", TokenType::KEY_EXTERN}, {"false", TokenType::KEY_FALSE},
+        {"float", TokenType::KEY_FLOAT}, {"for", TokenType::KEY_FOR}, {"friend", TokenType::KEY_FRIEND},
+        {"goto", TokenType::KEY_GOTO}, {"if", TokenType::KEY_IF}, {"inline", TokenType::KEY_INLINE},
+        {"int", TokenType::KEY_INT}, {"long", TokenType::KEY_LONG}, {"mutable", TokenType::KEY_MUTABLE},
+        {"namespace", TokenType::KEY_NAMESPACE}, {"new", TokenType::KEY_NEW}, {"not", TokenType::NOT},
+        {"not_eq", TokenType::NOTEQUAL}, {"operator", TokenType::KEY_OPERATOR}, {"or", TokenType::OR},
+        {"or_eq", TokenType::BITOR_ASSIGN}, {"private", TokenType::KEY_PRIVATE},
+        {"protected", TokenType::KEY_PROTECTED}, {"public", TokenType::KEY_PUBLIC},
+        {"register", TokenType::KEY_REGISTER}, {"reinterpret_cast", TokenType::KEY_REINTERPRET_CAST},
+        {"return", TokenType::KEY_RETURN}, {"short", TokenType::KEY_SHORT}, {"signed", TokenType::KEY_SIGNED},
+        {"sizeof", TokenType::KEY_SIZEOF}, {"static", TokenType::KEY_STATIC},
+        {"static_cast", TokenType::KEY_STATIC_CAST}, {"struct", TokenType::KEY_STRUCT},
+        {"switch", TokenType::KEY_SWITCH}, {"template", TokenType::KEY_TEMPLATE}, {"this", TokenType::KEY_THIS},
+        {"throw", TokenType::KEY_THROW}, {"true", TokenType::KEY_TRUE}, {"try", TokenType::KEY_TRY},
+        {"typedef", TokenType::KEY_TYPEDEF}, {"typeid", TokenType::KEY_TYPEID},
+        {"typename", TokenType::KEY_TYPENAME}, {"union", TokenType::KEY_UNION},
+        {"unsigned", TokenType::KEY_UNSIGNED}, {"using", TokenType::KEY_USING},
+        {"virtual", TokenType::KEY_VIRTUAL}, {"void", TokenType::KEY_VOID},
+        {"volatile", TokenType::KEY_VOLATILE}, {"wchar_t", TokenType::KEY_WCHAR_T},
+        {"while", TokenType::KEY_WHILE}, {"xor", TokenType::XOR}, {"xor_eq", TokenType::XOR_ASSIGN},
+    };
+
+    const char* const IDENTIFIERS[] = {
+        "i", "x", "n", "buf", "size", "count", "value", "result", "node", "next", "prev", "index",
+        "data_ptr", "m_length", "kMaxEntries", "parse_header", "TokenBuffer", "assign_impl",
+        "constant", "doubled", "intern", "forward", "iffy", "returned", "struct_size", "template_args",
+        "__builtin_expect", "_M_impl", "std_allocator_traits", "very_long_generated_identifier_name_0",
+    };
+
+    TokenType mapLookup(std::string_view id) {
+        if(MAP_KEYWORD_TYPES.count(id) > 0)
+            return MAP_KEYWORD_TYPES.at(id);
+        return TokenType::ID;
+    }
+
+    std::vector<std::string> makeWords(size_t count, double keyword_ratio, std::mt19937& rng) {
+        std::vector<std::string_view> keywords;
+        for(const auto& [keyword, type] : MAP_KEYWORD_TYPES)
+            keywords.push_back(keyword);
+
+        std::uniform_real_distribution<double> coin(0, 1);
+        std::vector<std::string> words;
+        words.reserve(count);
+        for(size_t i = 0; i < count; ++i) {
+            if(coin(rng) < keyword_ratio)
+                words.emplace_back(keywords[rng() % keywords.size()]);
+            else
+                words.emplace_back(IDENTIFIERS[rng() % std::size(IDENTIFIERS)]);
+        }
+        return words;
+    }
+
+    void run(const char* name, const std::vector<std::string>& words) {
+        std::vector<std::string_view> views(words.begin(), words.end());
+        std::string source;
+        for(const auto& word : words) {
+            source += word;
+            source += ' ';
+        }
+        SourceBuffer buffer(source);
+
+        for(auto view : views) {
+            if(mapLookup(view) != lookupKeyword(view)) {
+                std::cerr << "mismatch on " << view << std::endl;
+                std::exit(1);
+            }
+        }
+
+        double map_time = measure([&] {
+            size_t keywords = 0;
+            for(auto view : views)
+                keywords += mapLookup(view) != TokenType::ID;
+            keep(keywords);
+        }, 10);
+
+        double hash_time = measure([&] {
+            size_t keywords = 0;
+            for(auto view : views)
+                keywords += lookupKeyword(view) != TokenType::ID;
+            keep(keywords);
+        }, 10);
+
+        double lex_time = measure([&] {
+            CompileInfo compile_info;
+            Lexer lexer(buffer, compile_info);
+            size_t tokens = 0;
+            while(lexer.lex().type != TokenType::EOI)
+                ++tokens;
+            keep(tokens);
+        }, 10);
+
+        report() << name << ":\n"
+            << "  unordered_map lookup: " << nsPer(map_time, views.size()) << " ns/identifier\n"
+            << "  perfect hash lookup:  " << nsPer(hash_time, views.size()) << " ns/identifier\n"
+            << "  lexer throughput:     " << megabytesPerSecond(source.size(), lex_time) << " MB/s, "
+            << nsPer(lex_time, views.size()) << " ns/identifier\n";
+    }
+}
+
+int main() {
+    constexpr size_t WORDS = 2000000;
+
+    std::mt19937 rng(42);
+    run("keyword-dense (80% keywords)", makeWords(WORDS, 0.8, rng));
+    run("identifier-dense (10% keywords)", makeWords(WORDS, 0.1, rng));
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Benchmark for the kinds-only lexer. Lexes the same source with the default lexer and
+// with one that has locations, raw token text and diagnostics compiled out, and checks
+// that both produce the same token kinds. A file to lex may be given as the argument,
+// otherwise a synthetic preprocessed source is generated.
+
+#include "lexer/lexer.hpp"
+#include "frontend/compile_info.hpp"
+#include "frontend/source_buffer.hpp"
+#include "bench.hpp"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+    const char* const FRAGMENTS[] = {
+        "int", "unsigned", "return", "if", "else", "while", "for", "const", "static", "struct",
+        "x", "buf", "count", "result", "next_node", "TokenBuffer", "__builtin_expect",
+        "0", "1", "42", "0x7fff", "1000000ULL", "3.25", "1e-9", "'a'", "\"text\"", "\"\\n\"",
+        "(", ")", "{", "}", "[", "]", ";", ",", "=", "==", "+", "+=", "->", "<<", "&&", "::", "...",
+        "/* comment */", "// line comment\n",
+    };
+
+    std::string makeSource(size_t count, std::mt19937& rng) {
+        std::string source;
+        for(size_t i = 0; i < count; ++i) {
+            if(i % 1000 == 0)
+                source += "# " + std::to_string(i) + " \"header.h\"\n";
+            source += FRAGMENTS[rng() % std::size(FRAGMENTS)];
+            source += i % 12 == 11 ? '\n' : ' ';
+        }
+        return source;
+    }
+
+    template <typename Policy>
+    std::vector<TokenType> lexKinds(const SourceBuffer& buffer) {
+        CompileInfo compile_info;
+        BasicLexer<Policy> lexer(buffer, compile_info);
+        std::vector<TokenType> kinds;
+        for(Token token = lexer.lex(); token.type != TokenType::EOI; token = lexer.lex())
+            kinds.push_back(token.type);
+        return kinds;
+    }
+
+    template <typename Policy>
+    void run(const char* name, const SourceBuffer& buffer, size_t num_tokens) {
+        double time = measure([&] {
+            CompileInfo compile_info;
+            BasicLexer<Policy> lexer(buffer, compile_info);
+            size_t tokens = 0;
+            for(Token token = lexer.lex(); token.type != TokenType::EOI; token = lexer.lex())
+                tokens += size_t(token.type);
+            keep(tokens);
+        }, 10);
+
+        report() << name << ": " << megabytesPerSecond(buffer.contents().size(), time) << " MB/s, "
+            << nsPer(time, num_tokens) << " ns/token\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    SourceBuffer buffer = loadSource(argc, argv, [] {
+        std::mt19937 rng(42);
+        return makeSource(4000000, rng);
+    });
+
+    auto kinds = lexKinds<DefaultLexerPolicy>(buffer);
+    if(lexKinds<KindsOnlyLexerPolicy>(buffer) != kinds) {
+        std::cerr << "kinds-only lexer produced different tokens" << std::endl;
+        return 1;
+    }
+
+    run<DefaultLexerPolicy>("default", buffer, kinds.size());
+    run<KindsOnlyLexerPolicy>("kinds only", buffer, kinds.size());
+    return 0;
+}
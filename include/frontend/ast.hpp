@@ -7,6 +7,8 @@
 #include <initializer_list>
 #include <limits>
 #include <memory>
+#include <string>
+#include <string_view>
 
 #include "frontend/type.hpp"
 
@@ -81,7 +83,35 @@ enum class AstNodeType {
     POINTER_TO_MEMBER_EXPR,
     INDIRECT_POINTER_TO_MEMBER_EXPR,
 
-    INTEGER_CONSTANT
+    INTEGER_CONSTANT,
+
+    // In place of what could not be parsed
+    ERROR_EXPR,
+    ERROR_STAT,
+
+    IDENTIFIER_EXPR,
+
+    // A declaration has its specifiers and then an init declarator for every name it declares
+    SIMPLE_DECL,
+    DECL_SPECIFIERS,
+    TYPE_NAME,
+    INIT_DECLARATOR,
+    NAME_DECLARATOR,
+    POINTER_DECLARATOR,
+    REFERENCE_DECLARATOR,
+    ARRAY_DECLARATOR
+};
+
+// Specifiers of a declaration apart from its type, kept as the integer of the DECL_SPECIFIERS
+// node. POINTER_DECLARATOR nodes keep their qualifiers the same way.
+enum DeclSpecifier : uint64_t {
+    DECL_CONST = 1 << 0,
+    DECL_VOLATILE = 1 << 1,
+    DECL_TYPEDEF = 1 << 2,
+    DECL_STATIC = 1 << 3,
+    DECL_EXTERN = 1 << 4,
+    DECL_REGISTER = 1 << 5,
+    DECL_MUTABLE = 1 << 6
 };
 
 struct AstNode {
@@ -101,6 +131,14 @@ struct IntegerAstNode : public AstNode {
     IntegerAstNode(AstNodeType, const std::vector<size_t>&, TypeId, uint64_t);
 };
 
+// Names are kept by the node rather than in the string table, as the parser may run alongside
+// the lexer filling that, and so that names of nodes dropped on backtracking go with them.
+struct NameAstNode : public AstNode {
+    std::string name;
+
+    NameAstNode(AstNodeType, TypeId, std::string_view);
+};
+
 struct SwitchAstNode : public AstNode {
     size_t default_id;
     std::vector<size_t> case_nodes;
@@ -121,6 +159,12 @@ public:
     size_t addNode(AstNodeType, TypeId, const std::vector<size_t>&);
     size_t addIntegerNode(AstNodeType, TypeId, uint64_t);
     size_t addSwitchNode(AstNodeType);
+    size_t addNameNode(AstNodeType, std::string_view);
+
+    // Nodes are numbered in the order they are added, so the number of nodes is the id the
+    // next one gets. Truncating drops the nodes added since there were that many.
+    size_t size() const;
+    void truncate(size_t);
 
     AstNode& getNode(size_t);
     const AstNode& getNode(size_t) const;
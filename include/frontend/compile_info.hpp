@@ -6,11 +6,13 @@
 
 #include "frontend/type.hpp"
 #include "frontend/filetable.hpp"
+#include "frontend/source_map.hpp"
 #include "frontend/stringtable.hpp"
 #include "frontend/diagnostics.hpp"
 
 struct CompileInfo {
     FileTable files;
+    SourceMap sources;
     TypeTable types;
     StringTable strings;
     Diagnostics diagnostics;
@@ -31,6 +31,12 @@ public:
     void error(SourceLocation loc, std::string_view msg);
     void warning(SourceLocation loc, std::string_view msg);
     void note(SourceLocation loc, std::string_view msg);
+    void add(const Diagnostic&);
+    // Orders the messages by location, keeping the order of messages at the same location.
+    // Only gives source order for locations in a single buffer.
+    void sortByLocation();
+    // Removes the messages at locations after the given one in the same buffer.
+    void dropAfter(SourceLocation);
 
     std::span<const Diagnostic> messages() const;
 };
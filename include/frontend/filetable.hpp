@@ -4,16 +4,21 @@
 #include <string>
 #include <string_view>
 #include <cstddef>
-#include <vector>
+#include <deque>
 #include <unordered_map>
 
 class FileTable {
 private:
-    std::vector<std::string> files;
+    // A deque keeps the strings in place, so the views used as lookup keys stay valid.
+    std::deque<std::string> files;
     std::unordered_map<std::string_view, size_t> index_lookup;
 public:
     size_t addFile(std::string_view);
     std::string_view getFile(size_t) const;
+
+    inline size_t size() const {
+        return this->files.size();
+    }
 };
 
 #endif
@@ -0,0 +1,11 @@
+#ifndef _QUETZALCOATL_FRONTEND_HASH_HPP
+#define _QUETZALCOATL_FRONTEND_HASH_HPP
+
+#include <string_view>
+#include <cstdint>
+
+// Fast 64-bit hash of a byte string, for detecting changed contents. Not suitable for
+// hash tables keyed by untrusted input, and not stable across versions of the compiler.
+uint64_t hashBytes(std::string_view, uint64_t seed = 0);
+
+#endif
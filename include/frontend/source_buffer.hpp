@@ -0,0 +1,41 @@
+#ifndef _QUETZALCOATL_FRONTEND_SOURCE_BUFFER_HPP
+#define _QUETZALCOATL_FRONTEND_SOURCE_BUFFER_HPP
+
+#include <string_view>
+#include <optional>
+#include <memory>
+#include <cstddef>
+
+// Read-only view of a source file, followed by at least PADDING zero bytes.
+// The first padding byte acts as a sentinel so the lexer can detect the end of
+// input without a bounds check, and the rest allows vector loads to run past
+// the end of the contents.
+class SourceBuffer {
+private:
+    const char* data;
+    size_t size;
+
+    void* mapping;
+    size_t mapping_size;
+    std::unique_ptr<char[]> owned;
+
+    SourceBuffer();
+public:
+    static constexpr const size_t PADDING = 64;
+
+    explicit SourceBuffer(std::string_view);
+    SourceBuffer(SourceBuffer&&) noexcept;
+    SourceBuffer& operator=(SourceBuffer&&) noexcept;
+    ~SourceBuffer();
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    static std::optional<SourceBuffer> open(const char* path);
+
+    inline std::string_view contents() const {
+        return std::string_view(this->data, this->size);
+    }
+};
+
+#endif
@@ -2,8 +2,15 @@
 #define _QUETZALCOATL_FRONTEND_SOURCE_LOCATION_HPP
 
 #include <cstddef>
+#include <cstdint>
 
+// Encoded location: an offset into the combined address space of all source buffers
+// registered with the SourceMap. Use SourceMap::resolve to obtain the file, line and column.
 struct SourceLocation {
+    uint32_t offset;
+};
+
+struct ResolvedLocation {
     size_t line;
     size_t column;
     size_t file_id;
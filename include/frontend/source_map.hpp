@@ -0,0 +1,87 @@
+#ifndef _QUETZALCOATL_FRONTEND_SOURCE_MAP_HPP
+#define _QUETZALCOATL_FRONTEND_SOURCE_MAP_HPP
+
+#include "frontend/source_location.hpp"
+
+#include <string_view>
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+
+// Maps encoded source locations back to files, lines and columns. Every source buffer
+// is assigned a range of the 32-bit location space, and within a buffer the line
+// markers of preprocessed input split it into regions that each belong to one file.
+// Lines and columns are only computed when a location is resolved, using an index
+// of the newlines in the buffer that is built the first time it is needed.
+class SourceMap {
+public:
+    // Flags of the GCC line marker that starts a region, flag n is bit n - 1.
+    enum RegionFlags : uint8_t {
+        ENTER_FILE = 1 << 0,
+        RETURN_TO_FILE = 1 << 1,
+        SYSTEM_HEADER = 1 << 2,
+        EXTERN_C = 1 << 3,
+    };
+
+    struct Region {
+        // Offset in the buffer where the region starts, and the line number at that offset.
+        // Line numbers are modulo 2^32, a marker for line 0 starts a region at line -1.
+        uint32_t offset;
+        uint32_t line;
+        uint32_t file_id;
+        uint8_t flags;
+    };
+
+private:
+    struct Buffer {
+        uint32_t base;
+        std::string_view source;
+        std::vector<Region> regions;
+
+        mutable std::vector<uint32_t> newlines;
+        mutable bool indexed;
+        // Size of a buffer that is added as a stream, whose source is not kept.
+        size_t stream_size;
+    };
+
+    std::vector<Buffer> buffers;
+    uint32_t next_base;
+
+    size_t newlinesBefore(const Buffer&, size_t) const;
+    const Buffer& findBuffer(SourceLocation) const;
+    const Region& findRegion(const Buffer&, size_t) const;
+public:
+    using BufferId = size_t;
+
+    SourceMap();
+
+    BufferId addBuffer(std::string_view source, size_t file_id);
+    // Adds a buffer whose contents arrive in pieces and are not kept, see SourceStream.
+    // While the stream is appended to, no other buffer may be added.
+    BufferId addStream(size_t file_id);
+    // Indexes the next piece of a stream, which has to be the most recently added buffer.
+    // Returns false without adding the piece if it does not fit in the location space. The
+    // index keeps the offset of every newline, 4 bytes per line, for as long as the map lives.
+    bool appendStream(BufferId, std::string_view piece);
+    void addLineMarker(BufferId, size_t offset, size_t line, size_t file_id, uint8_t flags = 0);
+
+    inline SourceLocation location(BufferId id, size_t offset) const {
+        return {uint32_t(this->buffers[id].base + offset)};
+    }
+
+    inline uint32_t base(BufferId id) const {
+        return this->buffers[id].base;
+    }
+
+    // The regions of a buffer in order, the first one starts at offset 0.
+    inline std::span<const Region> regions(BufferId id) const {
+        return this->buffers[id].regions;
+    }
+
+    // The region a location is in, found with a binary search over buffers and regions.
+    const Region& findRegion(SourceLocation) const;
+    ResolvedLocation resolve(SourceLocation) const;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _QUETZALCOATL_FRONTEND_SOURCE_STREAM_HPP
+#define _QUETZALCOATL_FRONTEND_SOURCE_STREAM_HPP
+
+#include <string_view>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+// Reads a file descriptor incrementally, for input that is too large to keep in memory or
+// that arrives through a pipe. The input is handed out in chunks of whole lines, each padded
+// like a SourceBuffer, so no token other than a multiline comment crosses a chunk boundary.
+// Chunks are recycled round robin, so the contents of a chunk stay valid until NUM_CHUNKS - 1
+// further chunks have been read. A chunk only grows beyond CHUNK_SIZE to fit a longer line.
+// Memory use does not grow with the input, apart from the newline index the SourceMap keeps
+// to resolve locations, at 4 bytes per line. Source locations are 32-bit, so a lexer stops
+// with an error once a stream no longer fits in what is left of the 4 GiB location space.
+class SourceStream {
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t capacity;
+        size_t size;
+    };
+
+    int fd;
+    std::vector<Chunk> chunks;
+    size_t current;
+    size_t current_offset;
+    // Partial line read past the end of the current chunk
+    std::string carry;
+    bool eof;
+    bool read_failed;
+
+    void grow(Chunk&, size_t);
+public:
+    static constexpr const size_t CHUNK_SIZE = 1 << 20;
+    static constexpr const size_t NUM_CHUNKS = 4;
+
+    // The file descriptor is not closed by the stream.
+    explicit SourceStream(int fd, size_t chunk_size = CHUNK_SIZE, size_t num_chunks = NUM_CHUNKS);
+
+    SourceStream(const SourceStream&) = delete;
+    SourceStream& operator=(const SourceStream&) = delete;
+
+    // Reads the next chunk and makes it current. Returns false at the end of input, or if reading failed.
+    bool next();
+
+    inline std::string_view contents() const {
+        const Chunk& chunk = this->chunks[this->current];
+        return std::string_view(chunk.data.get(), chunk.size);
+    }
+
+    // Offset of the current chunk from the start of the stream.
+    inline size_t offset() const {
+        return this->current_offset;
+    }
+
+    inline bool failed() const {
+        return this->read_failed;
+    }
+};
+
+#endif
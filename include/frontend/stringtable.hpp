@@ -8,6 +8,8 @@
 
 class StringTable {
     struct String {
+        // Strings are either stored in string_bytes at offset, or elsewhere at external.
+        const uint8_t* external;
         size_t offset;
         size_t length;
     };
@@ -19,8 +21,17 @@ public:
     using Id = size_t;
 
     Id add(View str);
+    // Adds a string without copying it. The memory must outlive the table.
+    Id addReference(View str);
     void pushToMostRecent(uint8_t c);
+    void appendToMostRecent(View str);
+    // Adds all strings of another table, and returns the id the first of them gets.
+    Id addAll(const StringTable& other);
     View get(Id id) const;
+
+    inline size_t size() const {
+        return this->strings.size();
+    }
 };
 
 using StringId = StringTable::Id;
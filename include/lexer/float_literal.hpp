@@ -0,0 +1,22 @@
+#ifndef _QUETZALCOATL_LEXER_FLOAT_LITERAL_HPP
+#define _QUETZALCOATL_LEXER_FLOAT_LITERAL_HPP
+
+#include <string_view>
+
+enum class FloatFormat {
+    FLOAT,
+    DOUBLE,
+};
+
+// Correctly rounded conversion of floating point literals, independent of the locale
+// and the current rounding mode. The input is the literal without its suffix, and may
+// contain digit separators. The result is rounded to the given format, and then
+// returned as a double, which represents every float exactly. Values that are too
+// large for the format become infinity.
+
+// Decimal literals: digits, an optional fraction and an optional exponent, e.g. 1.5e-3.
+double convertDecimalFloat(std::string_view, FloatFormat);
+// Hexadecimal literals: 0x, hex digits, an optional fraction and a binary exponent, e.g. 0x1.8p3.
+double convertHexFloat(std::string_view, FloatFormat);
+
+#endif
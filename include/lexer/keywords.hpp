@@ -0,0 +1,12 @@
+#ifndef _QUETZALCOATL_LEXER_KEYWORDS_HPP
+#define _QUETZALCOATL_LEXER_KEYWORDS_HPP
+
+#include "lexer/token.hpp"
+
+#include <string_view>
+
+// Returns the token type of the keyword or alternative operator spelling `id`,
+// or TokenType::ID if it is a plain identifier.
+TokenType lookupKeyword(std::string_view id);
+
+#endif
@@ -2,34 +2,113 @@
 #define _QUETZALCOATL_LEXER_LEXER_HPP
 
 #include "lexer/token.hpp"
+#include "lexer/scan.hpp"
+#include "lexer/token_buffer.hpp"
+#include "lexer/trivia.hpp"
 #include "frontend/compile_info.hpp"
 #include "frontend/source_location.hpp"
+#include "frontend/source_buffer.hpp"
+#include "frontend/source_stream.hpp"
 
 #include <string_view>
 #include <vector>
 #include <optional>
+#include <array>
+#include <span>
 #include <cstdint>
 
-class Lexer {
+// Features of the lexer that can be compiled out for callers that do not need them. Without
+// LOCATIONS, tokens have no position and line markers are not recorded in the source map,
+// without RAW, tokens have no raw text, and without DIAGNOSTICS, errors are not reported.
+// With TRIVIA, whitespace, comments and directives are recorded as well. With DIRECTIVES,
+// directives other than line markers are returned as tokens for the Preprocessor instead.
+struct DefaultLexerPolicy {
+    static constexpr const bool LOCATIONS = true;
+    static constexpr const bool RAW = true;
+    static constexpr const bool DIAGNOSTICS = true;
+    static constexpr const bool TRIVIA = false;
+    static constexpr const bool DIRECTIVES = false;
+};
+
+// Only the kinds and values of tokens, for example for syntax highlighting or brace matching.
+struct KindsOnlyLexerPolicy {
+    static constexpr const bool LOCATIONS = false;
+    static constexpr const bool RAW = false;
+    static constexpr const bool DIAGNOSTICS = false;
+    static constexpr const bool TRIVIA = false;
+    static constexpr const bool DIRECTIVES = false;
+};
+
+// Everything needed to reproduce the input, for formatters and refactoring tools.
+struct LosslessLexerPolicy {
+    static constexpr const bool LOCATIONS = true;
+    static constexpr const bool RAW = true;
+    static constexpr const bool DIAGNOSTICS = true;
+    static constexpr const bool TRIVIA = true;
+    static constexpr const bool DIRECTIVES = false;
+};
+
+// Source that has not been preprocessed yet. A directive is returned as a DIRECTIVE token,
+// followed by the tokens on its line and an END_OF_DIRECTIVE token at the newline. Inside
+// directives, # and ## are tokens and a backslash before a newline continues the line.
+struct PreprocessorLexerPolicy {
+    static constexpr const bool LOCATIONS = true;
+    static constexpr const bool RAW = true;
+    static constexpr const bool DIAGNOSTICS = true;
+    static constexpr const bool TRIVIA = false;
+    static constexpr const bool DIRECTIVES = true;
+};
+
+template <typename Policy = DefaultLexerPolicy>
+class BasicLexer {
 private:
     struct Char {
         uint8_t bytes[4];
         uint8_t len; // 0 is invalid
     };
 
+    // Files of recent line markers. Preprocessed input mostly alternates between a few files,
+    // so this avoids hashing the name for most markers. Names point into the file table.
+    struct MarkerFile {
+        std::string_view name;
+        size_t file_id;
+    };
+
+    static constexpr const size_t MARKER_CACHE_SIZE = 4;
+
+    // When lexing a stream, the input is its current chunk, which starts at chunk_offset in the buffer.
     std::string_view input;
     size_t input_offset;
+    SourceStream* stream;
+    size_t chunk_offset;
+    SourceMap::BufferId buffer_id;
+    uint32_t location_base;
 
-    SourceLocation position;
-    SourceLocation token_start;
     size_t token_start_offset;
 
+    // Sorted offsets watched for being inside a multiline comment, see watchSplits.
+    std::span<const size_t> splits;
+    size_t next_split;
+    std::vector<size_t> commented_splits;
+
     bool made_token_on_line;
+    bool in_directive;
 
     CompileInfo& compile_info;
+    Diagnostics* diagnostics;
+    std::vector<Trivia> trivia;
+    std::array<MarkerFile, MARKER_CACHE_SIZE> marker_cache;
+    size_t marker_cache_next;
 
     int read();
+    bool nextChunk();
+    void validateInput();
     void unread(size_t = 1);
+    void skip(const SkipResult&);
+
+    SourceLocation location() const;
+    SourceLocation location(size_t) const;
+    void error(SourceLocation, std::string_view);
 
     Token makeToken(TokenType);
     Token makeIntToken(TokenType, PrimitiveType::Kind, uint64_t);
@@ -38,37 +117,58 @@ private:
     std::string_view tokenString();
 
     bool isIdChar(int);
+    bool consumeUnicodeIdChar(bool start);
     bool isDigit(int, size_t = 10);
     bool isHexDigit(int);
     bool isWhitespace(int);
 
+    void addTrivia(TriviaKind, size_t start);
+    void consumeWhitespace();
     void consumeLine();
     void consumeMultiline();
+    void markCommentedSplits(size_t start);
 
     Token lexNumber();
+    Token lexFloat(uint64_t);
     Token lexId();
-    Token lexPlus();
-    Token lexMinus();
-    Token lexStar();
-    Token lexMod();
-    Token lexLt();
-    Token lexGt();
-    Token lexAnd();
-    Token lexOr();
-    Token lexXor();
-    Token lexAssign();
-    Token lexNot();
-    Token lexDot();
-    Token lexColon();
+    Token lexPunctuator(int);
     std::optional<uint32_t> lexEscapeLiteral(uint32_t base, size_t length, bool allow_shorter, uint32_t max_value = 0xFFFFFFFF);
     Char lexEscapeSequence();
     Token lexStringLiteral();
     Token lexCharLiteral();
+    size_t lookupMarkerFile(std::string_view);
     void lexPreprocessor();
+    Token endDirective();
 public:
-    Lexer(std::string_view, CompileInfo&);
+    BasicLexer(const SourceBuffer&, CompileInfo&, std::string_view filename = "<unknown>");
+    BasicLexer(SourceStream&, CompileInfo&);
+    // Lexes the input from the start of a line at `begin`, without validating it. See lexParallel.
+    BasicLexer(const SourceBuffer&, CompileInfo&, size_t begin);
+
+    // Reports diagnostics somewhere other than the compile info, so that a lexer running on
+    // another thread does not touch diagnostics shared with the parser. See TokenPipeline.
+    void setDiagnostics(Diagnostics&);
+
+    // Watches which of the sorted offsets the lexer passes inside a multiline comment. Lexing
+    // from a line start outside of one gives the same tokens as getting there from before,
+    // see lexParallel. The offsets must stay valid while the lexer runs.
+    void watchSplits(std::span<const size_t>);
+    bool splitInComment(size_t offset) const;
 
     Token lex();
+    // With trivia, lexAll attaches it to the token buffer instead.
+    TokenBuffer lexAll() requires Policy::LOCATIONS && Policy::RAW;
+
+    // Trivia found so far, in input order.
+    std::span<const Trivia> lexedTrivia() const requires Policy::TRIVIA;
 };
 
+using Lexer = BasicLexer<>;
+
+// The lexer is only instantiated for these policies, in lexer.cpp.
+extern template class BasicLexer<DefaultLexerPolicy>;
+extern template class BasicLexer<KindsOnlyLexerPolicy>;
+extern template class BasicLexer<LosslessLexerPolicy>;
+extern template class BasicLexer<PreprocessorLexerPolicy>;
+
 #endif
@@ -0,0 +1,19 @@
+#ifndef _QUETZALCOATL_LEXER_PARALLEL_LEXER_HPP
+#define _QUETZALCOATL_LEXER_PARALLEL_LEXER_HPP
+
+#include "lexer/token_buffer.hpp"
+#include "frontend/compile_info.hpp"
+#include "frontend/source_buffer.hpp"
+
+#include <cstddef>
+
+// Lexes a whole buffer like Lexer::lexAll, but on several threads. The buffer is split
+// into chunks at the start of a line, preferably one with a line marker or other directive,
+// and the chunks are lexed independently and stitched together in order. The lexer of each
+// chunk notes which later splits it passes inside a multiline comment. The chunk after such
+// a split is dropped while stitching, and the lexer of the chunk before it continues through
+// it instead. With 0 threads, one per hardware thread is used. Small inputs are lexed on the
+// calling thread.
+TokenBuffer lexParallel(const SourceBuffer&, CompileInfo&, size_t num_threads = 0);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _QUETZALCOATL_LEXER_REGION_CACHE_HPP
+#define _QUETZALCOATL_LEXER_REGION_CACHE_HPP
+
+#include "lexer/token_buffer.hpp"
+#include "frontend/compile_info.hpp"
+#include "frontend/source_buffer.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+// Lexes preprocessed translation units, reusing the tokens of headers they have in common.
+// The text between a line marker entering a header from the main file and the marker
+// returning from it is a region. Regions are looked up by file name and contents, and the
+// tokens, string literals, line markers and diagnostics of a region that was seen before
+// are copied in instead of lexing it again. Nested headers are part of the region of the
+// header including them. The cache is not thread safe, and string literals of the
+// translation units may refer to it, so it has to outlive their string tables.
+class RegionCache {
+public:
+    struct Stats {
+        size_t hits;
+        size_t misses;
+        // Bytes of regions that were reused rather than lexed, and of all input.
+        size_t saved_bytes;
+        size_t total_bytes;
+    };
+private:
+    // Regions smaller than this are lexed along with the main file.
+    static constexpr const size_t MIN_REGION_SIZE = 1 << 10;
+
+    // A region lexed on its own from a copy of its text, so locations in its tables
+    // are offsets in the region.
+    struct Entry {
+        std::string file;
+        SourceBuffer text;
+        CompileInfo compile_info;
+        TokenBuffer tokens;
+
+        Entry(std::string_view file, std::string_view text);
+    };
+
+    std::unordered_multimap<uint64_t, std::unique_ptr<Entry>> entries;
+    Stats statistics;
+
+    const Entry& find(std::string_view file, std::string_view text);
+public:
+    RegionCache();
+
+    RegionCache(const RegionCache&) = delete;
+    RegionCache& operator=(const RegionCache&) = delete;
+
+    // Lexes a whole buffer like Lexer::lexAll.
+    TokenBuffer lex(const SourceBuffer&, CompileInfo&);
+
+    inline const Stats& stats() const {
+        return this->statistics;
+    }
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _QUETZALCOATL_LEXER_SCAN_HPP
+#define _QUETZALCOATL_LEXER_SCAN_HPP
+
+#include <cstddef>
+
+// Bulk scanning primitives used by the lexer to validate its input and skip over whitespace and comments.
+// These read in blocks of up to 32 bytes and rely on the input being terminated by
+// a zero byte followed by SourceBuffer::PADDING bytes, as guaranteed by SourceBuffer.
+// The implementation is chosen at startup based on the instruction sets the CPU supports.
+
+struct SkipResult {
+    size_t length;
+    size_t newlines;
+};
+
+// Skips spaces, tabs, carriage returns and newlines.
+SkipResult skipWhitespace(const char*);
+// Returns the offset of the first newline or null byte.
+size_t findLineEnd(const char*);
+// Returns the offset of the first '*' or null byte, counting the newlines before it.
+SkipResult findStar(const char*);
+// Returns the offset of the first '"', '\\', newline or null byte.
+size_t findStringEnd(const char*);
+// Validates the first `size` bytes as UTF-8. Returns the offset of the first byte of the
+// first invalid sequence, or `size` if the input is valid.
+size_t validateUtf8(const char*, size_t size);
+
+#endif
@@ -10,7 +10,7 @@
 #include <cstddef>
 #include <cstdint>
 
-enum class TokenType {
+enum class TokenType : uint8_t {
     INVALID,
     EOI,
 
@@ -134,10 +134,17 @@ enum class TokenType {
     DOT,
     COMMA,
     SEMICOLON,
+    HASH,
+    HASH_HASH,
 
     LITERAL_STRING,
     LITERAL_INTEGER,
-    LITERAL_CHAR
+    LITERAL_FLOAT,
+    LITERAL_CHAR,
+
+    // Only produced for the preprocessor, see PreprocessorLexerPolicy
+    DIRECTIVE,
+    END_OF_DIRECTIVE
 };
 
 struct Token {
@@ -147,6 +154,10 @@ struct Token {
             TypeId type;
             uint64_t value;
         } integer;
+        struct {
+            TypeId type;
+            double value;
+        } floating;
         StringId string_literal;
         uint8_t char_literal;
     };
@@ -0,0 +1,116 @@
+#ifndef _QUETZALCOATL_LEXER_TOKEN_BUFFER_HPP
+#define _QUETZALCOATL_LEXER_TOKEN_BUFFER_HPP
+
+#include "lexer/token.hpp"
+#include "lexer/trivia.hpp"
+#include "frontend/source_location.hpp"
+
+#include <string_view>
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+
+// All tokens of an input, stored as parallel arrays indexed by token number.
+// The kinds and offsets are what a parser looks at most, the remaining arrays are
+// only touched when a token's payload or text is needed. Offsets and lengths are
+// 32 bits, so inputs are limited to 4 GiB.
+class TokenBuffer {
+public:
+    struct IntegerLiteral {
+        TypeId type;
+        uint64_t value;
+    };
+
+    struct FloatLiteral {
+        TypeId type;
+        double value;
+    };
+
+    // The arrays the accessors read, which are either owned by the buffer or kept elsewhere,
+    // such as in a mapped token cache file.
+    struct Columns {
+        std::span<const TokenType> kinds;
+        std::span<const uint32_t> offsets;
+        std::span<const uint32_t> lengths;
+        // Index into `integers` or `floats` for numeric literals, the string id for string literals
+        // and the character value for character literals.
+        std::span<const uint32_t> payloads;
+        std::span<const IntegerLiteral> integers;
+        std::span<const FloatLiteral> floats;
+    };
+private:
+    std::string_view source;
+    uint32_t location_base;
+
+    std::vector<TokenType> kinds;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<uint32_t> payloads;
+    std::vector<IntegerLiteral> integers;
+    std::vector<FloatLiteral> floats;
+    // Refreshed when read after tokens were pushed, so pushing stays cheap. A buffer that is
+    // still pushed to must therefore not be read from several threads.
+    mutable Columns data;
+
+    // Only filled in by a lexer that keeps trivia, see LosslessLexerPolicy.
+    std::vector<Trivia> trivia_runs;
+
+    void updateColumns() const;
+public:
+    TokenBuffer(std::string_view source, uint32_t location_base);
+    // A buffer reading arrays kept elsewhere, which cannot be added to.
+    TokenBuffer(std::string_view source, uint32_t location_base, const Columns&);
+
+    TokenBuffer(const TokenBuffer&) = delete;
+    TokenBuffer& operator=(const TokenBuffer&) = delete;
+    TokenBuffer(TokenBuffer&&) = default;
+    TokenBuffer& operator=(TokenBuffer&&) = default;
+
+    void reserve(size_t);
+    void push(const Token&);
+    // Appends the tokens of a buffer over the same source, whose string literals were
+    // added to the string table starting at `first_string`. With an offset, the other
+    // buffer is over a copy of the part of the source starting at that offset.
+    void append(const TokenBuffer&, StringId first_string, uint32_t offset = 0);
+
+    inline const Columns& columns() const {
+        // Only pushing makes the owned arrays longer than the view of them
+        if(this->data.kinds.size() < this->kinds.size())
+            this->updateColumns();
+        return this->data;
+    }
+
+    inline size_t size() const {
+        return this->columns().kinds.size();
+    }
+
+    inline TokenType kind(size_t index) const {
+        return this->columns().kinds[index];
+    }
+
+    inline uint32_t offset(size_t index) const {
+        return this->columns().offsets[index];
+    }
+
+    inline std::string_view raw(size_t index) const {
+        return this->source.substr(this->columns().offsets[index], this->columns().lengths[index]);
+    }
+
+    inline SourceLocation location(size_t index) const {
+        return {this->location_base + this->columns().offsets[index]};
+    }
+
+    Token get(size_t index) const;
+
+    void setTrivia(std::vector<Trivia>);
+
+    inline std::span<const Trivia> trivia() const {
+        return this->trivia_runs;
+    }
+
+    // The trivia between the previous token and this one.
+    std::span<const Trivia> leadingTrivia(size_t index) const;
+};
+
+#endif
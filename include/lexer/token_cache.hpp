@@ -0,0 +1,50 @@
+#ifndef _QUETZALCOATL_LEXER_TOKEN_CACHE_HPP
+#define _QUETZALCOATL_LEXER_TOKEN_CACHE_HPP
+
+#include "lexer/token_buffer.hpp"
+#include "frontend/compile_info.hpp"
+#include "frontend/source_buffer.hpp"
+
+#include <optional>
+#include <cstddef>
+
+// A lexed input saved to disk, so that an unchanged input does not have to be lexed again.
+// The file holds the token arrays of a TokenBuffer, with the string literals, files, line
+// markers and lexer diagnostics of the input, each in a section aligned to 8 bytes. It is
+// mapped into memory and the tokens are read from it in place. The header identifies the
+// format and has the size and hash of the input the file was made from, and a checksum of
+// the rest.
+class TokenCache {
+private:
+    const char* data;
+    size_t size;
+
+    TokenCache(const char* data, size_t size);
+public:
+    TokenCache(TokenCache&&) noexcept;
+    TokenCache& operator=(TokenCache&&) noexcept;
+    ~TokenCache();
+
+    TokenCache(const TokenCache&) = delete;
+    TokenCache& operator=(const TokenCache&) = delete;
+
+    // Maps a cache file. Fails if it cannot be read, is of another version or damaged,
+    // or was made from a different input.
+    static std::optional<TokenCache> open(const char* path, const SourceBuffer& input);
+
+    // Adds the strings, files, line markers and diagnostics of the input to tables that are
+    // not used yet, and returns its tokens. Strings and tokens refer to the mapping, so it
+    // has to outlive them.
+    TokenBuffer load(const SourceBuffer& input, CompileInfo&) const;
+
+    // Saves the tokens of an input, lexed into tables that were not used before. The file
+    // is written under another name first and then renamed, so readers never see part of it.
+    static bool write(const char* path, const SourceBuffer& input, const TokenBuffer&, const CompileInfo&);
+};
+
+// Lexes a whole buffer like lexParallel, reading the tokens from a cache file instead if it
+// is up to date. Otherwise the cache file is written afterwards. A cache file that was used
+// is kept in `cache`.
+TokenBuffer lexCached(const SourceBuffer&, CompileInfo&, const char* cache_path, std::optional<TokenCache>& cache);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef _QUETZALCOATL_LEXER_TOKEN_PIPELINE_HPP
+#define _QUETZALCOATL_LEXER_TOKEN_PIPELINE_HPP
+
+#include "lexer/lexer.hpp"
+#include "lexer/token.hpp"
+#include "frontend/compile_info.hpp"
+#include "frontend/diagnostics.hpp"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// Runs a lexer on its own thread, ahead of the parser reading its tokens. Tokens are handed
+// over in batches through a fixed ring of RING_SIZE batches, which the lexer waits on once it
+// is full, so memory use does not grow with the input. The lexer reports its diagnostics to
+// the pipeline, which adds them to the compile info once the token they were reported for
+// is read, so they end up in the same order as when the lexer is called directly.
+// The lexer must lex a buffer rather than a stream, as tokens refer to the input well after
+// they are lexed. While the pipeline runs, only the lexer thread may touch the string table
+// and source map.
+class TokenPipeline {
+public:
+    static constexpr const size_t BATCH_SIZE = 256;
+    static constexpr const size_t RING_SIZE = 16;
+
+private:
+    struct Batch {
+        std::array<Token, BATCH_SIZE> tokens;
+        size_t size;
+        // Diagnostics together with the index of the token they were reported for
+        std::vector<std::pair<size_t, Diagnostic>> diagnostics;
+    };
+
+    Lexer& lexer;
+    Diagnostics& diagnostics;
+    Diagnostics lexer_diagnostics;
+    std::unique_ptr<Batch[]> ring;
+
+    // Number of batches published by the lexer thread and released by the reader. They are
+    // on separate cache lines, as each is written by one thread and polled by the other.
+    alignas(64) std::atomic<size_t> published;
+    alignas(64) std::atomic<size_t> released;
+    std::atomic<bool> stopped;
+
+    // Only used by the reader
+    alignas(64) size_t read_index;
+    size_t read_diagnostic;
+    bool finished;
+    Token end;
+
+    std::thread thread;
+
+    void run();
+public:
+    TokenPipeline(Lexer&, CompileInfo&);
+    ~TokenPipeline();
+
+    TokenPipeline(const TokenPipeline&) = delete;
+    TokenPipeline& operator=(const TokenPipeline&) = delete;
+
+    // Returns the next token, waiting for the lexer if needed. After the end of input
+    // token, that token is returned again.
+    Token next();
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef _QUETZALCOATL_LEXER_TRIVIA_HPP
+#define _QUETZALCOATL_LEXER_TRIVIA_HPP
+
+#include <cstdint>
+
+enum class TriviaKind : uint8_t {
+    WHITESPACE,
+    LINE_COMMENT,
+    BLOCK_COMMENT,
+    // A line marker or other directive, up to but not including its newline
+    DIRECTIVE,
+};
+
+// A run of input between tokens. Together with the raw text of the tokens, the runs
+// cover the whole input, so it can be reproduced exactly. Offsets are from the start
+// of the input, also for a stream.
+struct Trivia {
+    uint32_t offset;
+    uint32_t length;
+    TriviaKind kind;
+};
+
+#endif
@@ -1,7 +0,0 @@
-#ifndef _QUETZALCOATL_PARSER_PARSEEXCEPTION_HPP
-#define _QUETZALCOATL_PARSER_PARSEEXCEPTION_HPP
-
-class ParseException {
-};
-
-#endif
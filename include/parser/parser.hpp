@@ -1,47 +1,111 @@
 #ifndef _QUETZALCOATL_PARSER_PARSER_HPP
 #define _QUETZALCOATL_PARSER_PARSER_HPP
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
 #include <vector>
 
 #include "lexer/lexer.hpp"
+#include "lexer/token_pipeline.hpp"
+#include "lexer/token_buffer.hpp"
 #include "lexer/token.hpp"
+#include "preprocessor/preprocessor.hpp"
 #include "frontend/compile_info.hpp"
 #include "frontend/ast.hpp"
 
 class Parser {
+public:
+    struct Stats {
+        size_t tentative_parses;
+        // Tentative parses that were rewound, and the tokens they had consumed
+        size_t backtracks;
+        size_t backtracked_tokens;
+    };
 private:
-    Lexer& lexer;
+    // Tokens come either from a lexer on demand, from a lexer running ahead on another
+    // thread, from the preprocessor or from a pre-lexed buffer.
+    Lexer* lexer;
+    TokenPipeline* pipeline;
+    Preprocessor* preprocessor;
+    const TokenBuffer* tokens;
+    size_t token_index;
+    // Furthest token_index before rewinding to a checkpoint
+    size_t furthest_token_index;
+
+    // Tokens looked ahead at, in a ring starting at lookahead_first. Slots are never
+    // moved, so a token returned by peek stays valid until it is consumed.
+    static constexpr const size_t LOOKAHEAD = 4;
+    std::array<Token, LOOKAHEAD> lookahead;
+    size_t lookahead_first;
+    size_t lookahead_count;
+
     CompileInfo& compile_info;
     AstTable& ast;
 
-    std::vector<Token> token_stack;
     size_t nearest_switch;
+    bool iterative;
+
+    // After a syntax error the parser is in panic mode until it has skipped to the end of the
+    // statement, and does not report further syntax errors. Once there are max_errors errors,
+    // it stops, reading the rest of the input as ended.
+    bool panicking;
+    bool stopped;
+    size_t num_errors;
+    size_t max_errors;
+
+    // Some constructs cannot be told apart by the tokens ahead, such as `a * b;`, which declares
+    // b if a names a type. They are parsed tentatively from a checkpoint, which records the
+    // position in the tokens and the number of AST nodes. Rewinding to it truncates the AST and
+    // reads the same tokens again, and committing keeps what was parsed. While a checkpoint is
+    // active, errors are not reported but make the tentative parse fail, and tokens that are not
+    // read from a buffer are kept in `replay` so that they can be read again.
+    struct Checkpoint {
+        size_t position;
+        std::array<Token, LOOKAHEAD> lookahead;
+        size_t lookahead_first;
+        size_t lookahead_count;
+        size_t ast_size;
+    };
+    std::vector<Token> replay;
+    size_t replay_index;
+    size_t tentative;
+    Stats statistics;
 
+    // The specifiers and first declarator of a declaration, which tell it from an expression
+    struct DeclarationStart {
+        size_t specifiers;
+        size_t declarator;
+    };
+
+    Token lex();
     Token next_token();
-    Token peek_token();
+    // The token k tokens ahead, for k < LOOKAHEAD
+    const Token& peek(size_t k = 0);
     void unread(const Token&);
     void consume();
+    size_t position() const;
+
+    Checkpoint checkpoint();
+    void rewind(const Checkpoint&);
+    void commit();
 
     Token expect(TokenType);
 
-    [[noreturn]] void throwError(const Token&, const std::vector<TokenType>&);
+    void reportError(SourceLocation, std::string_view);
+    void reportUnexpected(const Token&, const std::vector<TokenType>&);
+    void synchronize();
 
     std::vector<size_t> parseList(TokenType);
+    // Adds a node for the identifier ahead and consumes it
+    size_t parseName(AstNodeType);
     size_t parseAtom();
     size_t parsePostfix();
     size_t parsePrefix(bool = false);
-    size_t parsePtrToMember();
-    size_t parseMultiply();
-    size_t parseAdd();
-    size_t parseShift();
-    size_t parseRelational();
-    size_t parseEquality();
-    size_t parseBitand();
-    size_t parseBitxor();
-    size_t parseBitor();
-    size_t parseAnd();
-    size_t parseOr();
+    // Parses binary operators with at least the given power, see BINARY_OPERATORS.
+    size_t parseBinary(uint8_t);
     size_t parseAssign();
     size_t parseComma();
     size_t parseExpr();
@@ -50,18 +114,44 @@ private:
     size_t parseSwitch();
     size_t parseDefault();
     size_t parseCase();
+    size_t addCaseLabel(SourceLocation, size_t);
     size_t parseCondition();
     size_t parseWhile();
     size_t parseDoWhile();
-    size_t parseSimpleDecl();
+    uint64_t parseCvQualifiers();
+    size_t parseDeclSpecifiers();
+    size_t parseDeclarator();
+    // Parses the start of a declaration if the tokens ahead are one. In a condition, the
+    // declarator has to be followed by an initializer.
+    std::optional<DeclarationStart> parseDeclarationStart(bool);
+    size_t parseSimpleDecl(const DeclarationStart&);
     size_t parseForInit();
     size_t parseFor();
     size_t parseReturn();
+    size_t dispatchStatement();
     size_t parseStatement();
     size_t parseStatementList();
+    size_t parseIteratively();
 public:
     Parser(Lexer&, CompileInfo&, AstTable&);
+    Parser(TokenPipeline&, CompileInfo&, AstTable&);
+    Parser(Preprocessor&, CompileInfo&, AstTable&);
+    Parser(const TokenBuffer&, CompileInfo&, AstTable&);
+
+    // Nesting is limited by the size of the native stack when parsing by recursive descent.
+    // In iterative mode the parser keeps the constructs it is in on a stack on the heap
+    // instead, so that machine-generated input nested arbitrarily deep can be parsed.
+    void setIterative(bool);
+
+    static constexpr const size_t DEFAULT_MAX_ERRORS = 100;
+    void setMaxErrors(size_t);
+
+    inline const Stats& stats() const {
+        return this->statistics;
+    }
 
+    // Syntax errors are reported and parsed as error nodes, so a tree is returned even for
+    // input with errors.
     size_t parse();
 };
 
@@ -0,0 +1,186 @@
+#ifndef _QUETZALCOATL_PREPROCESSOR_PREPROCESSOR_HPP
+#define _QUETZALCOATL_PREPROCESSOR_PREPROCESSOR_HPP
+
+#include "lexer/token.hpp"
+#include "frontend/compile_info.hpp"
+#include "frontend/diagnostics.hpp"
+#include "frontend/source_buffer.hpp"
+#include "frontend/source_location.hpp"
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Preprocesses source files into the tokens the parser reads, handling includes, macros and
+// conditionals. Every file is lexed once into an array of tokens, which is replayed when the
+// file is included again. A file that is entirely inside an include guard, or that has
+// #pragma once, is skipped without looking at its tokens when it is included again.
+// Macro bodies are stored as token arrays in one arena. Line markers are handled by the
+// lexer as usual, so preprocessed input passes through unchanged.
+// The files stay in memory until the preprocessor is destroyed, and the source map refers
+// to them, so it has to outlive any use of the locations of its tokens.
+class Preprocessor {
+private:
+    static constexpr const uint32_t NO_PARAM = UINT32_MAX;
+    static constexpr const size_t NO_MACRO = SIZE_MAX;
+    static constexpr const size_t MAX_INCLUDE_DEPTH = 200;
+
+    struct File {
+        SourceBuffer buffer;
+        std::string path;
+        // All tokens of the file including directives, ending with EOI
+        std::vector<Token> tokens;
+        // Indices of the DIRECTIVE tokens, for skipping conditional groups
+        std::vector<uint32_t> directives;
+        // Lexer diagnostics with the index of the token they were reported for. They are only
+        // reported when that token is not skipped.
+        std::vector<std::pair<size_t, Diagnostic>> diagnostics;
+        // Macro of the include guard around all of the file, if it has one
+        std::string_view guard;
+        bool once;
+        bool included;
+
+        File(SourceBuffer&& buffer, std::string_view path) :
+            buffer(std::move(buffer)), path(path), once(false), included(false) {}
+    };
+
+    struct Conditional {
+        SourceLocation loc;
+        // Whether one of the groups has been taken, after which the others are skipped
+        bool taken;
+        bool seen_else;
+    };
+
+    // A file being preprocessed, with its position and open conditionals.
+    struct FileState {
+        File* file;
+        size_t index;
+        size_t next_diagnostic;
+        std::vector<Conditional> conditionals;
+    };
+
+    struct Macro {
+        enum Kind : uint8_t {
+            OBJECT,
+            FUNCTION,
+            FILE_NAME,
+            LINE_NUMBER,
+        };
+
+        Kind kind;
+        bool variadic;
+        // Set while the macro is being expanded, see ExpandedToken
+        bool disabled;
+        uint32_t first_param;
+        uint32_t num_params;
+        uint32_t first_token;
+        uint32_t num_tokens;
+    };
+
+    // A token of a macro body, with the index of the parameter it names if it does.
+    struct MacroToken {
+        Token token;
+        uint32_t param;
+    };
+
+    // Identifiers naming a macro that is being expanded when they are read are never expanded.
+    struct ExpandedToken {
+        Token token;
+        bool no_expand;
+    };
+
+    // Tokens that are read before the rest of the file: a macro expansion, a macro argument
+    // being expanded or a token that was read ahead. Contexts are reused to keep their storage.
+    struct Context {
+        std::vector<ExpandedToken> tokens;
+        size_t index;
+        size_t macro;
+    };
+
+    CompileInfo& compile_info;
+
+    std::vector<std::string> include_paths;
+    std::string predefines;
+
+    // Files by canonical path, and the files an include name resolved to from a directory.
+    std::unordered_map<std::string, std::unique_ptr<File>> files;
+    std::unordered_map<std::string, File*> include_cache;
+    std::vector<std::unique_ptr<File>> builtin_files;
+    // Text made by # and ##, and the spellings of __FILE__ and __LINE__
+    std::deque<SourceBuffer> scratch;
+    std::deque<std::string> scratch_spellings;
+
+    std::vector<Macro> macros;
+    std::vector<std::string_view> macro_params;
+    std::vector<MacroToken> macro_tokens;
+    std::unordered_map<std::string_view, size_t> macro_lookup;
+    size_t num_disabled;
+
+    std::vector<FileState> file_stack;
+    std::vector<Context> contexts;
+    size_t depth;
+
+    File* loadFile(const std::string& path);
+    std::unique_ptr<File> makeFile(SourceBuffer&&, std::string_view path);
+    void detectGuard(File&);
+    std::optional<std::string> findInclude(std::string_view name, bool angled) const;
+    File* resolveInclude(std::string_view name, bool angled);
+    void enterFile(File*, SourceLocation);
+
+    const Token& takeToken(FileState&);
+    std::span<const Token> directiveLine(FileState&);
+    Token readFileToken();
+    void handleDirective();
+    void handleInclude(std::span<const Token>, SourceLocation);
+    void handleDefine(std::span<const Token>, SourceLocation);
+    void handleUndef(std::span<const Token>, SourceLocation);
+    void handlePragma(std::span<const Token>);
+    void skipGroup(FileState&);
+    bool evaluateCondition(std::span<const Token>, SourceLocation);
+    void checkEndOfDirective(std::span<const Token>, std::string_view directive);
+
+    size_t findMacro(std::string_view) const;
+    bool isDefined(std::string_view) const;
+    void addBuiltinMacro(std::string_view name, Macro::Kind);
+
+    Context& pushContext(size_t macro);
+    void popContext();
+    void pushBack(const ExpandedToken&);
+    bool read(ExpandedToken&, size_t floor);
+    bool nextExpanded(ExpandedToken&, size_t floor);
+    bool expand(size_t macro, const ExpandedToken& name, size_t floor);
+    bool collectArguments(const Macro&, const Token& name, size_t floor, std::vector<std::vector<ExpandedToken>>& args);
+    void substitute(const Macro&, const Token& name, std::vector<std::vector<ExpandedToken>>& args, std::vector<ExpandedToken>& result);
+    void expandTokens(std::span<const ExpandedToken>, std::vector<ExpandedToken>& result);
+
+    std::vector<Token> lexScratch(std::string_view text, SourceLocation);
+    Token stringize(std::span<const ExpandedToken>, SourceLocation);
+    void paste(std::vector<ExpandedToken>& result, std::span<const ExpandedToken> rhs, SourceLocation);
+public:
+    explicit Preprocessor(CompileInfo&);
+
+    Preprocessor(const Preprocessor&) = delete;
+    Preprocessor& operator=(const Preprocessor&) = delete;
+
+    // Searched in order for <> includes, and after the directory of the including file for "" includes.
+    void addIncludePath(std::string_view);
+    // Defines an object-like macro before the main file, like -D.
+    void define(std::string_view name, std::string_view value = "1");
+
+    // Starts preprocessing a file. Returns false if it could not be opened.
+    bool open(const char* path);
+
+    // Returns the next token after preprocessing. After the end of the main file, the end of
+    // input token is returned again.
+    Token next();
+};
+
+#endif
@@ -28,6 +28,9 @@ struct CodePoint {
 
     ToUtf8 toUtf8() const;
     bool isValidUtf8() const;
+    // UAX #31 identifier properties, from tables generated by tools/generate_xid_tables.py.
+    bool isXidStart() const;
+    bool isXidContinue() const;
 };
 
 std::ostream& operator<<(std::ostream& os, CodePoint::ToUtf8 cp);
@@ -18,6 +18,9 @@ SwitchAstNode::SwitchAstNode(AstNodeType type, std::initializer_list<size_t> chi
 SwitchAstNode::SwitchAstNode(AstNodeType type, const std::vector<size_t>& children, TypeId datatype)
     : AstNode(type, children, datatype), default_id(INVALID_ASTNODE_ID) {}
 
+NameAstNode::NameAstNode(AstNodeType type, TypeId datatype, std::string_view name)
+    : AstNode(type, {}, datatype), name(name) {}
+
 size_t AstTable::addNode(AstNodeType type) {
     size_t id = this->nodes.size();
     this->nodes.emplace_back(new AstNode(type, {}, 0));
@@ -66,6 +69,20 @@ size_t AstTable::addSwitchNode(AstNodeType type) {
     return id;
 }
 
+size_t AstTable::addNameNode(AstNodeType type, std::string_view name) {
+    size_t id = this->nodes.size();
+    this->nodes.emplace_back(new NameAstNode(type, 0, name));
+    return id;
+}
+
+size_t AstTable::size() const {
+    return this->nodes.size();
+}
+
+void AstTable::truncate(size_t size) {
+    this->nodes.resize(size);
+}
+
 AstNode& AstTable::getNode(size_t id) {
     return *this->nodes[id];
 }
@@ -20,9 +20,10 @@ namespace {
 }
 
 void CompileInfo::printDiagnostics(std::ostream& out, bool want_color) const {
-    for (const auto& [type, loc, msg] : this->diagnostics.messages()) {
+    for (const auto& [type, encoded_loc, msg] : this->diagnostics.messages()) {
         if (want_color)
             out << msg_style;
+        auto loc = this->sources.resolve(encoded_loc);
         auto filename = this->files.getFile(loc.file_id);
         out << filename << ':' << loc.line << ':' << loc.column << ": ";
         if(want_color)
@@ -1,5 +1,7 @@
 #include "frontend/diagnostics.hpp"
 
+#include <algorithm>
+
 void Diagnostics::error(SourceLocation loc, std::string_view msg) {
     this->msgs.emplace_back(Diagnostic::ERROR, loc, msg);
 }
@@ -12,6 +14,22 @@ void Diagnostics::note(SourceLocation loc, std::string_view msg) {
     this->msgs.emplace_back(Diagnostic::NOTE, loc, msg);
 }
 
+void Diagnostics::add(const Diagnostic& diagnostic) {
+    this->msgs.push_back(diagnostic);
+}
+
+void Diagnostics::sortByLocation() {
+    std::stable_sort(this->msgs.begin(), this->msgs.end(), [](const Diagnostic& a, const Diagnostic& b) {
+        return a.loc.offset < b.loc.offset;
+    });
+}
+
+void Diagnostics::dropAfter(SourceLocation loc) {
+    std::erase_if(this->msgs, [loc](const Diagnostic& diagnostic) {
+        return diagnostic.loc.offset > loc.offset;
+    });
+}
+
 std::span<const Diagnostic> Diagnostics::messages() const {
     return this->msgs;
 }
@@ -1,12 +1,14 @@
 #include "frontend/filetable.hpp"
 
 size_t FileTable::addFile(std::string_view filename) {
-    if(this->index_lookup.count(filename) > 0)
-        return this->index_lookup.at(filename);
+    auto it = this->index_lookup.find(filename);
+    if(it != this->index_lookup.end())
+        return it->second;
 
     size_t new_id = this->files.size();
     this->files.emplace_back(filename);
-    return this->index_lookup[this->files.back()] = new_id;
+    this->index_lookup.emplace(this->files.back(), new_id);
+    return new_id;
 }
 
 std::string_view FileTable::getFile(size_t id) const {
@@ -0,0 +1,33 @@
+#include "frontend/hash.hpp"
+
+#include <cstring>
+
+namespace {
+    uint64_t mix(uint64_t a, uint64_t b) {
+        unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        return uint64_t(product) ^ uint64_t(product >> 64);
+    }
+
+    uint64_t load(const char* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+}
+
+// In the style of wyhash, which takes 16 bytes per multiplication.
+uint64_t hashBytes(std::string_view bytes, uint64_t seed) {
+    constexpr const uint64_t K0 = 0xa0761d6478bd642f;
+    constexpr const uint64_t K1 = 0xe7037ed1a0b428db;
+
+    const char* data = bytes.data();
+    size_t size = bytes.size();
+    uint64_t hash = seed ^ K0;
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16)
+        hash = mix(load(data + i) ^ K1, load(data + i + 8) ^ hash);
+
+    char tail[16] = {};
+    std::memcpy(tail, data + i, size - i);
+    return mix(load(tail) ^ K1 ^ size, load(tail + 8) ^ hash);
+}
@@ -0,0 +1,98 @@
+#include "frontend/source_buffer.hpp"
+
+#include <string>
+#include <utility>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    struct FileDescriptor {
+        int fd;
+
+        ~FileDescriptor() {
+            if(this->fd >= 0)
+                ::close(this->fd);
+        }
+    };
+}
+
+SourceBuffer::SourceBuffer() :
+    data(nullptr), size(0), mapping(nullptr), mapping_size(0) {}
+
+SourceBuffer::SourceBuffer(std::string_view contents) :
+    size(contents.size()), mapping(nullptr), mapping_size(0),
+    owned(new char[contents.size() + PADDING]) {
+    std::memcpy(this->owned.get(), contents.data(), contents.size());
+    std::memset(this->owned.get() + contents.size(), 0, PADDING);
+    this->data = this->owned.get();
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept :
+    data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)),
+    mapping(std::exchange(other.mapping, nullptr)), mapping_size(std::exchange(other.mapping_size, 0)),
+    owned(std::move(other.owned)) {}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept {
+    std::swap(this->data, other.data);
+    std::swap(this->size, other.size);
+    std::swap(this->mapping, other.mapping);
+    std::swap(this->mapping_size, other.mapping_size);
+    std::swap(this->owned, other.owned);
+    return *this;
+}
+
+SourceBuffer::~SourceBuffer() {
+    if(this->mapping)
+        ::munmap(this->mapping, this->mapping_size);
+}
+
+std::optional<SourceBuffer> SourceBuffer::open(const char* path) {
+    FileDescriptor file = {::open(path, O_RDONLY)};
+    if(file.fd < 0)
+        return std::nullopt;
+
+    struct stat info;
+    if(::fstat(file.fd, &info) < 0)
+        return std::nullopt;
+
+    if(!S_ISREG(info.st_mode) || info.st_size == 0) {
+        // Pipes and other special files cannot be mapped, so read them into memory.
+        std::string contents;
+        char chunk[65536];
+        ssize_t len;
+        while((len = ::read(file.fd, chunk, sizeof chunk)) > 0)
+            contents.append(chunk, len);
+        if(len < 0)
+            return std::nullopt;
+        return SourceBuffer(contents);
+    }
+
+    size_t file_size = info.st_size;
+    size_t page_size = ::sysconf(_SC_PAGESIZE);
+    size_t mapping_size = (file_size + PADDING + page_size - 1) / page_size * page_size;
+
+    // Reserve zeroed anonymous memory for the contents plus padding, then map the
+    // file over the start of it. The remainder of the last file page is zero filled
+    // by the kernel, and any pages after it stay anonymous zero pages.
+    void* mapping = ::mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mapping == MAP_FAILED)
+        return std::nullopt;
+
+    if(::mmap(mapping, file_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, file.fd, 0) == MAP_FAILED) {
+        ::munmap(mapping, mapping_size);
+        return std::nullopt;
+    }
+
+    ::madvise(mapping, file_size, MADV_SEQUENTIAL);
+
+    SourceBuffer result;
+    result.data = static_cast<const char*>(mapping);
+    result.size = file_size;
+    result.mapping = mapping;
+    result.mapping_size = mapping_size;
+    return result;
+}
@@ -0,0 +1,95 @@
+#include "frontend/source_map.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+SourceMap::SourceMap() : next_base(0) {}
+
+SourceMap::BufferId SourceMap::addBuffer(std::string_view source, size_t file_id) {
+    // Reserve one location past the end of the buffer for the end of input.
+    assert(source.size() < std::numeric_limits<uint32_t>::max() - this->next_base - 1);
+
+    BufferId id = this->buffers.size();
+    this->buffers.push_back({this->next_base, source, {{0, 1, uint32_t(file_id), 0}}, {}, false, 0});
+    this->next_base += source.size() + 2;
+    return id;
+}
+
+SourceMap::BufferId SourceMap::addStream(size_t file_id) {
+    BufferId id = this->buffers.size();
+    // The source is not kept, so the newline index is built as the pieces arrive.
+    this->buffers.push_back({this->next_base, {}, {{0, 1, uint32_t(file_id), 0}}, {}, true, 0});
+    this->next_base += 2;
+    return id;
+}
+
+bool SourceMap::appendStream(BufferId id, std::string_view piece) {
+    Buffer& buffer = this->buffers[id];
+    assert(id == this->buffers.size() - 1 && buffer.indexed);
+    // Unlike a buffer, the size of a stream is not known up front, so running out of
+    // locations is an error in the input rather than a bug.
+    if(piece.size() >= std::numeric_limits<uint32_t>::max() - this->next_base)
+        return false;
+
+    const char* begin = piece.data();
+    const char* end = begin + piece.size();
+    for(const char* p = begin; (p = static_cast<const char*>(std::memchr(p, '\n', end - p))); ++p)
+        buffer.newlines.push_back(buffer.stream_size + (p - begin));
+
+    buffer.stream_size += piece.size();
+    this->next_base += piece.size();
+    return true;
+}
+
+void SourceMap::addLineMarker(BufferId id, size_t offset, size_t line, size_t file_id, uint8_t flags) {
+    auto& regions = this->buffers[id].regions;
+    assert(offset >= regions.back().offset);
+    regions.push_back({uint32_t(offset), uint32_t(line), uint32_t(file_id), flags});
+}
+
+size_t SourceMap::newlinesBefore(const Buffer& buffer, size_t offset) const {
+    if(!buffer.indexed) {
+        const char* begin = buffer.source.data();
+        const char* end = begin + buffer.source.size();
+        for(const char* p = begin; (p = static_cast<const char*>(std::memchr(p, '\n', end - p))); ++p)
+            buffer.newlines.push_back(p - begin);
+        buffer.indexed = true;
+    }
+
+    return std::lower_bound(buffer.newlines.begin(), buffer.newlines.end(), offset) - buffer.newlines.begin();
+}
+
+const SourceMap::Buffer& SourceMap::findBuffer(SourceLocation loc) const {
+    auto buffer_it = std::upper_bound(this->buffers.begin(), this->buffers.end(), loc.offset,
+        [](uint32_t offset, const Buffer& buffer) { return offset < buffer.base; });
+    assert(buffer_it != this->buffers.begin());
+    return *--buffer_it;
+}
+
+const SourceMap::Region& SourceMap::findRegion(const Buffer& buffer, size_t offset) const {
+    auto region_it = std::upper_bound(buffer.regions.begin(), buffer.regions.end(), offset,
+        [](size_t offset, const Region& region) { return offset < region.offset; });
+    return *--region_it;
+}
+
+const SourceMap::Region& SourceMap::findRegion(SourceLocation loc) const {
+    const Buffer& buffer = this->findBuffer(loc);
+    return this->findRegion(buffer, loc.offset - buffer.base);
+}
+
+ResolvedLocation SourceMap::resolve(SourceLocation loc) const {
+    const Buffer& buffer = this->findBuffer(loc);
+    size_t offset = loc.offset - buffer.base;
+    const Region& region = this->findRegion(buffer, offset);
+
+    size_t newlines = this->newlinesBefore(buffer, offset);
+    size_t line_start = newlines == 0 ? 0 : buffer.newlines[newlines - 1] + 1;
+
+    ResolvedLocation result;
+    result.line = uint32_t(region.line + newlines - this->newlinesBefore(buffer, region.offset));
+    result.column = offset - line_start + 1;
+    result.file_id = region.file_id;
+    return result;
+}
@@ -0,0 +1,77 @@
+#include "frontend/source_stream.hpp"
+#include "frontend/source_buffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+SourceStream::SourceStream(int fd, size_t chunk_size, size_t num_chunks) :
+    fd(fd), chunks(num_chunks), current(0), current_offset(0), eof(false), read_failed(false) {
+    assert(num_chunks >= 2 && chunk_size > 0);
+    for(auto& chunk : this->chunks) {
+        chunk.data.reset(new char[chunk_size + SourceBuffer::PADDING]);
+        chunk.capacity = chunk_size;
+        chunk.size = 0;
+    }
+    // Start out on an empty chunk, so the contents are padded even before the first read.
+    std::memset(this->chunks[0].data.get(), 0, SourceBuffer::PADDING);
+}
+
+void SourceStream::grow(Chunk& chunk, size_t used) {
+    size_t capacity = chunk.capacity * 2;
+    std::unique_ptr<char[]> data(new char[capacity + SourceBuffer::PADDING]);
+    std::memcpy(data.get(), chunk.data.get(), used);
+    chunk.data = std::move(data);
+    chunk.capacity = capacity;
+}
+
+bool SourceStream::next() {
+    if(this->eof)
+        return false;
+
+    size_t index = (this->current + 1) % this->chunks.size();
+    Chunk& chunk = this->chunks[index];
+    while(chunk.capacity < this->carry.size())
+        this->grow(chunk, 0);
+    std::memcpy(chunk.data.get(), this->carry.data(), this->carry.size());
+    size_t filled = this->carry.size();
+
+    while(true) {
+        if(filled == chunk.capacity) {
+            if(std::memchr(chunk.data.get(), '\n', filled))
+                break;
+            // Only whole lines are handed out, so the chunk has to fit at least one.
+            this->grow(chunk, filled);
+        }
+
+        ssize_t len = ::read(this->fd, chunk.data.get() + filled, chunk.capacity - filled);
+        if(len < 0 && errno == EINTR)
+            continue;
+        if(len <= 0) {
+            this->read_failed = len < 0;
+            this->eof = true;
+            break;
+        }
+        filled += len;
+    }
+
+    size_t size = filled;
+    this->carry.clear();
+    if(!this->eof) {
+        const char* last_newline = static_cast<const char*>(::memrchr(chunk.data.get(), '\n', filled));
+        size = last_newline - chunk.data.get() + 1;
+        this->carry.assign(chunk.data.get() + size, filled - size);
+    }
+
+    if(size == 0)
+        return false;
+
+    std::memset(chunk.data.get() + size, 0, SourceBuffer::PADDING);
+    chunk.size = size;
+    this->current_offset += this->chunks[this->current].size;
+    this->current = index;
+    return true;
+}
@@ -4,7 +4,13 @@ StringId StringTable::add(View str) {
     size_t offset = this->string_bytes.size();
     this->string_bytes.insert(this->string_bytes.end(), str.begin(), str.end());
     Id id = this->strings.size();
-    this->strings.push_back({offset, str.size()});
+    this->strings.push_back({nullptr, offset, str.size()});
+    return id;
+}
+
+StringId StringTable::addReference(View str) {
+    Id id = this->strings.size();
+    this->strings.push_back({str.data(), 0, str.size()});
     return id;
 }
 
@@ -14,7 +20,23 @@ void StringTable::pushToMostRecent(uint8_t c) {
     ++str.length;
 }
 
+void StringTable::appendToMostRecent(View str) {
+    this->string_bytes.insert(this->string_bytes.end(), str.begin(), str.end());
+    this->strings.back().length += str.size();
+}
+
+StringId StringTable::addAll(const StringTable& other) {
+    Id first = this->strings.size();
+    size_t byte_offset = this->string_bytes.size();
+    this->string_bytes.insert(this->string_bytes.end(), other.string_bytes.begin(), other.string_bytes.end());
+    for(auto [external, offset, length] : other.strings)
+        this->strings.push_back({external, external ? 0 : byte_offset + offset, length});
+    return first;
+}
+
 StringTable::View StringTable::get(StringId id) const {
-    auto [offset, length] = this->strings[id];
-    return View(&this->string_bytes[offset], length);
+    auto [external, offset, length] = this->strings[id];
+    if(external)
+        return View(external, length);
+    return View(this->string_bytes.data() + offset, length);
 }
@@ -37,7 +37,7 @@ void PointerType::print(std::ostream& os) const {
 }
 
 TypeTable::TypeTable() {
-    for (size_t i = size_t{PrimitiveType::VOID}; i < size_t{PrimitiveType::LONG_DOUBLE}; ++i) {
+    for (size_t i = size_t{PrimitiveType::VOID}; i <= size_t{PrimitiveType::LONG_DOUBLE}; ++i) {
         assert(this->types.size() == i);
         this->types.push_back(std::make_unique<PrimitiveType>(static_cast<PrimitiveType::Kind>(i)));
     }
@@ -0,0 +1,482 @@
+#include "lexer/float_literal.hpp"
+#include "float_tables.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+// Decimal literals are converted with the algorithm of Eisel and Lemire (Daniel Lemire,
+// "Number Parsing at a Gigabyte per Second", 2021), which handles nearly all inputs with
+// a 64x128-bit multiplication. The few inputs where its result is ambiguous fall back to
+// an exact computation with big integers.
+
+namespace {
+    struct Format {
+        int mantissa_bits;
+        int min_exponent;
+        int infinite_power;
+        int min_exponent_round_to_even;
+        int max_exponent_round_to_even;
+        int smallest_power_of_ten;
+        int largest_power_of_ten;
+        int max_exponent_fast_path;
+        uint64_t max_mantissa_fast_path;
+    };
+
+    constexpr Format FLOAT_FORMAT = {23, -127, 0xFF, -17, 10, -65, 38, 10, uint64_t(1) << 24};
+    constexpr Format DOUBLE_FORMAT = {52, -1023, 0x7FF, -4, 23, -342, 308, 22, uint64_t(1) << 53};
+
+    constexpr double EXACT_POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    constexpr size_t MAX_MANTISSA_DIGITS = 19;
+    // Enough significant digits to decide the rounding of any double, see the big integer fallback.
+    constexpr size_t MAX_SLOW_PATH_DIGITS = 800;
+
+    const Format& format(FloatFormat type) {
+        return type == FloatFormat::FLOAT ? FLOAT_FORMAT : DOUBLE_FORMAT;
+    }
+
+    // Significant digits of a decimal literal, with leading zeros and digit separators removed.
+    struct DecimalDigits {
+        std::vector<uint8_t> digits;
+        // The value is 0.d1d2d3... * 10^exponent
+        int64_t exponent;
+    };
+
+    // Mantissa and binary exponent of the result as the biased exponent of the format. A power2
+    // of -1 means the fast algorithm could not decide the rounding.
+    struct AdjustedMantissa {
+        uint64_t mantissa;
+        int32_t power2;
+    };
+
+    double toDouble(AdjustedMantissa am, const Format& fmt) {
+        if(am.power2 == fmt.infinite_power)
+            return HUGE_VAL;
+        // Subnormals have a biased exponent of 0, but the same scale as exponent 1.
+        int exponent = std::max(am.power2, 1) + fmt.min_exponent - fmt.mantissa_bits;
+        uint64_t mantissa = am.mantissa;
+        if(am.power2 != 0)
+            mantissa |= uint64_t(1) << fmt.mantissa_bits;
+        return std::ldexp(double(mantissa), exponent);
+    }
+
+    struct Product {
+        uint64_t low;
+        uint64_t high;
+    };
+
+    Product multiply(uint64_t a, uint64_t b) {
+        unsigned __int128 r = (unsigned __int128)a * b;
+        return {uint64_t(r), uint64_t(r >> 64)};
+    }
+
+    AdjustedMantissa computeFloat(int64_t q, uint64_t w, const Format& fmt) {
+        if(w == 0 || q < fmt.smallest_power_of_ten)
+            return {0, 0};
+        if(q > fmt.largest_power_of_ten)
+            return {0, fmt.infinite_power};
+
+        int lz = __builtin_clzll(w);
+        w <<= lz;
+
+        // Approximate w * 5^q with enough precision for the mantissa plus three bits.
+        size_t index = 2 * (q - SMALLEST_POWER_OF_FIVE);
+        int bit_precision = fmt.mantissa_bits + 3;
+        uint64_t precision_mask = ~uint64_t(0) >> bit_precision;
+        Product product = multiply(w, POWERS_OF_FIVE_128[index]);
+        if((product.high & precision_mask) == precision_mask) {
+            Product second = multiply(w, POWERS_OF_FIVE_128[index + 1]);
+            product.low += second.high;
+            if(second.high > product.low)
+                ++product.high;
+        }
+
+        if(product.low == ~uint64_t(0) && (q < -27 || q > 55))
+            return {0, -1};
+
+        int upperbit = product.high >> 63;
+        AdjustedMantissa answer;
+        answer.mantissa = product.high >> (upperbit + 64 - fmt.mantissa_bits - 3);
+        // floor(log2(10^q)) + 63, computed as in the paper
+        int32_t power = int32_t(((152170 + 65536) * q) >> 16) + 63;
+        answer.power2 = power + upperbit - lz - fmt.min_exponent;
+
+        if(answer.power2 <= 0) {
+            // Subnormal result
+            if(-answer.power2 + 1 >= 64)
+                return {0, 0};
+            answer.mantissa >>= -answer.power2 + 1;
+            answer.mantissa += answer.mantissa & 1;
+            answer.mantissa >>= 1;
+            answer.power2 = answer.mantissa < (uint64_t(1) << fmt.mantissa_bits) ? 0 : 1;
+            return answer;
+        }
+
+        // Exactly halfway between two floats: round to even instead of up.
+        if(product.low <= 1 && q >= fmt.min_exponent_round_to_even && q <= fmt.max_exponent_round_to_even &&
+                (answer.mantissa & 3) == 1) {
+            if((answer.mantissa << (upperbit + 64 - fmt.mantissa_bits - 3)) == product.high)
+                answer.mantissa &= ~uint64_t(1);
+        }
+
+        answer.mantissa += answer.mantissa & 1;
+        answer.mantissa >>= 1;
+        if(answer.mantissa >= (uint64_t(2) << fmt.mantissa_bits)) {
+            answer.mantissa = uint64_t(1) << fmt.mantissa_bits;
+            ++answer.power2;
+        }
+
+        answer.mantissa &= ~(uint64_t(1) << fmt.mantissa_bits);
+        if(answer.power2 >= fmt.infinite_power)
+            return {0, fmt.infinite_power};
+        return answer;
+    }
+
+    // Minimal arbitrary precision unsigned integer for the exact fallback.
+    class BigInt {
+    private:
+        std::vector<uint32_t> limbs;
+
+        void trim() {
+            while(!this->limbs.empty() && this->limbs.back() == 0)
+                this->limbs.pop_back();
+        }
+    public:
+        explicit BigInt(uint32_t value) {
+            if(value != 0)
+                this->limbs.push_back(value);
+        }
+
+        void multiplyAdd(uint32_t factor, uint32_t addend) {
+            uint64_t carry = addend;
+            for(auto& limb : this->limbs) {
+                uint64_t r = uint64_t(limb) * factor + carry;
+                limb = uint32_t(r);
+                carry = r >> 32;
+            }
+            if(carry != 0)
+                this->limbs.push_back(carry);
+        }
+
+        void multiplyPow10(size_t exponent) {
+            for(; exponent >= 9; exponent -= 9)
+                this->multiplyAdd(1000000000, 0);
+            for(; exponent > 0; --exponent)
+                this->multiplyAdd(10, 0);
+        }
+
+        void shiftLeft(size_t bits) {
+            if(this->limbs.empty())
+                return;
+            size_t words = bits / 32;
+            bits %= 32;
+            if(bits != 0) {
+                uint32_t carry = 0;
+                for(auto& limb : this->limbs) {
+                    uint32_t next = limb >> (32 - bits);
+                    limb = (limb << bits) | carry;
+                    carry = next;
+                }
+                if(carry != 0)
+                    this->limbs.push_back(carry);
+            }
+            this->limbs.insert(this->limbs.begin(), words, 0);
+        }
+
+        size_t bitLength() const {
+            if(this->limbs.empty())
+                return 0;
+            return this->limbs.size() * 32 - __builtin_clz(this->limbs.back());
+        }
+
+        int compare(const BigInt& other) const {
+            if(this->limbs.size() != other.limbs.size())
+                return this->limbs.size() < other.limbs.size() ? -1 : 1;
+            for(size_t i = this->limbs.size(); i-- > 0;) {
+                if(this->limbs[i] != other.limbs[i])
+                    return this->limbs[i] < other.limbs[i] ? -1 : 1;
+            }
+            return 0;
+        }
+
+        void subtract(const BigInt& other) {
+            int64_t borrow = 0;
+            for(size_t i = 0; i < this->limbs.size(); ++i) {
+                int64_t r = int64_t(this->limbs[i]) - (i < other.limbs.size() ? other.limbs[i] : 0) - borrow;
+                borrow = r < 0;
+                this->limbs[i] = uint32_t(r);
+            }
+            this->trim();
+        }
+
+        bool isZero() const {
+            return this->limbs.empty();
+        }
+    };
+
+    // Computes floor(numerator / denominator) for a quotient below 2^64, leaving the remainder in numerator.
+    uint64_t divide(BigInt& numerator, const BigInt& denominator) {
+        uint64_t quotient = 0;
+        for(int bit = 63; bit >= 0; --bit) {
+            BigInt shifted = denominator;
+            shifted.shiftLeft(bit);
+            if(numerator.compare(shifted) >= 0) {
+                numerator.subtract(shifted);
+                quotient |= uint64_t(1) << bit;
+            }
+        }
+        return quotient;
+    }
+
+    // Exact conversion: computes the value as a fraction of big integers and rounds it to nearest even.
+    double convertExact(const DecimalDigits& decimal, const Format& fmt) {
+        BigInt numerator(0);
+        for(uint8_t digit : decimal.digits)
+            numerator.multiplyAdd(10, digit);
+
+        // value = numerator * 10^scale
+        int64_t scale = decimal.exponent - int64_t(decimal.digits.size());
+        BigInt denominator(1);
+        if(scale >= 0)
+            numerator.multiplyPow10(scale);
+        else
+            denominator.multiplyPow10(-scale);
+
+        // Binary exponent of the leading bit: 2^e <= value < 2^(e+1)
+        int64_t e = int64_t(numerator.bitLength()) - int64_t(denominator.bitLength());
+        {
+            BigInt n = numerator;
+            BigInt d = denominator;
+            if(e >= 0)
+                d.shiftLeft(e);
+            else
+                n.shiftLeft(-e);
+            if(n.compare(d) < 0)
+                --e;
+        }
+
+        int64_t min_normal_exponent = fmt.min_exponent + 1;
+        if(e > -fmt.min_exponent)
+            return HUGE_VAL;
+
+        // Exponent of the least significant mantissa bit, lower for subnormals.
+        int64_t lsb = std::max(e, min_normal_exponent) - fmt.mantissa_bits;
+        if(e < lsb - 1)
+            return 0.0;
+
+        // Compute the mantissa with one extra rounding bit.
+        int64_t shift = 1 - lsb;
+        if(shift >= 0)
+            numerator.shiftLeft(shift);
+        else
+            denominator.shiftLeft(-shift);
+        uint64_t quotient = divide(numerator, denominator);
+
+        bool round_bit = quotient & 1;
+        bool sticky = !numerator.isZero();
+        uint64_t mantissa = quotient >> 1;
+        if(round_bit && (sticky || (mantissa & 1)))
+            ++mantissa;
+
+        return std::ldexp(double(mantissa), lsb);
+    }
+
+    DecimalDigits scanDecimal(std::string_view text) {
+        DecimalDigits result = {{}, 0};
+        size_t i = 0;
+        bool seen_point = false;
+        bool truncated = false;
+
+        for(; i < text.size(); ++i) {
+            char c = text[i];
+            if(c == '\'')
+                continue;
+            if(c == '.') {
+                seen_point = true;
+                continue;
+            }
+            if(c < '0' || c > '9')
+                break;
+
+            if(result.digits.empty() && c == '0') {
+                // Leading zeros only move the decimal point
+                if(seen_point)
+                    --result.exponent;
+                continue;
+            }
+
+            if(!seen_point)
+                ++result.exponent;
+            if(result.digits.size() < MAX_SLOW_PATH_DIGITS)
+                result.digits.push_back(c - '0');
+            else if(c != '0')
+                truncated = true;
+        }
+
+        if(i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+            ++i;
+            bool negative = false;
+            if(i < text.size() && (text[i] == '+' || text[i] == '-'))
+                negative = text[i++] == '-';
+
+            int64_t exponent = 0;
+            for(; i < text.size(); ++i) {
+                if(text[i] == '\'')
+                    continue;
+                // Saturate, anything this large is zero or infinity anyway
+                if(exponent < 100000)
+                    exponent = exponent * 10 + (text[i] - '0');
+            }
+            result.exponent += negative ? -exponent : exponent;
+        }
+
+        while(!result.digits.empty() && result.digits.back() == 0)
+            result.digits.pop_back();
+
+        // A nonzero digit past the ones that are kept only matters to break ties,
+        // which an extra 1 at the end does as well.
+        if(truncated)
+            result.digits.push_back(1);
+
+        return result;
+    }
+}
+
+double convertDecimalFloat(std::string_view text, FloatFormat type) {
+    const Format& fmt = format(type);
+    DecimalDigits decimal = scanDecimal(text);
+    if(decimal.digits.empty())
+        return 0.0;
+
+    // The first 19 significant digits, and the power of ten they need to be multiplied with.
+    uint64_t w = 0;
+    size_t num_digits = std::min(decimal.digits.size(), MAX_MANTISSA_DIGITS);
+    for(size_t i = 0; i < num_digits; ++i)
+        w = w * 10 + decimal.digits[i];
+    int64_t q = decimal.exponent - int64_t(num_digits);
+    bool truncated = num_digits < decimal.digits.size();
+
+    if(!truncated) {
+        // Clinger's fast path: both w and 10^|q| are exact, so a single rounding operation is correct.
+        if(q >= -fmt.max_exponent_fast_path && q <= fmt.max_exponent_fast_path && w <= fmt.max_mantissa_fast_path) {
+            if(type == FloatFormat::FLOAT) {
+                float value = float(w);
+                return q < 0 ? value / float(EXACT_POWERS_OF_TEN[-q]) : value * float(EXACT_POWERS_OF_TEN[q]);
+            }
+            double value = double(w);
+            return q < 0 ? value / EXACT_POWERS_OF_TEN[-q] : value * EXACT_POWERS_OF_TEN[q];
+        }
+
+        AdjustedMantissa am = computeFloat(q, w, fmt);
+        if(am.power2 >= 0)
+            return toDouble(am, fmt);
+    }
+    else {
+        // The exact value lies between w and w + 1 times 10^q; if both round the same, so does the value.
+        AdjustedMantissa am = computeFloat(q, w, fmt);
+        AdjustedMantissa am_next = computeFloat(q, w + 1, fmt);
+        if(am.power2 >= 0 && am.power2 == am_next.power2 && am.mantissa == am_next.mantissa)
+            return toDouble(am, fmt);
+    }
+
+    double value = convertExact(decimal, fmt);
+    if(type == FloatFormat::FLOAT && std::isinf(float(value)))
+        return HUGE_VAL;
+    return value;
+}
+
+double convertHexFloat(std::string_view text, FloatFormat type) {
+    const Format& fmt = format(type);
+
+    // Collect the first 60 significant bits, the rest only matter as sticky bit.
+    uint64_t mantissa = 0;
+    int64_t exponent = 0;
+    bool sticky = false;
+    bool seen_point = false;
+
+    size_t i = 2;
+    for(; i < text.size(); ++i) {
+        char c = text[i];
+        if(c == '\'')
+            continue;
+        if(c == '.') {
+            seen_point = true;
+            continue;
+        }
+
+        int digit;
+        if(c >= '0' && c <= '9')
+            digit = c - '0';
+        else if(c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            break;
+
+        if(mantissa >> 56 == 0) {
+            mantissa = mantissa * 16 + digit;
+            if(seen_point)
+                exponent -= 4;
+        }
+        else {
+            sticky |= digit != 0;
+            if(!seen_point)
+                exponent += 4;
+        }
+    }
+
+    if(i < text.size() && (text[i] == 'p' || text[i] == 'P')) {
+        ++i;
+        bool negative = false;
+        if(i < text.size() && (text[i] == '+' || text[i] == '-'))
+            negative = text[i++] == '-';
+
+        int64_t binary_exponent = 0;
+        for(; i < text.size(); ++i) {
+            if(text[i] == '\'')
+                continue;
+            if(binary_exponent < 100000)
+                binary_exponent = binary_exponent * 10 + (text[i] - '0');
+        }
+        exponent += negative ? -binary_exponent : binary_exponent;
+    }
+
+    if(mantissa == 0)
+        return 0.0;
+
+    // value = mantissa * 2^exponent, with a leading bit at 2^e
+    int64_t e = exponent + 63 - __builtin_clzll(mantissa);
+    if(e > -fmt.min_exponent)
+        return HUGE_VAL;
+
+    int64_t lsb = std::max<int64_t>(e, fmt.min_exponent + 1) - fmt.mantissa_bits;
+    int64_t shift = lsb - exponent;
+    if(shift > 0) {
+        if(shift > 64) {
+            sticky |= mantissa != 0;
+            mantissa = 0;
+        }
+        else {
+            uint64_t dropped = shift == 64 ? mantissa : mantissa & ((uint64_t(1) << shift) - 1);
+            uint64_t half = uint64_t(1) << (shift - 1);
+            mantissa = shift == 64 ? 0 : mantissa >> shift;
+            bool round_up = dropped > half || (dropped == half && (sticky || (mantissa & 1)));
+            if(round_up)
+                ++mantissa;
+        }
+    }
+    else
+        mantissa <<= -shift;
+
+    double value = std::ldexp(double(mantissa), lsb);
+    if(type == FloatFormat::FLOAT && std::isinf(float(value)))
+        return HUGE_VAL;
+    return value;
+}
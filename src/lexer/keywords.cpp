@@ -0,0 +1,151 @@
+#include "lexer/keywords.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace {
+    struct Keyword {
+        std::string_view name;
+        TokenType type;
+    };
+
+    constexpr Keyword KEYWORDS[] = {
+        {"and", TokenType::AND},
+        {"and_eq", TokenType::BITAND_ASSIGN},
+        {"asm", TokenType::KEY_ASM},
+        {"auto", TokenType::KEY_AUTO},
+        {"bitand", TokenType::BITAND},
+        {"bitor", TokenType::BITOR},
+        {"bool", TokenType::KEY_BOOL},
+        {"break", TokenType::KEY_BREAK},
+        {"case", TokenType::KEY_CASE},
+        {"class", TokenType::KEY_CLASS},
+        {"compl", TokenType::BITNOT},
+        {"const", TokenType::KEY_CONST},
+        {"const_cast", TokenType::KEY_CONST_CAST},
+        {"continue", TokenType::KEY_CONTINUE},
+        {"default", TokenType::KEY_DEFAULT},
+        {"delete", TokenType::KEY_DELETE},
+        {"do", TokenType::KEY_DO},
+        {"double", TokenType::KEY_DOUBLE},
+        {"dynamic_cast", TokenType::KEY_DYNAMIC_CAST},
+        {"else", TokenType::KEY_ELSE},
+        {"enum", TokenType::KEY_ENUM},
+        {"explicit", TokenType::KEY_EXPLICIT},
+        {"export", TokenType::KEY_EXPORT},
+        {"extern", TokenType::KEY_EXTERN},
+        {"false", TokenType::KEY_FALSE},
+        {"float", TokenType::KEY_FLOAT},
+        {"for", TokenType::KEY_FOR},
+        {"friend", TokenType::KEY_FRIEND},
+        {"goto", TokenType::KEY_GOTO},
+        {"if", TokenType::KEY_IF},
+        {"inline", TokenType::KEY_INLINE},
+        {"int", TokenType::KEY_INT},
+        {"long", TokenType::KEY_LONG},
+        {"mutable", TokenType::KEY_MUTABLE},
+        {"namespace", TokenType::KEY_NAMESPACE},
+        {"new", TokenType::KEY_NEW},
+        {"not", TokenType::NOT},
+        {"not_eq", TokenType::NOTEQUAL},
+        {"operator", TokenType::KEY_OPERATOR},
+        {"or", TokenType::OR},
+        {"or_eq", TokenType::BITOR_ASSIGN},
+        {"private", TokenType::KEY_PRIVATE},
+        {"protected", TokenType::KEY_PROTECTED},
+        {"public", TokenType::KEY_PUBLIC},
+        {"register", TokenType::KEY_REGISTER},
+        {"reinterpret_cast", TokenType::KEY_REINTERPRET_CAST},
+        {"return", TokenType::KEY_RETURN},
+        {"short", TokenType::KEY_SHORT},
+        {"signed", TokenType::KEY_SIGNED},
+        {"sizeof", TokenType::KEY_SIZEOF},
+        {"static", TokenType::KEY_STATIC},
+        {"static_cast", TokenType::KEY_STATIC_CAST},
+        {"struct", TokenType::KEY_STRUCT},
+        {"switch", TokenType::KEY_SWITCH},
+        {"template", TokenType::KEY_TEMPLATE},
+        {"this", TokenType::KEY_THIS},
+        {"throw", TokenType::KEY_THROW},
+        {"true", TokenType::KEY_TRUE},
+        {"try", TokenType::KEY_TRY},
+        {"typedef", TokenType::KEY_TYPEDEF},
+        {"typeid", TokenType::KEY_TYPEID},
+        {"typename", TokenType::KEY_TYPENAME},
+        {"union", TokenType::KEY_UNION},
+        {"unsigned", TokenType::KEY_UNSIGNED},
+        {"using", TokenType::KEY_USING},
+        {"virtual", TokenType::KEY_VIRTUAL},
+        {"void", TokenType::KEY_VOID},
+        {"volatile", TokenType::KEY_VOLATILE},
+        {"wchar_t", TokenType::KEY_WCHAR_T},
+        {"while", TokenType::KEY_WHILE},
+        {"xor", TokenType::XOR},
+        {"xor_eq", TokenType::XOR_ASSIGN},
+    };
+
+    constexpr size_t NUM_KEYWORDS = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+    constexpr size_t MIN_KEYWORD_LENGTH = 2;
+    constexpr size_t MAX_KEYWORD_LENGTH = 16;
+
+    constexpr size_t TABLE_BITS = 9;
+    constexpr size_t TABLE_SIZE = size_t(1) << TABLE_BITS;
+
+    static_assert(NUM_KEYWORDS < TABLE_SIZE);
+
+    // Hashes the length and the first, second and last character. All keywords differ in at
+    // least one of these, so the multiplier only needs to spread them over the table without collisions.
+    constexpr uint32_t keywordHash(std::string_view id, uint32_t multiplier) {
+        uint32_t key = uint32_t(uint8_t(id[0])) |
+            uint32_t(uint8_t(id[1])) << 8 |
+            uint32_t(uint8_t(id[id.size() - 1])) << 16 |
+            uint32_t(id.size()) << 24;
+        return (key * multiplier) >> (32 - TABLE_BITS);
+    }
+
+    constexpr bool isPerfect(uint32_t multiplier) {
+        bool used[TABLE_SIZE] = {};
+        for(const auto& keyword : KEYWORDS) {
+            uint32_t slot = keywordHash(keyword.name, multiplier);
+            if(used[slot])
+                return false;
+            used[slot] = true;
+        }
+        return true;
+    }
+
+    constexpr uint32_t findMultiplier() {
+        // Odd multipliers starting from the 32-bit golden ratio constant
+        for(uint32_t multiplier = 0x9E3779B1;; multiplier += 2) {
+            if(isPerfect(multiplier))
+                return multiplier;
+        }
+    }
+
+    constexpr uint32_t KEYWORD_MULTIPLIER = findMultiplier();
+
+    // Maps each hash slot to 1 + the index of its keyword in KEYWORDS, or 0 for an empty slot.
+    constexpr std::array<uint8_t, TABLE_SIZE> buildKeywordSlots() {
+        std::array<uint8_t, TABLE_SIZE> slots = {};
+        for(size_t i = 0; i < NUM_KEYWORDS; ++i)
+            slots[keywordHash(KEYWORDS[i].name, KEYWORD_MULTIPLIER)] = i + 1;
+        return slots;
+    }
+
+    constexpr std::array<uint8_t, TABLE_SIZE> KEYWORD_SLOTS = buildKeywordSlots();
+}
+
+TokenType lookupKeyword(std::string_view id) {
+    if(id.size() < MIN_KEYWORD_LENGTH || id.size() > MAX_KEYWORD_LENGTH)
+        return TokenType::ID;
+
+    uint8_t slot = KEYWORD_SLOTS[keywordHash(id, KEYWORD_MULTIPLIER)];
+    if(slot == 0)
+        return TokenType::ID;
+
+    const Keyword& keyword = KEYWORDS[slot - 1];
+    if(keyword.name != id)
+        return TokenType::ID;
+    return keyword.type;
+}
@@ -1,181 +1,534 @@
 #include "lexer/lexer.hpp"
+#include "lexer/keywords.hpp"
+#include "lexer/float_literal.hpp"
 #include "unicode.hpp"
 
-#include <sstream>
+#include <array>
+#include <bit>
+#include <cstring>
 #include <string>
-#include <unordered_map>
 #include <cassert>
 #include <iostream>
 #include <limits>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+    enum CharClass : uint8_t {
+        CHAR_ID = 1 << 0,
+        CHAR_DIGIT = 1 << 1,
+        CHAR_WHITESPACE = 1 << 2,
+        CHAR_PUNCTUATOR = 1 << 3,
+    };
 
-const std::unordered_map<std::string_view, TokenType> KEYWORD_TYPES = {
-    {"and", TokenType::AND},
-    {"and_eq", TokenType::BITAND_ASSIGN},
-    {"asm", TokenType::KEY_ASM},
-    {"auto", TokenType::KEY_AUTO},
-    {"bitand", TokenType::BITAND},
-    {"bitor", TokenType::BITOR},
-    {"bool", TokenType::KEY_BOOL},
-    {"break", TokenType::KEY_BREAK},
-    {"case", TokenType::KEY_CASE},
-    {"class", TokenType::KEY_CLASS},
-    {"compl", TokenType::BITNOT},
-    {"const", TokenType::KEY_CONST},
-    {"const_cast", TokenType::KEY_CONST_CAST},
-    {"continue", TokenType::KEY_CONTINUE},
-    {"default", TokenType::KEY_DEFAULT},
-    {"delete", TokenType::KEY_DELETE},
-    {"do", TokenType::KEY_DO},
-    {"double", TokenType::KEY_DOUBLE},
-    {"dynamic_cast", TokenType::KEY_DYNAMIC_CAST},
-    {"else", TokenType::KEY_ELSE},
-    {"enum", TokenType::KEY_ENUM},
-    {"explicit", TokenType::KEY_EXPLICIT},
-    {"export", TokenType::KEY_EXPORT},
-    {"extern", TokenType::KEY_EXTERN},
-    {"false", TokenType::KEY_FALSE},
-    {"float", TokenType::KEY_FLOAT},
-    {"for", TokenType::KEY_FOR},
-    {"friend", TokenType::KEY_FRIEND},
-    {"goto", TokenType::KEY_GOTO},
-    {"if", TokenType::KEY_IF},
-    {"inline", TokenType::KEY_INLINE},
-    {"int", TokenType::KEY_INT},
-    {"long", TokenType::KEY_LONG},
-    {"mutable", TokenType::KEY_MUTABLE},
-    {"namespace", TokenType::KEY_NAMESPACE},
-    {"new", TokenType::KEY_NEW},
-    {"not", TokenType::NOT},
-    {"not_eq", TokenType::NOTEQUAL},
-    {"operator", TokenType::KEY_OPERATOR},
-    {"or", TokenType::OR},
-    {"or_eq", TokenType::BITOR_ASSIGN},
-    {"private", TokenType::KEY_PRIVATE},
-    {"protected", TokenType::KEY_PROTECTED},
-    {"public", TokenType::KEY_PUBLIC},
-    {"register", TokenType::KEY_REGISTER},
-    {"reinterpret_cast", TokenType::KEY_REINTERPRET_CAST},
-    {"return", TokenType::KEY_RETURN},
-    {"short", TokenType::KEY_SHORT},
-    {"signed", TokenType::KEY_SIGNED},
-    {"sizeof", TokenType::KEY_SIZEOF},
-    {"static", TokenType::KEY_STATIC},
-    {"static_cast", TokenType::KEY_STATIC_CAST},
-    {"struct", TokenType::KEY_STRUCT},
-    {"switch", TokenType::KEY_SWITCH},
-    {"template", TokenType::KEY_TEMPLATE},
-    {"this", TokenType::KEY_THIS},
-    {"throw", TokenType::KEY_THROW},
-    {"true", TokenType::KEY_TRUE},
-    {"try", TokenType::KEY_TRY},
-    {"typedef", TokenType::KEY_TYPEDEF},
-    {"typeid", TokenType::KEY_TYPEID},
-    {"typename", TokenType::KEY_TYPENAME},
-    {"union", TokenType::KEY_UNION},
-    {"unsigned", TokenType::KEY_UNSIGNED},
-    {"using", TokenType::KEY_USING},
-    {"virtual", TokenType::KEY_VIRTUAL},
-    {"void", TokenType::KEY_VOID},
-    {"volatile", TokenType::KEY_VOLATILE},
-    {"wchar_t", TokenType::KEY_WCHAR_T},
-    {"while", TokenType::KEY_WHILE},
-    {"xor", TokenType::XOR},
-    {"xor_eq", TokenType::XOR_ASSIGN},
-};
-
-Lexer::Lexer(std::string_view input, CompileInfo& compile_info) :
-    input(input), input_offset(0), position({1, 1, 0}), token_start_offset(0),
-    made_token_on_line(false), compile_info(compile_info) {
-    this->compile_info.files.addFile("<unknown>");
-}
-
-int Lexer::read() {
-    ++this->position.column;
-    if(this->input_offset >= this->input.size()) {
-        ++this->input_offset;
-        return -1;
+    struct Punctuator {
+        std::string_view spelling;
+        TokenType type;
+    };
+
+    constexpr Punctuator PUNCTUATORS[] = {
+        {"+", TokenType::PLUS},
+        {"++", TokenType::INCREMENT},
+        {"+=", TokenType::ADD_ASSIGN},
+        {"-", TokenType::MINUS},
+        {"--", TokenType::DECREMENT},
+        {"-=", TokenType::SUB_ASSIGN},
+        {"->", TokenType::ARROW},
+        {"->*", TokenType::STARROW},
+        {"*", TokenType::STAR},
+        {"*=", TokenType::MUL_ASSIGN},
+        {"/", TokenType::DIV},
+        {"/=", TokenType::DIV_ASSIGN},
+        {"%", TokenType::MOD},
+        {"%=", TokenType::MOD_ASSIGN},
+        {"<", TokenType::LESS},
+        {"<<", TokenType::LSHIFT},
+        {"<<=", TokenType::LSHIFT_ASSIGN},
+        {"<=", TokenType::LESSEQ},
+        {">", TokenType::GREATER},
+        {">>", TokenType::RSHIFT},
+        {">>=", TokenType::RSHIFT_ASSIGN},
+        {">=", TokenType::GREATEREQ},
+        {"&", TokenType::BITAND},
+        {"&&", TokenType::AND},
+        {"&=", TokenType::BITAND_ASSIGN},
+        {"|", TokenType::BITOR},
+        {"||", TokenType::OR},
+        {"|=", TokenType::BITOR_ASSIGN},
+        {"^", TokenType::XOR},
+        {"^=", TokenType::XOR_ASSIGN},
+        {"=", TokenType::ASSIGN},
+        {"==", TokenType::EQUAL},
+        {"!", TokenType::NOT},
+        {"!=", TokenType::NOTEQUAL},
+        {".", TokenType::DOT},
+        {".*", TokenType::DOTSTAR},
+        {":", TokenType::COLON},
+        {"::", TokenType::SCOPE},
+        {"~", TokenType::BITNOT},
+        {"{", TokenType::OPEN_CB},
+        {"}", TokenType::CLOSE_CB},
+        {"(", TokenType::OPEN_PAR},
+        {")", TokenType::CLOSE_PAR},
+        {"[", TokenType::OPEN_SB},
+        {"]", TokenType::CLOSE_SB},
+        {";", TokenType::SEMICOLON},
+        {",", TokenType::COMMA},
+        {"?", TokenType::QUESTION},
+    };
+
+    // Classification of every byte value. Index 255 doubles as the class of end of input (-1),
+    // which has no class.
+    constexpr std::array<uint8_t, 256> buildCharClasses() {
+        std::array<uint8_t, 256> classes = {};
+        for(int c = 'a'; c <= 'z'; ++c)
+            classes[c] |= CHAR_ID;
+        for(int c = 'A'; c <= 'Z'; ++c)
+            classes[c] |= CHAR_ID;
+        for(int c = '0'; c <= '9'; ++c)
+            classes[c] |= CHAR_ID | CHAR_DIGIT;
+        classes['_'] |= CHAR_ID;
+        classes[' '] |= CHAR_WHITESPACE;
+        classes['\t'] |= CHAR_WHITESPACE;
+        classes['\r'] |= CHAR_WHITESPACE;
+        for(const auto& punctuator : PUNCTUATORS)
+            classes[(unsigned char)punctuator.spelling[0]] |= CHAR_PUNCTUATOR;
+        return classes;
+    }
+
+    // Value of every byte as a digit in base 36, or 0xFF if it is not a digit.
+    constexpr std::array<uint8_t, 256> buildDigitValues() {
+        std::array<uint8_t, 256> values = {};
+        for(auto& value : values)
+            value = 0xFF;
+        for(int c = '0'; c <= '9'; ++c)
+            values[c] = c - '0';
+        for(int c = 'a'; c <= 'z'; ++c)
+            values[c] = c - 'a' + 10;
+        for(int c = 'A'; c <= 'Z'; ++c)
+            values[c] = c - 'A' + 10;
+        return values;
+    }
+
+    constexpr std::array<uint8_t, 256> CHAR_CLASSES = buildCharClasses();
+    constexpr std::array<uint8_t, 256> DIGIT_VALUES = buildDigitValues();
+
+    // Trie of all punctuators. Input bytes are first mapped to a column, where column 0 is
+    // any byte that does not occur in a punctuator. State 0 is the start state, which is
+    // never the target of a transition, so a transition to 0 means there is none.
+    struct PunctuatorDfa {
+        static constexpr const size_t MAX_STATES = 64;
+        static constexpr const size_t MAX_COLUMNS = 32;
+
+        std::array<uint8_t, 256> columns;
+        std::array<std::array<uint8_t, MAX_COLUMNS>, MAX_STATES> transitions;
+        std::array<TokenType, MAX_STATES> accept;
+    };
+
+    constexpr PunctuatorDfa buildPunctuatorDfa() {
+        PunctuatorDfa dfa = {};
+        size_t num_columns = 1;
+        size_t num_states = 1;
+
+        for(const auto& punctuator : PUNCTUATORS) {
+            uint8_t state = 0;
+            for(char c : punctuator.spelling) {
+                uint8_t& column = dfa.columns[(unsigned char)c];
+                if(column == 0)
+                    column = num_columns++;
+
+                uint8_t& next = dfa.transitions[state][column];
+                if(next == 0)
+                    next = num_states++;
+                state = next;
+            }
+            dfa.accept[state] = punctuator.type;
+        }
+
+        if(num_columns > PunctuatorDfa::MAX_COLUMNS || num_states > PunctuatorDfa::MAX_STATES)
+            throw "punctuator table too small";
+
+        for(size_t state = 1; state < num_states; ++state) {
+            if(dfa.accept[state] == TokenType::INVALID)
+                throw "every prefix of a punctuator must be a punctuator";
+        }
+
+        return dfa;
+    }
+
+    constexpr PunctuatorDfa PUNCTUATOR_DFA = buildPunctuatorDfa();
+
+    // SWAR (SIMD within a register) helpers for integer literals, operating on 8 input bytes
+    // loaded into a little endian 64-bit word, with the first character in the lowest byte.
+    constexpr uint64_t SWAR_ONES = 0x0101010101010101;
+    constexpr uint64_t SWAR_HIGH_BITS = 0x8080808080808080;
+
+    uint64_t loadSwar(const char* p) {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof word);
+        return word;
+    }
+
+    // High bit of every byte set where lo <= byte <= hi, for words without bytes >= 0x80.
+    constexpr uint64_t swarInRange(uint64_t word, uint8_t lo, uint8_t hi) {
+        uint64_t at_least_lo = word + SWAR_ONES * (0x80 - lo);
+        uint64_t above_hi = word + SWAR_ONES * (0x7F - hi);
+        return at_least_lo & ~above_hi & SWAR_HIGH_BITS;
+    }
+
+    constexpr bool isEightDecimalDigits(uint64_t word) {
+        return (word & SWAR_HIGH_BITS) == 0 && swarInRange(word, '0', '9') == SWAR_HIGH_BITS;
+    }
+
+    // Converts eight decimal digits to their value with three multiplications.
+    constexpr uint32_t parseEightDecimalDigits(uint64_t word) {
+        word -= SWAR_ONES * '0';
+        word = word * 10 + (word >> 8);
+        word = ((word & 0x000000FF000000FF) * (100 + (1000000ULL << 32)) +
+            ((word >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32))) >> 32;
+        return word;
+    }
+
+    // Returns the value of eight hexadecimal digits, or nothing if not all of them are hex digits.
+    constexpr std::optional<uint32_t> parseEightHexDigits(uint64_t word) {
+        if(word & SWAR_HIGH_BITS)
+            return std::nullopt;
+
+        // Folding to lower case maps some control bytes onto digits, so only letters are folded.
+        uint64_t digits = swarInRange(word, '0', '9');
+        uint64_t letters = swarInRange(word | (SWAR_ONES * 0x20), 'a', 'f');
+        if((digits | letters) != SWAR_HIGH_BITS)
+            return std::nullopt;
+
+        // The low nibble of '0'-'9' is the digit value, 'a'-'f' and 'A'-'F' have 1-6 and need 9 more.
+        uint64_t nibbles = (word & (SWAR_ONES * 0x0F)) + (letters >> 7) * 9;
+        // Merge neighbouring nibbles into bytes, then bytes into 16-bit halves, then those into the result.
+        uint64_t bytes = (nibbles * 16 + (nibbles >> 8)) & 0x00FF00FF00FF00FF;
+        uint64_t halves = (bytes * 256 + (bytes >> 16)) & 0x0000FFFF0000FFFF;
+        return uint32_t((halves << 16) | (halves >> 32));
+    }
+
+    // Decodes the code point starting at p and returns its length in bytes. An invalid sequence
+    // ends at the first byte that does not continue it, so a newline or line marker after it is
+    // still lexed, and decodes to U+FFFD, which is not part of any identifier.
+    size_t decodeUtf8(const char* p, uint32_t& cp) {
+        constexpr uint8_t LEAD_MASKS[] = {0, 0x7F, 0x1F, 0x0F, 0x07};
+        constexpr uint32_t REPLACEMENT = 0xFFFD;
+        uint8_t lead = p[0];
+        int length = std::countl_one(lead);
+        if(length == 0) {
+            cp = lead;
+            return 1;
+        }
+        // A continuation byte without a lead byte, or a lead byte for more than 4 bytes
+        if(length == 1 || length > 4) {
+            cp = REPLACEMENT;
+            return 1;
+        }
+
+        cp = lead & LEAD_MASKS[length];
+        for(int i = 1; i < length; ++i) {
+            if((uint8_t(p[i]) & 0xC0) != 0x80) {
+                cp = REPLACEMENT;
+                return i;
+            }
+            cp = (cp << 6) | (p[i] & 0x3F);
+        }
+        return length;
+    }
+
+    // Parses the digits of an integer literal in the given base, including C++14 digit separators,
+    // and returns the number of bytes consumed. On overflow, value wraps around and overflow is set.
+    size_t parseDigits(const char* p, uint64_t base, uint64_t& value, bool& overflow) {
+        constexpr bool swar = std::endian::native == std::endian::little;
+
+        size_t i = 0;
+        while(true) {
+            if constexpr(swar) {
+                if(base == 10) {
+                    for(uint64_t word; isEightDecimalDigits(word = loadSwar(p + i)); i += 8) {
+                        overflow |= __builtin_mul_overflow(value, uint64_t(100000000), &value);
+                        overflow |= __builtin_add_overflow(value, parseEightDecimalDigits(word), &value);
+                    }
+                }
+                else if(base == 16) {
+                    while(auto chunk = parseEightHexDigits(loadSwar(p + i))) {
+                        overflow |= (value >> 32) != 0;
+                        value = (value << 32) | chunk.value();
+                        i += 8;
+                    }
+                }
+            }
+
+            uint8_t digit = DIGIT_VALUES[(unsigned char)p[i]];
+            if(digit < base) {
+                overflow |= __builtin_mul_overflow(value, base, &value);
+                overflow |= __builtin_add_overflow(value, digit, &value);
+                ++i;
+            }
+            else if(p[i] == '\'' && i > 0 && DIGIT_VALUES[(unsigned char)p[i + 1]] < base)
+                ++i;
+            else
+                return i;
+        }
+    }
+
+    // Undoes the escapes GCC writes in line marker filenames: a backslash before a backslash
+    // or quote, and octal escapes for unprintable bytes.
+    std::string unescapeFilename(std::string_view name) {
+        std::string result;
+        result.reserve(name.size());
+        for(size_t i = 0; i < name.size(); ++i) {
+            if(name[i] != '\\' || i + 1 == name.size()) {
+                result += name[i];
+                continue;
+            }
+
+            size_t digits = 0;
+            unsigned value = 0;
+            while(digits < 3 && i + 1 < name.size() && name[i + 1] >= '0' && name[i + 1] <= '7') {
+                value = value * 8 + (name[++i] - '0');
+                ++digits;
+            }
+            result += digits > 0 ? char(value) : name[++i];
+        }
+        return result;
+    }
+}
+
+template <typename Policy>
+BasicLexer<Policy>::BasicLexer(const SourceBuffer& input, CompileInfo& compile_info, std::string_view filename) :
+    input(input.contents()), input_offset(0), stream(nullptr), chunk_offset(0), token_start_offset(0),
+    next_split(0), made_token_on_line(false), in_directive(false), compile_info(compile_info), diagnostics(&compile_info.diagnostics), marker_cache(), marker_cache_next(0) {
+    size_t file_id = this->compile_info.files.addFile(filename);
+    this->buffer_id = this->compile_info.sources.addBuffer(this->input, file_id);
+    this->location_base = this->compile_info.sources.base(this->buffer_id);
+    this->validateInput();
+}
+
+template <typename Policy>
+BasicLexer<Policy>::BasicLexer(SourceStream& input, CompileInfo& compile_info) :
+    input(input.contents()), input_offset(0), stream(&input), chunk_offset(0), token_start_offset(0),
+    next_split(0), made_token_on_line(false), in_directive(false), compile_info(compile_info), diagnostics(&compile_info.diagnostics), marker_cache(), marker_cache_next(0) {
+    size_t file_id = this->compile_info.files.addFile("<unknown>");
+    this->buffer_id = this->compile_info.sources.addStream(file_id);
+    this->location_base = this->compile_info.sources.base(this->buffer_id);
+    this->nextChunk();
+}
+
+template <typename Policy>
+BasicLexer<Policy>::BasicLexer(const SourceBuffer& input, CompileInfo& compile_info, size_t begin) :
+    input(input.contents()), input_offset(begin), stream(nullptr), chunk_offset(0), token_start_offset(begin),
+    next_split(0), made_token_on_line(false), in_directive(false), compile_info(compile_info), diagnostics(&compile_info.diagnostics), marker_cache(), marker_cache_next(0) {
+    size_t file_id = this->compile_info.files.addFile("<unknown>");
+    this->buffer_id = this->compile_info.sources.addBuffer(this->input, file_id);
+    this->location_base = this->compile_info.sources.base(this->buffer_id);
+}
+
+// Validating all input up front means the rest of the lexer can assume well-formed UTF-8.
+// After an invalid sequence, lexing continues, but the bytes are no longer decoded reliably.
+template <typename Policy>
+void BasicLexer<Policy>::validateInput() {
+    if constexpr(!Policy::DIAGNOSTICS)
+        return;
+    size_t invalid = validateUtf8(this->input.data(), this->input.size());
+    if(invalid != this->input.size())
+        this->error(this->location(invalid), "invalid UTF-8 sequence");
+}
+
+// Moves on to the next chunk of a stream. Chunks end after a newline, so this only
+// happens between tokens or inside a multiline comment.
+template <typename Policy>
+bool BasicLexer<Policy>::nextChunk() {
+    if(!this->stream)
+        return false;
+
+    if(!this->stream->next()) {
+        if(this->stream->failed())
+            this->error(this->location(), "could not read input");
+        return false;
     }
-    return (unsigned)this->input[this->input_offset++];
+
+    if constexpr(Policy::LOCATIONS) {
+        if(!this->compile_info.sources.appendStream(this->buffer_id, this->stream->contents())) {
+            this->error(this->location(), "input too large, source locations are limited to 4 GiB");
+            // Lex nothing past the last chunk that fit
+            this->stream = nullptr;
+            return false;
+        }
+    }
+
+    this->input = this->stream->contents();
+    this->input_offset = 0;
+    this->chunk_offset = this->stream->offset();
+    this->location_base = this->compile_info.sources.base(this->buffer_id) + this->chunk_offset;
+    this->validateInput();
+    return true;
 }
 
-void Lexer::unread(size_t num) {
-    this->position.column -= num;
+template <typename Policy>
+int BasicLexer<Policy>::read() {
+    // The input is followed by a zero sentinel, so only a null byte needs the end of input check.
+    int c = (unsigned char)this->input.data()[this->input_offset++];
+    if(c == 0 && this->input_offset > this->input.size())
+        return -1;
+    return c;
+}
+
+template <typename Policy>
+void BasicLexer<Policy>::unread(size_t num) {
     this->input_offset -= num;
 }
 
-Token Lexer::makeToken(TokenType type) {
+template <typename Policy>
+void BasicLexer<Policy>::skip(const SkipResult& skipped) {
+    this->input_offset += skipped.length;
+    if(skipped.newlines > 0)
+        this->made_token_on_line = false;
+}
+
+template <typename Policy>
+SourceLocation BasicLexer<Policy>::location() const {
+    return {uint32_t(this->location_base + this->input_offset)};
+}
+
+template <typename Policy>
+SourceLocation BasicLexer<Policy>::location(size_t offset) const {
+    return {uint32_t(this->location_base + offset)};
+}
+
+template <typename Policy>
+void BasicLexer<Policy>::error(SourceLocation loc, std::string_view msg) {
+    if constexpr(Policy::DIAGNOSTICS)
+        this->diagnostics->error(loc, msg);
+}
+
+template <typename Policy>
+Token BasicLexer<Policy>::makeToken(TokenType type) {
     this->made_token_on_line = true;
 
     Token result;
     result.type = type;
-    result.pos = this->token_start;
-    result.raw = this->tokenString();
+    if constexpr(Policy::LOCATIONS)
+        result.pos = this->location(this->token_start_offset);
+    if constexpr(Policy::RAW)
+        result.raw = this->tokenString();
     return result;
 }
 
-Token Lexer::makeIntToken(TokenType type, PrimitiveType::Kind int_type, uint64_t value) {
+template <typename Policy>
+Token BasicLexer<Policy>::makeIntToken(TokenType type, PrimitiveType::Kind int_type, uint64_t value) {
     Token result = this->makeToken(type);
     result.integer.type = this->compile_info.types.getPrimitiveType(int_type);
     result.integer.value = value;
     return result;
 }
 
-void Lexer::startToken() {
-    this->token_start = this->position;
+template <typename Policy>
+void BasicLexer<Policy>::startToken() {
     this->token_start_offset = this->input_offset;
 }
 
-std::string_view Lexer::tokenString() {
+template <typename Policy>
+std::string_view BasicLexer<Policy>::tokenString() {
     return this->input.substr(this->token_start_offset, this->input_offset - this->token_start_offset);
 }
 
-bool Lexer::isIdChar(int c) {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
-        (c >= '0' && c <= '9') || (c == '_');
+template <typename Policy>
+bool BasicLexer<Policy>::isIdChar(int c) {
+    return c >= 0 && (CHAR_CLASSES[c] & CHAR_ID);
 }
 
-bool Lexer::isDigit(int c, size_t base) {
-    if(c >= '0' && c <= '9')
-        return size_t(c - '0') < base;
-    if(c >= 'a' && c <= 'z')
-        return size_t(c - 'a' + 10) < base;
-    if(c >= 'A' && c <= 'Z')
-        return size_t(c - 'A' + 10) < base;
-    return false;
+// Consumes the code point at the current position if it may start or continue an identifier.
+template <typename Policy>
+bool BasicLexer<Policy>::consumeUnicodeIdChar(bool start) {
+    uint32_t cp;
+    size_t length = decodeUtf8(this->input.data() + this->input_offset, cp);
+    if(start ? !CodePoint{cp}.isXidStart() : !CodePoint{cp}.isXidContinue())
+        return false;
+    this->input_offset += length;
+    return true;
 }
 
-bool Lexer::isHexDigit(int c) {
+template <typename Policy>
+bool BasicLexer<Policy>::isDigit(int c, size_t base) {
+    return c >= 0 && DIGIT_VALUES[c] < base;
+}
+
+template <typename Policy>
+bool BasicLexer<Policy>::isHexDigit(int c) {
     return this->isDigit(c, 16);
 }
 
-bool Lexer::isWhitespace(int c) {
-    return c == ' ' || c == '\t' || c == '\r';
+template <typename Policy>
+bool BasicLexer<Policy>::isWhitespace(int c) {
+    return c >= 0 && (CHAR_CLASSES[c] & CHAR_WHITESPACE);
 }
 
-void Lexer::consumeLine() {
-    int lookahead = this->read();
-    while(lookahead != '\n' && lookahead != -1)
-        lookahead = this->read();
-    this->unread();
+// Records the input from `start` in the current chunk up to the current position.
+template <typename Policy>
+void BasicLexer<Policy>::addTrivia(TriviaKind kind, size_t start) {
+    if constexpr(Policy::TRIVIA) {
+        uint32_t end = this->chunk_offset + this->input_offset;
+        this->trivia.push_back({uint32_t(start), uint32_t(end - start), kind});
+    }
 }
 
-void Lexer::consumeMultiline() {
-    int lookahead = this->read();
-    while(lookahead != -1) {
-        if(lookahead == '*') {
-            lookahead = this->read();
-            if(lookahead == '/')
-                return;
+template <typename Policy>
+void BasicLexer<Policy>::consumeWhitespace() {
+    this->skip(skipWhitespace(this->input.data() + this->input_offset));
+}
+
+template <typename Policy>
+void BasicLexer<Policy>::consumeLine() {
+    while(true) {
+        size_t length = findLineEnd(this->input.data() + this->input_offset);
+        this->input_offset += length;
+
+        if(this->input_offset >= this->input.size() || this->input[this->input_offset] == '\n')
+            return;
+
+        // Null byte in the middle of the line
+        ++this->input_offset;
+    }
+}
+
+template <typename Policy>
+void BasicLexer<Policy>::consumeMultiline() {
+    while(true) {
+        this->skip(findStar(this->input.data() + this->input_offset));
+
+        if(this->input_offset >= this->input.size()) {
+            if(this->nextChunk())
+                continue;
+            break;
         }
 
-        if(lookahead != -1)
-            lookahead = this->read();
+        // Either a null byte or a '*' that may end the comment
+        char c = this->input[this->input_offset];
+        ++this->input_offset;
+
+        if(c == '*' && this->input.data()[this->input_offset] == '/') {
+            ++this->input_offset;
+            return;
+        }
     }
 
-    this->compile_info.diagnostics.error(this->position, "unexpected end of file in multiline comment");
+    this->error(this->location(), "unexpected end of file in multiline comment");
 }
 
-Token Lexer::lexNumber() {
+// Splits passed before the comment starting at `start` are outside of it.
+template <typename Policy>
+void BasicLexer<Policy>::markCommentedSplits(size_t start) {
+    size_t end = this->chunk_offset + this->input_offset;
+    for(; this->next_split < this->splits.size() && this->splits[this->next_split] < end; ++this->next_split) {
+        if(this->splits[this->next_split] > start)
+            this->commented_splits.push_back(this->splits[this->next_split]);
+    }
+}
+
+template <typename Policy>
+Token BasicLexer<Policy>::lexNumber() {
     uint64_t base = 10;
 
     int lookahead = this->read();
@@ -191,28 +544,39 @@ Token Lexer::lexNumber() {
 
         if(base != 8) {
             lookahead = this->read();
-            if(!this->isDigit(lookahead, base)) {
-                this->compile_info.diagnostics.error(this->token_start, "invalid sequence after integer base");
+            if(!this->isDigit(lookahead, base) && !(base == 16 && lookahead == '.')) {
+                this->error(this->location(this->token_start_offset), "invalid sequence after integer base");
                 this->unread();
                 return this->makeIntToken(TokenType::LITERAL_INTEGER, PrimitiveType::INT, 0);
             }
         }
     }
 
+    this->unread();
     uint64_t value = 0;
-    while(this->isDigit(lookahead, base)) {
-        value *= base;
-
-        if(lookahead >= '0' && lookahead <= '9')
-            value += lookahead - '0';
-        if(lookahead >= 'a' && lookahead <= 'z')
-            value += lookahead - 'a' + 10;
-        if(lookahead >= 'A' && lookahead <= 'Z')
-            value += lookahead - 'A' + 10;
-
-        lookahead = this->read();
+    bool overflow = false;
+    size_t num_digits = parseDigits(this->input.data() + this->input_offset, base, value, overflow);
+    lookahead = (unsigned char)this->input.data()[this->input_offset + num_digits];
+
+    if(base == 16 && (lookahead == '.' || lookahead == 'p' || lookahead == 'P'))
+        return this->lexFloat(16);
+    if(base == 10 && (lookahead == '.' || lookahead == 'e' || lookahead == 'E'))
+        return this->lexFloat(10);
+    if(base == 8) {
+        // A leading zero only makes an octal integer, 0123.5 and 09e1 are decimal floating literals.
+        uint64_t ignored = 0;
+        bool ignored_overflow = false;
+        size_t end = this->input_offset + parseDigits(this->input.data() + this->input_offset, 10, ignored, ignored_overflow);
+        lookahead = (unsigned char)this->input.data()[end];
+        if(lookahead == '.' || lookahead == 'e' || lookahead == 'E')
+            return this->lexFloat(10);
     }
 
+    this->input_offset += num_digits;
+    if(overflow)
+        this->error(this->location(this->token_start_offset), "integer literal is too large");
+    lookahead = this->read();
+
     PrimitiveType::Kind data_type;
 
     if(lookahead == 'l' || lookahead == 'L') {
@@ -255,207 +619,112 @@ Token Lexer::lexNumber() {
     return this->makeIntToken(TokenType::LITERAL_INTEGER, data_type, value);
 }
 
-Token Lexer::lexId() {
-    int lookahead = this->read();
-    while(this->isIdChar(lookahead))
-        lookahead = this->read();
-    this->unread(1);
-
-    std::string_view token_content = this->tokenString();
-    if(KEYWORD_TYPES.count(token_content) > 0)
-        return this->makeToken(KEYWORD_TYPES.at(token_content));
-    else
-        return this->makeToken(TokenType::ID);
-}
-
-Token Lexer::lexPlus() {
-    int lookahead = this->read();
-
-    switch(lookahead) {
-        case '+':
-            return this->makeToken(TokenType::INCREMENT);
-        case '=':
-            return this->makeToken(TokenType::ADD_ASSIGN);
+// Lexes a floating literal from the start of the token. Only the extent of the literal is
+// determined here, the conversion is done by the routines in float_literal.cpp.
+template <typename Policy>
+Token BasicLexer<Policy>::lexFloat(uint64_t base) {
+    const char* p = this->input.data();
+    size_t end = this->token_start_offset + (base == 16 ? 2 : 0);
+    uint64_t ignored = 0;
+    bool ignored_overflow = false;
+
+    size_t num_digits = parseDigits(p + end, base, ignored, ignored_overflow);
+    end += num_digits;
+    if(p[end] == '.') {
+        size_t num_fraction_digits = parseDigits(p + end + 1, base, ignored, ignored_overflow);
+        num_digits += num_fraction_digits;
+        end += 1 + num_fraction_digits;
     }
 
-    this->unread();
-    return this->makeToken(TokenType::PLUS);
-}
-
-Token Lexer::lexMinus() {
-    int lookahead = this->read();
-
-    switch(lookahead) {
-        case '>': {
-            lookahead = this->read();
-            if(lookahead == '*')
-                return this->makeToken(TokenType::STARROW);
-            this->unread();
-            return this->makeToken(TokenType::ARROW);
-        }
-        case '-':
-            return this->makeToken(TokenType::DECREMENT);
-        case '=':
-            return this->makeToken(TokenType::SUB_ASSIGN);
+    if(num_digits == 0)
+        this->error(this->location(this->token_start_offset), "hexadecimal floating literal has no digits");
+
+    char exponent_char = base == 16 ? 'p' : 'e';
+    if((p[end] | 0x20) == exponent_char) {
+        size_t exponent_start = end + 1;
+        if(p[exponent_start] == '+' || p[exponent_start] == '-')
+            ++exponent_start;
+        size_t num_exponent_digits = parseDigits(p + exponent_start, 10, ignored, ignored_overflow);
+        if(num_exponent_digits == 0)
+            this->error(this->location(end), "exponent has no digits");
+        end = exponent_start + num_exponent_digits;
     }
+    else if(base == 16)
+        this->error(this->location(end), "hexadecimal floating literal requires an exponent");
 
-    this->unread();
-    return this->makeToken(TokenType::MINUS);
-}
+    std::string_view text = this->input.substr(this->token_start_offset, end - this->token_start_offset);
+    this->input_offset = end;
 
-Token Lexer::lexStar() {
-    int lookahead = this->read();
-
-    if(lookahead == '=')
-        return this->makeToken(TokenType::MUL_ASSIGN);
-
-    this->unread();
-    return this->makeToken(TokenType::STAR);
-}
-
-Token Lexer::lexMod() {
-    int lookahead = this->read();
-
-    if(lookahead == '=')
-        return this->makeToken(TokenType::MOD_ASSIGN);
-
-    this->unread();
-    return this->makeToken(TokenType::MOD);
-}
-
-Token Lexer::lexLt() {
+    PrimitiveType::Kind data_type = PrimitiveType::DOUBLE;
     int lookahead = this->read();
+    if(lookahead == 'f' || lookahead == 'F')
+        data_type = PrimitiveType::FLOAT;
+    else if(lookahead == 'l' || lookahead == 'L')
+        data_type = PrimitiveType::LONG_DOUBLE;
+    else
+        this->unread();
 
-    switch(lookahead) {
-        case '<': {
-            lookahead = this->read();
-            if(lookahead == '=')
-                return this->makeToken(TokenType::LSHIFT_ASSIGN);
-            this->unread();
-            return this->makeToken(TokenType::LSHIFT);
-        }
-        case '=':
-            return this->makeToken(TokenType::LESSEQ);
-    }
+    // Long double literals are stored as double as well, there is no wider type to hold them in the token.
+    FloatFormat format = data_type == PrimitiveType::FLOAT ? FloatFormat::FLOAT : FloatFormat::DOUBLE;
+    double value = base == 16 ? convertHexFloat(text, format) : convertDecimalFloat(text, format);
+    if(std::isinf(value))
+        this->error(this->location(this->token_start_offset), "floating literal is too large");
 
-    this->unread();
-    return this->makeToken(TokenType::LESS);
+    Token result = this->makeToken(TokenType::LITERAL_FLOAT);
+    result.floating.type = this->compile_info.types.getPrimitiveType(data_type);
+    result.floating.value = value;
+    return result;
 }
 
-Token Lexer::lexGt() {
-    int lookahead = this->read();
-
-    switch(lookahead) {
-        case '>': {
+template <typename Policy>
+Token BasicLexer<Policy>::lexId() {
+    while(true) {
+        int lookahead = this->read();
+        while(this->isIdChar(lookahead))
             lookahead = this->read();
-            if(lookahead == '=')
-                return this->makeToken(TokenType::RSHIFT_ASSIGN);
-            this->unread();
-            return this->makeToken(TokenType::RSHIFT);
-        }
-        case '=':
-            return this->makeToken(TokenType::GREATEREQ);
-    }
-
-    this->unread();
-    return this->makeToken(TokenType::GREATER);
-}
-
-Token Lexer::lexAnd() {
-    int lookahead = this->read();
+        this->unread(1);
 
-    switch(lookahead) {
-        case '&':
-            return this->makeToken(TokenType::AND);
-        case '=':
-            return this->makeToken(TokenType::BITAND_ASSIGN);
+        // Only bytes outside of ASCII leave the table based loop for a Unicode lookup.
+        if(lookahead < 0x80 || !this->consumeUnicodeIdChar(false))
+            break;
     }
 
-    this->unread();
-    return this->makeToken(TokenType::BITAND);
+    return this->makeToken(lookupKeyword(this->tokenString()));
 }
 
-Token Lexer::lexOr() {
-    int lookahead = this->read();
-
-    switch(lookahead) {
-        case '|':
-            return this->makeToken(TokenType::OR);
-        case '=':
-            return this->makeToken(TokenType::BITOR_ASSIGN);
+template <typename Policy>
+Token BasicLexer<Policy>::lexPunctuator(int first) {
+    // Punctuators are prefix closed, so the longest match is found by following
+    // transitions until there are none, without ever having to back up.
+    uint8_t state = PUNCTUATOR_DFA.transitions[0][PUNCTUATOR_DFA.columns[first]];
+    while(true) {
+        uint8_t column = PUNCTUATOR_DFA.columns[(unsigned char)this->input.data()[this->input_offset]];
+        uint8_t next = PUNCTUATOR_DFA.transitions[state][column];
+        if(next == 0)
+            break;
+        state = next;
+        ++this->input_offset;
     }
-
-    this->unread();
-    return this->makeToken(TokenType::BITOR);
-}
-
-Token Lexer::lexXor() {
-    int lookahead = this->read();
-
-    if(lookahead == '=')
-        return this->makeToken(TokenType::XOR_ASSIGN);
-
-    this->unread();
-    return this->makeToken(TokenType::XOR);
-}
-
-Token Lexer::lexAssign() {
-    int lookahead = this->read();
-
-    if(lookahead == '=')
-        return this->makeToken(TokenType::EQUAL);
-
-    this->unread();
-    return this->makeToken(TokenType::ASSIGN);
+    return this->makeToken(PUNCTUATOR_DFA.accept[state]);
 }
 
-Token Lexer::lexNot() {
-    int lookahead = this->read();
-
-    if(lookahead == '=')
-        return this->makeToken(TokenType::NOTEQUAL);
-
-    this->unread();
-    return this->makeToken(TokenType::NOT);
-}
-
-Token Lexer::lexDot() {
-    int lookahead = this->read();
-    if(lookahead == '*')
-        return this->makeToken(TokenType::DOTSTAR);
-
-    this->unread();
-    return this->makeToken(TokenType::DOT);
-}
-
-Token Lexer::lexColon() {
-    int lookahead = this->read();
-    if(lookahead == ':')
-        return this->makeToken(TokenType::SCOPE);
-
-    this->unread();
-    return this->makeToken(TokenType::COLON);
-}
-
-std::optional<uint32_t> Lexer::lexEscapeLiteral(uint32_t base, size_t length, bool allow_shorter, uint32_t max_value) {
+template <typename Policy>
+std::optional<uint32_t> BasicLexer<Policy>::lexEscapeLiteral(uint32_t base, size_t length, bool allow_shorter, uint32_t max_value) {
     uint32_t value = 0;
     for(size_t i = 0; length == 0 || i < length; ++i) {
         int c = this->read();
         if(c < 0) {
-            this->compile_info.diagnostics.error(this->position, "unexpected end of input");
+            this->error(this->location(), "unexpected end of input");
             return std::nullopt;
         }
 
-        uint32_t digit = (c >= '0' && c <= '9') ? c - '0' :
-            (c >= 'a' && c <= 'z') ? c - 'a' + 10 :
-            (c >= 'A' && c <= 'Z') ? c - 'A' + 10 :
-            base;
+        uint32_t digit = DIGIT_VALUES[c];
 
         if(digit >= base) {
             this->unread();
             if(allow_shorter && i > 0)
                 return value;
-            this->compile_info.diagnostics.error(this->position, "invalid escape sequence value");
+            this->error(this->location(), "invalid escape sequence value");
             return std::nullopt;
         }
 
@@ -463,7 +732,7 @@ std::optional<uint32_t> Lexer::lexEscapeLiteral(uint32_t base, size_t length, bo
             // Overflow
             std::cout << (char) c << " " << value << " " << (max_value / value)  << std::endl;
             this->unread();
-            this->compile_info.diagnostics.error(this->position, "escape sequence value out of range");
+            this->error(this->location(), "escape sequence value out of range");
             return std::nullopt;
         }
 
@@ -473,14 +742,15 @@ std::optional<uint32_t> Lexer::lexEscapeLiteral(uint32_t base, size_t length, bo
     return value;
 }
 
-Lexer::Char Lexer::lexEscapeSequence() {
+template <typename Policy>
+auto BasicLexer<Policy>::lexEscapeSequence() -> Char {
     constexpr Char invalid = {{}, 0};
 
-    auto loc = this->position;
+    auto loc = this->location();
     auto utf8 = [loc, this](uint32_t codepoint) {
         auto cp = CodePoint{codepoint};
         if (!cp.isValidUtf8())
-            this->compile_info.diagnostics.error(loc, "invalid universal character constant");
+            this->error(loc, "invalid universal character constant");
         Char result;
         uint8_t i = 0;
         for (auto c : cp.toUtf8()) {
@@ -500,7 +770,7 @@ Lexer::Char Lexer::lexEscapeSequence() {
     int c = this->read();
     switch (c) {
         case -1:
-            this->compile_info.diagnostics.error(this->position, "unexpected end of escape sequence");
+            this->error(this->location(), "unexpected end of escape sequence");
             return invalid;
         case '\'':
         case '"':
@@ -543,20 +813,38 @@ Lexer::Char Lexer::lexEscapeSequence() {
                 return invalid;
             }
             this->unread();
-            this->compile_info.diagnostics.error(this->position, "invalid escape sequence");
+            this->error(this->location(), "invalid escape sequence");
             return invalid;
     }
 }
 
-Token Lexer::lexStringLiteral() {
-    auto str = this->compile_info.strings.add({});
+template <typename Policy>
+Token BasicLexer<Policy>::lexStringLiteral() {
+    using View = StringTable::View;
+    auto bytes = [this](size_t offset, size_t length) {
+        return View(reinterpret_cast<const uint8_t*>(this->input.data()) + offset, length);
+    };
 
-    auto makeStringToken = [this, str]{
+    StringId str;
+    auto makeStringToken = [this, &str]{
         auto tok = this->makeToken(TokenType::LITERAL_STRING);
         tok.string_literal = str;
         return tok;
     };
 
+    size_t length = findStringEnd(this->input.data() + this->input_offset);
+
+    // Literals without escape sequences are referenced in the source instead of copied,
+    // unless the source is a stream whose chunks are reused.
+    if(this->input.data()[this->input_offset + length] == '"' && !this->stream) {
+        str = this->compile_info.strings.addReference(bytes(this->input_offset, length));
+        this->input_offset += length + 1;
+        return makeStringToken();
+    }
+
+    str = this->compile_info.strings.add(bytes(this->input_offset, length));
+    this->input_offset += length;
+
     while(true) {
         int c = this->read();
         switch (c) {
@@ -572,20 +860,27 @@ Token Lexer::lexStringLiteral() {
             }
             case '\n':
                 this->unread();
-                this->compile_info.diagnostics.error(this->position, "newline in string literal");
+                this->error(this->location(), "newline in string literal");
                 return makeStringToken();
             case -1:
-                this->compile_info.diagnostics.error(this->position, "unexpected end of string literal");
+                this->error(this->location(), "unexpected end of string literal");
                 return makeStringToken();
             default:
+                // Null byte in the middle of the literal
                 this->compile_info.strings.pushToMostRecent(c);
                 break;
         }
+
+        // Append everything up to the next special character at once.
+        length = findStringEnd(this->input.data() + this->input_offset);
+        this->compile_info.strings.appendToMostRecent(bytes(this->input_offset, length));
+        this->input_offset += length;
     }
 }
 
-Token Lexer::lexCharLiteral() {
-    auto loc = this->position;
+template <typename Policy>
+Token BasicLexer<Policy>::lexCharLiteral() {
+    auto loc = this->location();
     int c = this->read();
     uint8_t char_literal = 'b';
     auto makeCharToken = [this, char_literal]{
@@ -595,30 +890,30 @@ Token Lexer::lexCharLiteral() {
     };
     switch (c) {
         case '\'':
-            this->compile_info.diagnostics.error(loc, "empty character literal");
+            this->error(loc, "empty character literal");
             break;
         case '\\': {
             auto chr = this->lexEscapeSequence();
             if(chr.len > 1) {
-                this->compile_info.diagnostics.error(loc, "character literal too large");
+                this->error(loc, "character literal too large");
             }else if(chr.len != 0)
                 char_literal = chr.bytes[0];
             break;
         }
         case '\n':
             this->unread();
-            this->compile_info.diagnostics.error(loc, "newline in character literal");
+            this->error(loc, "newline in character literal");
             return makeCharToken();
         case -1:
             this->unread();
-            this->compile_info.diagnostics.error(loc, "unexpected end of character literal");
+            this->error(loc, "unexpected end of character literal");
             return makeCharToken();
         default:
             char_literal = c;
             break;
     }
 
-    loc = this->position;
+    loc = this->location();
     c = this->read();
     if (c != '\'') {
         // Attempt to still find a closing quote or newline
@@ -626,13 +921,13 @@ Token Lexer::lexCharLiteral() {
         while (!end) {
             switch (c) {
                 case '\'':
-                    this->compile_info.diagnostics.error(loc, "multi-character character literal");
+                    this->error(loc, "multi-character character literal");
                     end = true;
                     break;
                 case -1:
                 case '\n':
                     this->unread();
-                    this->compile_info.diagnostics.error(loc, "unterminated character literal");
+                    this->error(loc, "unterminated character literal");
                     end = true;
                     break;
                 default:
@@ -645,17 +940,40 @@ Token Lexer::lexCharLiteral() {
     return makeCharToken();
 }
 
-void Lexer::lexPreprocessor() {
-    auto pos = this->position;
+// Returns the file id of a line marker filename without escapes.
+template <typename Policy>
+size_t BasicLexer<Policy>::lookupMarkerFile(std::string_view name) {
+    for(const auto& [cached_name, file_id] : this->marker_cache) {
+        if(cached_name.data() && cached_name == name)
+            return file_id;
+    }
+
+    size_t file_id = this->compile_info.files.addFile(name);
+    this->marker_cache[this->marker_cache_next] = {this->compile_info.files.getFile(file_id), file_id};
+    this->marker_cache_next = (this->marker_cache_next + 1) % MARKER_CACHE_SIZE;
+    return file_id;
+}
+
+// Handles a line marker as written by the preprocessor: # <line> "<filename>" <flags>,
+// where each flag is a digit from 1 to 4, see SourceMap::RegionFlags.
+template <typename Policy>
+void BasicLexer<Policy>::lexPreprocessor() {
+    // Line markers only matter for locations and the errors in them
+    if constexpr(!Policy::LOCATIONS && !Policy::DIAGNOSTICS) {
+        this->consumeLine();
+        return;
+    }
+
+    auto pos = this->location();
     int lookahead = this->read();
     while(this->isWhitespace(lookahead)) {
-        pos = this->position;
+        pos = this->location();
         lookahead = this->read();
     }
 
     if(lookahead < '0' || lookahead > '9') {
         this->unread();
-        this->compile_info.diagnostics.error(pos, "invalid line marking, expecting line number");
+        this->error(pos, "invalid line marking, expecting line number");
         this->consumeLine();
         return;
     }
@@ -667,122 +985,167 @@ void Lexer::lexPreprocessor() {
         lookahead = this->read();
     }
 
-    pos = this->position;
+    pos = this->location(this->input_offset - 1);
     while(this->isWhitespace(lookahead)) {
-        pos = this->position;
+        pos = this->location();
         lookahead = this->read();
     }
 
     if(lookahead != '\"') {
         this->unread();
-        this->compile_info.diagnostics.error(pos, "invalid line marking, expecting \" after line number to start filename");
+        this->error(pos, "invalid line marking, expecting \" after line number to start filename");
         this->consumeLine();
         return;
     }
+
+    // The filename is used in place, only escaped names need a copy.
+    size_t name_start = this->input_offset;
+    bool escaped = false;
     lookahead = this->read();
-    std::stringstream ss;
     while(lookahead != '\n' && lookahead != '\"' && lookahead != -1) {
-        ss << (char)lookahead;
+        if(lookahead == '\\') {
+            escaped = true;
+            lookahead = this->read();
+            if(lookahead == '\n' || lookahead == -1)
+                break;
+        }
         lookahead = this->read();
     }
 
     if(lookahead != '\"') {
         this->unread();
-        this->compile_info.diagnostics.error(pos, "unterminated string for filename in line directive");
+        this->error(pos, "unterminated string for filename in line directive");
         this->consumeLine();
         return;
     }
+    std::string_view name = this->input.substr(name_start, this->input_offset - 1 - name_start);
 
+    uint8_t flags = 0;
+    lookahead = this->read();
+    while(true) {
+        while(this->isWhitespace(lookahead))
+            lookahead = this->read();
+        if(lookahead < '1' || lookahead > '4' || this->isDigit(this->input.data()[this->input_offset]))
+            break;
+        flags |= 1 << (lookahead - '1');
+        lookahead = this->read();
+    }
+    this->unread();
+
+    if(lookahead != '\n' && lookahead != -1)
+        this->error(this->location(), "invalid flag in line marker");
     this->consumeLine();
 
-    size_t file_id = this->compile_info.files.addFile(ss.str());
+    if constexpr(Policy::LOCATIONS) {
+        size_t file_id = escaped ? this->compile_info.files.addFile(unescapeFilename(name)) : this->lookupMarkerFile(name);
+
+        // The marker gives the line number of the line after it, which starts after the newline we are at.
+        this->compile_info.sources.addLineMarker(this->buffer_id, this->chunk_offset + this->input_offset, line_nr - 1, file_id, flags);
+    }
+}
 
-    this->position.line = line_nr - 1;
-    this->position.file_id = file_id;
+template <typename Policy>
+Token BasicLexer<Policy>::endDirective() {
+    this->in_directive = false;
+    Token result = this->makeToken(TokenType::END_OF_DIRECTIVE);
+    this->made_token_on_line = false;
+    return result;
 }
 
-Token Lexer::lex() {
+template <typename Policy>
+Token BasicLexer<Policy>::lex() {
     while(true) {
         this->startToken();
+        // A multiline comment may continue into the next chunk of a stream.
+        size_t start = this->chunk_offset + this->token_start_offset;
         int lookahead = this->read();
         switch(lookahead) {
             case -1:
+                this->unread();
+                if constexpr(Policy::DIRECTIVES) {
+                    if(this->in_directive)
+                        return this->endDirective();
+                }
+                if(this->nextChunk())
+                    break;
                 return this->makeToken(TokenType::EOI);
             case ' ':
             case '\t':
             case '\r':
-                break;
             case '\n':
-                ++this->position.line;
-                this->position.column = 1;
-                this->made_token_on_line = false;
+                this->unread();
+                if constexpr(Policy::DIRECTIVES) {
+                    // A directive ends at the end of its line, so whitespace stops there.
+                    if(this->in_directive) {
+                        while(this->isWhitespace((unsigned char)this->input.data()[this->input_offset]))
+                            ++this->input_offset;
+                        if(this->input.data()[this->input_offset] != '\n')
+                            break;
+                        this->startToken();
+                        ++this->input_offset;
+                        return this->endDirective();
+                    }
+                }
+                this->consumeWhitespace();
+                this->addTrivia(TriviaKind::WHITESPACE, start);
                 break;
-            case '+':
-                return this->lexPlus();
-            case '-':
-                return this->lexMinus();
-            case '*':
-                return this->lexStar();
-            case '%':
-                return this->lexMod();
-            case '<':
-                return this->lexLt();
-            case '>':
-                return this->lexGt();
-            case '&':
-                return this->lexAnd();
-            case '|':
-                return this->lexOr();
-            case '^':
-                return this->lexXor();
-            case '=':
-                return this->lexAssign();
-            case '!':
-                return this->lexNot();
-            case '.':
-                return this->lexDot();
-            case ':':
-                return this->lexColon();
-            case '~':
-                return this->makeToken(TokenType::BITNOT);
-            case '{':
-                return this->makeToken(TokenType::OPEN_CB);
-            case '}':
-                return this->makeToken(TokenType::CLOSE_CB);
-            case '(':
-                return this->makeToken(TokenType::OPEN_PAR);
-            case ')':
-                return this->makeToken(TokenType::CLOSE_PAR);
-            case '[':
-                return this->makeToken(TokenType::OPEN_SB);
-            case ']':
-                return this->makeToken(TokenType::CLOSE_SB);
-            case ';':
-                return this->makeToken(TokenType::SEMICOLON);
-            case ',':
-                return this->makeToken(TokenType::COMMA);
-            case '?':
-                return this->makeToken(TokenType::QUESTION);
             case '#':
-                if(!this->made_token_on_line)
+                if constexpr(Policy::DIRECTIVES) {
+                    if(this->made_token_on_line || this->in_directive) {
+                        if(this->input.data()[this->input_offset] == '#')
+                            ++this->input_offset;
+                        return this->makeToken(this->input_offset - this->token_start_offset == 2 ? TokenType::HASH_HASH : TokenType::HASH);
+                    }
+
+                    // Line markers are still handled here, other directives go to the preprocessor.
+                    size_t i = this->input_offset;
+                    while(this->isWhitespace((unsigned char)this->input.data()[i]))
+                        ++i;
+                    if(!this->isDigit((unsigned char)this->input.data()[i])) {
+                        this->in_directive = true;
+                        return this->makeToken(TokenType::DIRECTIVE);
+                    }
+                }
+
+                if(!this->made_token_on_line) {
                     this->lexPreprocessor();
+                    this->addTrivia(TriviaKind::DIRECTIVE, start);
+                }
                 else
                     return this->makeToken(TokenType::INVALID);
                 break;
+            case '\\':
+                if constexpr(Policy::DIRECTIVES) {
+                    // Line splice
+                    size_t i = this->input_offset + (this->input.data()[this->input_offset] == '\r');
+                    if(this->input.data()[i] == '\n') {
+                        this->input_offset = i + 1;
+                        break;
+                    }
+                }
+                return this->makeToken(TokenType::INVALID);
             case '/': {
                 lookahead = this->read();
-                if(lookahead == '=')
-                    return this->makeToken(TokenType::DIV_ASSIGN);
-                else if(lookahead == '/')
+                if(lookahead == '/') {
                     this->consumeLine();
-                else if(lookahead == '*')
-                   this->consumeMultiline();
+                    this->addTrivia(TriviaKind::LINE_COMMENT, start);
+                }
+                else if(lookahead == '*') {
+                    this->consumeMultiline();
+                    this->addTrivia(TriviaKind::BLOCK_COMMENT, start);
+                    if(this->next_split < this->splits.size())
+                        this->markCommentedSplits(start);
+                }
                 else {
                     this->unread();
-                    return this->makeToken(TokenType::DIV);
+                    return this->lexPunctuator('/');
                 }
                 break;
             }
+            case '.':
+                if(CHAR_CLASSES[(unsigned char)this->input.data()[this->input_offset]] & CHAR_DIGIT)
+                    return this->lexFloat(10);
+                return this->lexPunctuator('.');
             case '"':
                 return this->lexStringLiteral();
             case '\'':
@@ -799,14 +1162,74 @@ Token Lexer::lex() {
                 }
             }
             default: {
-                if(this->isDigit(lookahead)) {
+                uint8_t char_class = CHAR_CLASSES[lookahead];
+                if(char_class & CHAR_PUNCTUATOR)
+                    return this->lexPunctuator(lookahead);
+                if(char_class & CHAR_DIGIT) {
                     this->unread();
                     return this->lexNumber();
                 }
-                if(this->isIdChar(lookahead) && !this->isDigit(lookahead))
+                if(char_class & CHAR_ID)
                     return this->lexId();
+                if(lookahead >= 0x80) {
+                    this->unread();
+                    if(this->consumeUnicodeIdChar(true))
+                        return this->lexId();
+                    // Make the whole code point a single invalid token.
+                    uint32_t cp;
+                    this->input_offset += decodeUtf8(this->input.data() + this->input_offset, cp);
+                }
                 return this->makeToken(TokenType::INVALID);
             }
         }
     }
 }
+
+template <typename Policy>
+void BasicLexer<Policy>::setDiagnostics(Diagnostics& diagnostics) {
+    this->diagnostics = &diagnostics;
+}
+
+template <typename Policy>
+void BasicLexer<Policy>::watchSplits(std::span<const size_t> splits) {
+    this->splits = splits;
+    this->next_split = 0;
+    this->commented_splits.clear();
+}
+
+template <typename Policy>
+bool BasicLexer<Policy>::splitInComment(size_t offset) const {
+    return std::binary_search(this->commented_splits.begin(), this->commented_splits.end(), offset);
+}
+
+template <typename Policy>
+TokenBuffer BasicLexer<Policy>::lexAll() requires Policy::LOCATIONS && Policy::RAW {
+    // A token buffer refers to the source, which a stream does not keep.
+    assert(!this->stream);
+    TokenBuffer tokens(this->input, this->location_base);
+    // Rough estimate of the token density of typical source, to avoid most reallocations.
+    tokens.reserve(this->input.size() / 4);
+    if constexpr(Policy::TRIVIA)
+        this->trivia.reserve(this->input.size() / 4);
+
+    while(true) {
+        Token token = this->lex();
+        tokens.push(token);
+        if(token.type == TokenType::EOI)
+            break;
+    }
+
+    if constexpr(Policy::TRIVIA)
+        tokens.setTrivia(std::move(this->trivia));
+    return tokens;
+}
+
+template <typename Policy>
+std::span<const Trivia> BasicLexer<Policy>::lexedTrivia() const requires Policy::TRIVIA {
+    return this->trivia;
+}
+
+template class BasicLexer<DefaultLexerPolicy>;
+template class BasicLexer<KindsOnlyLexerPolicy>;
+template class BasicLexer<LosslessLexerPolicy>;
+template class BasicLexer<PreprocessorLexerPolicy>;
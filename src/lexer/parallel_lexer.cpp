@@ -0,0 +1,175 @@
+#include "lexer/parallel_lexer.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/scan.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Chunks smaller than this are not worth handing to another thread.
+    constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+    // More chunks than threads evens out differences in how fast chunks lex.
+    constexpr size_t CHUNKS_PER_THREAD = 4;
+    // How far past the ideal split point to look for a directive before settling for any line.
+    constexpr size_t DIRECTIVE_SEARCH_WINDOW = 64 << 10;
+
+    struct Chunk {
+        size_t begin;
+        size_t end;
+
+        // Each chunk has its own tables, which are merged into the shared ones afterwards.
+        // They only hold this one buffer, so locations in them are offsets in the buffer.
+        CompileInfo compile_info;
+        std::optional<Lexer> lexer;
+        std::optional<TokenBuffer> tokens;
+        // The first token at or after the end, which belongs to the next chunk.
+        Token next;
+        size_t invalid_utf8;
+
+        Chunk(size_t begin, size_t end) : begin(begin), end(end), invalid_utf8(end) {}
+    };
+
+    // Returns the start of the first line at or after `target`, preferring lines starting with '#'.
+    // Preprocessed input has no comments left, so line markers are almost always safe to split at.
+    size_t findSplit(std::string_view input, size_t target) {
+        const char* data = input.data();
+        size_t window_end = std::min(input.size(), target + DIRECTIVE_SEARCH_WINDOW);
+        std::optional<size_t> first_line;
+
+        for(size_t i = target; i < window_end;) {
+            auto newline = static_cast<const char*>(std::memchr(data + i, '\n', window_end - i));
+            if(!newline)
+                break;
+            i = newline - data + 1;
+            if(data[i] == '#')
+                return i;
+            if(!first_line)
+                first_line = i;
+        }
+
+        if(first_line)
+            return first_line.value();
+        auto newline = static_cast<const char*>(std::memchr(data + window_end, '\n', input.size() - window_end));
+        return newline ? newline - data + 1 : input.size();
+    }
+
+    size_t tokenOffset(const Token& token, std::string_view input) {
+        return token.raw.data() - input.data();
+    }
+
+    // Adds tokens to the chunk up to the first one at or after `end`, which is left in chunk.next.
+    void lexUntil(Chunk& chunk, size_t end, std::string_view input) {
+        while(chunk.next.type != TokenType::EOI && tokenOffset(chunk.next, input) < end) {
+            chunk.tokens->push(chunk.next);
+            chunk.next = chunk.lexer->lex();
+        }
+    }
+
+    // Moves the tokens, strings, line markers and diagnostics of a chunk before `end` into the shared tables.
+    void merge(Chunk& chunk, size_t end, TokenBuffer& tokens, CompileInfo& compile_info, SourceMap::BufferId buffer_id) {
+        const CompileInfo& local = chunk.compile_info;
+
+        StringId first_string = compile_info.strings.addAll(local.strings);
+        tokens.append(*chunk.tokens, first_string);
+
+        for(const auto& region : local.sources.regions(0).subspan(1)) {
+            if(region.offset >= end)
+                break;
+            size_t file_id = compile_info.files.addFile(local.files.getFile(region.file_id));
+            compile_info.sources.addLineMarker(buffer_id, region.offset, region.line, file_id, region.flags);
+        }
+
+        for(const auto& diagnostic : local.diagnostics.messages()) {
+            if(diagnostic.loc.offset < end)
+                compile_info.diagnostics.add({diagnostic.type, compile_info.sources.location(buffer_id, diagnostic.loc.offset), diagnostic.msg});
+        }
+    }
+}
+
+TokenBuffer lexParallel(const SourceBuffer& input, CompileInfo& compile_info, size_t num_threads) {
+    std::string_view source = input.contents();
+    if(num_threads == 0)
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    size_t num_chunks = std::min(num_threads * CHUNKS_PER_THREAD, source.size() / MIN_CHUNK_SIZE);
+    if(num_threads == 1 || num_chunks <= 1) {
+        Lexer lexer(input, compile_info);
+        return lexer.lexAll();
+    }
+
+    size_t file_id = compile_info.files.addFile("<unknown>");
+    SourceMap::BufferId buffer_id = compile_info.sources.addBuffer(source, file_id);
+    uint32_t location_base = compile_info.sources.base(buffer_id);
+
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    std::vector<size_t> splits;
+    for(size_t i = 1, begin = 0; begin < source.size(); ++i) {
+        size_t end = i == num_chunks ? source.size() : findSplit(source, source.size() * i / num_chunks);
+        // A long line can push a split past the next target
+        if(end <= begin)
+            continue;
+        chunks.push_back(std::make_unique<Chunk>(begin, end));
+        if(end < source.size())
+            splits.push_back(end);
+        begin = end;
+    }
+
+    std::atomic<size_t> next_chunk = 0;
+    auto work = [&] {
+        for(size_t i; (i = next_chunk++) < chunks.size();) {
+            Chunk& chunk = *chunks[i];
+            chunk.invalid_utf8 = chunk.begin + validateUtf8(source.data() + chunk.begin, chunk.end - chunk.begin);
+            chunk.lexer.emplace(input, chunk.compile_info, chunk.begin);
+            chunk.lexer->watchSplits(std::span(splits).subspan(i));
+            chunk.tokens.emplace(source, location_base);
+            chunk.tokens->reserve((chunk.end - chunk.begin) / 4);
+            chunk.next = chunk.lexer->lex();
+            lexUntil(chunk, chunk.end, source);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(size_t i = 1; i < std::min(num_threads, chunks.size()); ++i)
+        threads.emplace_back(work);
+    work();
+    for(auto& thread : threads)
+        thread.join();
+
+    // Only the first invalid sequence is reported, before anything else, as the serial lexer does.
+    for(const auto& chunk : chunks) {
+        if(chunk->invalid_utf8 != chunk->end) {
+            compile_info.diagnostics.error(compile_info.sources.location(buffer_id, chunk->invalid_utf8), "invalid UTF-8 sequence");
+            break;
+        }
+    }
+
+    TokenBuffer tokens(source, location_base);
+    tokens.reserve(source.size() / 4);
+
+    // A chunk was lexed from the right state unless the lexer before it passed its start inside a
+    // multiline comment. Then the chunk lexed the contents of the comment, which may look like line
+    // markers or tokens lining up with the real ones, so it is dropped along with its line markers
+    // and diagnostics, and that lexer continues through it instead.
+    Chunk* current = chunks[0].get();
+    for(size_t i = 1; i < chunks.size(); ++i) {
+        Chunk& chunk = *chunks[i];
+        if(!current->lexer->splitInComment(chunk.begin)) {
+            merge(*current, chunk.begin, tokens, compile_info, buffer_id);
+            current = &chunk;
+        }
+        else
+            lexUntil(*current, chunk.end, source);
+    }
+
+    // The last chunk ends with the end of input token
+    current->tokens->push(current->next);
+    merge(*current, std::numeric_limits<size_t>::max(), tokens, compile_info, buffer_id);
+    return tokens;
+}
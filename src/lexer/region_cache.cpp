@@ -0,0 +1,191 @@
+#include "lexer/region_cache.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/scan.hpp"
+#include "frontend/hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace {
+    struct Region {
+        size_t begin;
+        size_t end;
+        // As written in the marker, with escapes
+        std::string_view file;
+    };
+
+    struct Marker {
+        std::string_view file;
+        uint8_t flags;
+    };
+
+    bool isBlank(char c) {
+        return c == ' ' || c == '\t';
+    }
+
+    bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    // Parses a line marker, without the newline. Anything else is left for the lexer to handle.
+    std::optional<Marker> parseMarker(std::string_view line) {
+        size_t i = 1;
+        while(i < line.size() && isBlank(line[i]))
+            ++i;
+        if(i == line.size() || !isDigit(line[i]))
+            return std::nullopt;
+        while(i < line.size() && isDigit(line[i]))
+            ++i;
+        while(i < line.size() && isBlank(line[i]))
+            ++i;
+        if(i == line.size() || line[i] != '"')
+            return std::nullopt;
+
+        size_t name_start = ++i;
+        while(i < line.size() && line[i] != '"')
+            i += line[i] == '\\' ? 2 : 1;
+        if(i >= line.size())
+            return std::nullopt;
+
+        Marker marker = {line.substr(name_start, i - name_start), 0};
+        for(++i; i < line.size(); ++i) {
+            if(line[i] >= '1' && line[i] <= '4')
+                marker.flags |= 1 << (line[i] - '1');
+            else if(!isBlank(line[i]))
+                return std::nullopt;
+        }
+        return marker;
+    }
+
+    // Finds the regions of headers entered from the main file. Only lines starting with '#'
+    // are looked at, which are rare in preprocessed input apart from the markers themselves.
+    std::vector<Region> findRegions(std::string_view source, size_t min_size) {
+        std::vector<Region> regions;
+        const char* data = source.data();
+        size_t depth = 0;
+        Region current = {0, 0, {}};
+
+        for(size_t i = 0; i < source.size();) {
+            auto hash = static_cast<const char*>(std::memchr(data + i, '#', source.size() - i));
+            if(!hash)
+                break;
+            size_t line_start = hash - data;
+            size_t line_end = line_start + findLineEnd(hash);
+            i = line_end + 1;
+            if(line_start > 0 && data[line_start - 1] != '\n')
+                continue;
+
+            auto marker = parseMarker(source.substr(line_start, line_end - line_start));
+            if(!marker)
+                continue;
+            if(marker->flags & SourceMap::ENTER_FILE) {
+                if(depth++ == 0)
+                    current = {std::min(line_end + 1, source.size()), 0, marker->file};
+            }
+            else if(marker->flags & SourceMap::RETURN_TO_FILE && depth > 0 && --depth == 0) {
+                current.end = line_start;
+                if(current.end >= current.begin + min_size)
+                    regions.push_back(current);
+            }
+        }
+        return regions;
+    }
+
+    // Copies the tokens, strings, line markers and diagnostics before `end` from tables that hold
+    // a single buffer into those of the translation unit, moving them `offset` bytes further.
+    void merge(const TokenBuffer& local_tokens, const CompileInfo& local, uint32_t offset, size_t end,
+        TokenBuffer& tokens, CompileInfo& compile_info, SourceMap::BufferId buffer_id) {
+        StringId first_string = compile_info.strings.addAll(local.strings);
+        tokens.append(local_tokens, first_string, offset);
+
+        for(const auto& region : local.sources.regions(0).subspan(1)) {
+            if(region.offset >= end)
+                break;
+            size_t file_id = compile_info.files.addFile(local.files.getFile(region.file_id));
+            compile_info.sources.addLineMarker(buffer_id, offset + region.offset, region.line, file_id, region.flags);
+        }
+
+        for(const auto& diagnostic : local.diagnostics.messages()) {
+            if(diagnostic.loc.offset < end)
+                compile_info.diagnostics.add({diagnostic.type, compile_info.sources.location(buffer_id, offset + diagnostic.loc.offset), diagnostic.msg});
+        }
+    }
+
+    // Lexes the part of a buffer between regions. The lexer has to look at the first token
+    // after it, which is left out. Only the last part ends with the end of input token.
+    void lexGap(const SourceBuffer& input, size_t begin, size_t end, bool last,
+        TokenBuffer& tokens, CompileInfo& compile_info, SourceMap::BufferId buffer_id) {
+        std::string_view source = input.contents();
+        CompileInfo local;
+        Lexer lexer(input, local, begin);
+        TokenBuffer local_tokens(source, compile_info.sources.base(buffer_id));
+
+        for(Token token = lexer.lex();; token = lexer.lex()) {
+            if(token.type == TokenType::EOI) {
+                if(last)
+                    local_tokens.push(token);
+                break;
+            }
+            if(size_t(token.raw.data() - source.data()) >= end)
+                break;
+            local_tokens.push(token);
+        }
+
+        merge(local_tokens, local, 0, end, tokens, compile_info, buffer_id);
+    }
+}
+
+RegionCache::Entry::Entry(std::string_view file, std::string_view text) :
+    file(file), text(text), tokens(this->text.contents(), 0) {
+    Lexer lexer(this->text, this->compile_info, size_t(0));
+    for(Token token = lexer.lex(); token.type != TokenType::EOI; token = lexer.lex())
+        this->tokens.push(token);
+}
+
+RegionCache::RegionCache() : statistics{0, 0, 0, 0} {}
+
+// Returns the entry of a region, lexing it if it was not seen before.
+const RegionCache::Entry& RegionCache::find(std::string_view file, std::string_view text) {
+    uint64_t key = hashBytes(text, hashBytes(file, 0));
+    auto [first, last] = this->entries.equal_range(key);
+    for(auto it = first; it != last; ++it) {
+        const Entry& entry = *it->second;
+        if(entry.file == file && entry.text.contents() == text) {
+            ++this->statistics.hits;
+            this->statistics.saved_bytes += text.size();
+            return entry;
+        }
+    }
+
+    ++this->statistics.misses;
+    auto it = this->entries.emplace(key, std::make_unique<Entry>(file, text));
+    return *it->second;
+}
+
+TokenBuffer RegionCache::lex(const SourceBuffer& input, CompileInfo& compile_info) {
+    std::string_view source = input.contents();
+    size_t file_id = compile_info.files.addFile("<unknown>");
+    SourceMap::BufferId buffer_id = compile_info.sources.addBuffer(source, file_id);
+    this->statistics.total_bytes += source.size();
+
+    // Regions are lexed without validating them, as they were validated with the rest here.
+    size_t invalid = validateUtf8(source.data(), source.size());
+    if(invalid != source.size())
+        compile_info.diagnostics.error(compile_info.sources.location(buffer_id, invalid), "invalid UTF-8 sequence");
+
+    TokenBuffer tokens(source, compile_info.sources.base(buffer_id));
+    tokens.reserve(source.size() / 4);
+
+    size_t begin = 0;
+    for(const Region& region : findRegions(source, MIN_REGION_SIZE)) {
+        lexGap(input, begin, region.begin, false, tokens, compile_info, buffer_id);
+        const Entry& entry = this->find(region.file, source.substr(region.begin, region.end - region.begin));
+        merge(entry.tokens, entry.compile_info, region.begin, std::numeric_limits<size_t>::max(), tokens, compile_info, buffer_id);
+        begin = region.end;
+    }
+    lexGap(input, begin, source.size(), true, tokens, compile_info, buffer_id);
+    return tokens;
+}
@@ -0,0 +1,443 @@
+#include "lexer/scan.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define QUETZALCOATL_SCAN_X86
+#endif
+
+namespace {
+    inline bool isWhitespace(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    // Update the result from the masks of a block of input. `stop` has a bit set for every
+    // byte that ends the scan, and `newline` for every newline. Returns true if the scan ended in this block.
+    inline bool scanBlock(SkipResult& result, size_t base, uint32_t stop, uint32_t newline) {
+        if(stop != 0) {
+            size_t index = __builtin_ctz(stop);
+            newline &= (uint32_t(1) << index) - 1;
+            result.length = base + index;
+        }
+
+        result.newlines += __builtin_popcount(newline);
+        return stop != 0;
+    }
+
+    SkipResult skipWhitespaceScalar(const char* p) {
+        SkipResult result = {0, 0};
+        while(isWhitespace(p[result.length])) {
+            if(p[result.length++] == '\n')
+                ++result.newlines;
+        }
+        return result;
+    }
+
+    size_t findLineEndScalar(const char* p) {
+        size_t i = 0;
+        while(p[i] != '\n' && p[i] != '\0')
+            ++i;
+        return i;
+    }
+
+    SkipResult findStarScalar(const char* p) {
+        SkipResult result = {0, 0};
+        while(p[result.length] != '*' && p[result.length] != '\0') {
+            if(p[result.length++] == '\n')
+                ++result.newlines;
+        }
+        return result;
+    }
+
+    size_t findStringEndScalar(const char* p) {
+        size_t i = 0;
+        while(p[i] != '"' && p[i] != '\\' && p[i] != '\n' && p[i] != '\0')
+            ++i;
+        return i;
+    }
+
+    // Validates one sequence at a time, skipping over ASCII eight bytes at a time.
+    size_t validateUtf8Scalar(const char* data, size_t size) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+        size_t i = 0;
+        while(i < size) {
+            uint64_t word;
+            std::memcpy(&word, p + i, sizeof word);
+            if((word & 0x8080808080808080) == 0) {
+                i += 8;
+                continue;
+            }
+
+            uint8_t c = p[i];
+            if(c < 0x80) {
+                ++i;
+                continue;
+            }
+
+            size_t length;
+            uint32_t cp;
+            uint32_t min;
+            if((c & 0xE0) == 0xC0) {
+                length = 2;
+                cp = c & 0x1F;
+                min = 0x80;
+            }
+            else if((c & 0xF0) == 0xE0) {
+                length = 3;
+                cp = c & 0x0F;
+                min = 0x800;
+            }
+            else if((c & 0xF8) == 0xF0) {
+                length = 4;
+                cp = c & 0x07;
+                min = 0x10000;
+            }
+            else
+                return i;
+
+            if(length > size - i)
+                return i;
+            for(size_t j = 1; j < length; ++j) {
+                if((p[i + j] & 0xC0) != 0x80)
+                    return i;
+                cp = (cp << 6) | (p[i + j] & 0x3F);
+            }
+            if(cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+                return i;
+            i += length;
+        }
+        return size;
+    }
+
+    // The SIMD validators only tell whether a block contains an error. The sequences that can
+    // end in the block start at most three bytes before it, so the scalar validator finds the
+    // exact offset when it is restarted at the first sequence boundary from there.
+    size_t locateUtf8Error(const char* data, size_t size, size_t block) {
+        size_t start = block < 3 ? 0 : block - 3;
+        while(start < block && (data[start] & 0xC0) == 0x80)
+            ++start;
+        return start + validateUtf8Scalar(data + start, size - start);
+    }
+
+#ifdef QUETZALCOATL_SCAN_X86
+    __attribute__((target("sse2")))
+    SkipResult skipWhitespaceSse2(const char* p) {
+        SkipResult result = {0, 0};
+        for(size_t i = 0;; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            __m128i nl = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+            __m128i ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), nl));
+            uint32_t stop = ~uint32_t(_mm_movemask_epi8(ws)) & 0xFFFF;
+            if(scanBlock(result, i, stop, _mm_movemask_epi8(nl)))
+                return result;
+        }
+    }
+
+    __attribute__((target("sse2")))
+    size_t findLineEndSse2(const char* p) {
+        for(size_t i = 0;; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+            uint32_t mask = _mm_movemask_epi8(stop);
+            if(mask != 0)
+                return i + __builtin_ctz(mask);
+        }
+    }
+
+    __attribute__((target("sse2")))
+    SkipResult findStarSse2(const char* p) {
+        SkipResult result = {0, 0};
+        for(size_t i = 0;; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('*')), _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+            uint32_t nl = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+            if(scanBlock(result, i, _mm_movemask_epi8(stop), nl))
+                return result;
+        }
+    }
+
+    __attribute__((target("sse2")))
+    size_t findStringEndSse2(const char* p) {
+        for(size_t i = 0;; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            __m128i stop = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_setzero_si128())));
+            uint32_t mask = _mm_movemask_epi8(stop);
+            if(mask != 0)
+                return i + __builtin_ctz(mask);
+        }
+    }
+
+    __attribute__((target("avx2")))
+    SkipResult skipWhitespaceAvx2(const char* p) {
+        SkipResult result = {0, 0};
+        for(size_t i = 0;; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            __m256i nl = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+            __m256i ws = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), nl));
+            uint32_t stop = ~uint32_t(_mm256_movemask_epi8(ws));
+            if(scanBlock(result, i, stop, _mm256_movemask_epi8(nl)))
+                return result;
+        }
+    }
+
+    __attribute__((target("avx2")))
+    size_t findLineEndAvx2(const char* p) {
+        for(size_t i = 0;; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+            uint32_t mask = _mm256_movemask_epi8(stop);
+            if(mask != 0)
+                return i + __builtin_ctz(mask);
+        }
+    }
+
+    __attribute__((target("avx2")))
+    SkipResult findStarAvx2(const char* p) {
+        SkipResult result = {0, 0};
+        for(size_t i = 0;; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')), _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+            uint32_t nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+            if(scanBlock(result, i, _mm256_movemask_epi8(stop), nl))
+                return result;
+        }
+    }
+
+    __attribute__((target("avx2")))
+    size_t findStringEndAvx2(const char* p) {
+        for(size_t i = 0;; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            __m256i stop = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_setzero_si256())));
+            uint32_t mask = _mm256_movemask_epi8(stop);
+            if(mask != 0)
+                return i + __builtin_ctz(mask);
+        }
+    }
+
+    // UTF-8 validation with the lookup algorithm of Keiser and Lemire ("Validating UTF-8 In
+    // Less Than One Instruction Per Byte", 2021), as used by simdjson. Each pair of adjacent
+    // bytes is classified by three 16-entry table lookups on the high nibble of the first byte,
+    // its low nibble and the high nibble of the second byte. A bit survives the AND of the three
+    // only if the pair is an error, except for two continuation bytes in a row, which is only
+    // allowed where the byte two or three places back is a three or four byte lead.
+    namespace utf8_tables {
+        constexpr uint8_t TOO_SHORT = 1 << 0;
+        constexpr uint8_t TOO_LONG = 1 << 1;
+        constexpr uint8_t OVERLONG_3 = 1 << 2;
+        constexpr uint8_t TOO_LARGE = 1 << 3;
+        constexpr uint8_t SURROGATE = 1 << 4;
+        constexpr uint8_t OVERLONG_2 = 1 << 5;
+        constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+        constexpr uint8_t OVERLONG_4 = 1 << 6;
+        constexpr uint8_t TWO_CONTS = 1 << 7;
+        constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+        alignas(16) constexpr uint8_t BYTE_1_HIGH[16] = {
+            // 0xxx: ASCII
+            TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+            // 10xx: continuation
+            TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+            // 1100, 1101: two byte lead
+            TOO_SHORT | OVERLONG_2,
+            TOO_SHORT,
+            // 1110: three byte lead
+            TOO_SHORT | OVERLONG_3 | SURROGATE,
+            // 1111: four byte lead
+            TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+        };
+
+        alignas(16) constexpr uint8_t BYTE_1_LOW[16] = {
+            CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+            CARRY | OVERLONG_2,
+            CARRY,
+            CARRY,
+            CARRY | TOO_LARGE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+        };
+
+        alignas(16) constexpr uint8_t BYTE_2_HIGH[16] = {
+            // 0xxx: ASCII
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+            // 1000, 1001, 101x: continuation
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            // 11xx: lead
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        };
+
+        // A block ending in a lead byte whose sequence does not fit is incomplete, and must be followed by continuations.
+        alignas(16) constexpr uint8_t MAX_BLOCK_END[16] = {
+            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+            0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+        };
+    }
+
+    __attribute__((target("ssse3")))
+    __m128i checkUtf8BlockSsse3(__m128i input, __m128i prev_input) {
+        using namespace utf8_tables;
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        __m128i prev1 = _mm_alignr_epi8(input, prev_input, 16 - 1);
+        __m128i prev2 = _mm_alignr_epi8(input, prev_input, 16 - 2);
+        __m128i prev3 = _mm_alignr_epi8(input, prev_input, 16 - 3);
+
+        __m128i byte_1_high = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(BYTE_1_HIGH)),
+            _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+        __m128i byte_1_low = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(BYTE_1_LOW)),
+            _mm_and_si128(prev1, nibble));
+        __m128i byte_2_high = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(BYTE_2_HIGH)),
+            _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+        __m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+        __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(char(0xE0 - 0x80)));
+        __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(char(0xF0 - 0x80)));
+        __m128i must_be_continuation = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(char(0x80)));
+        return _mm_xor_si128(must_be_continuation, special);
+    }
+
+    __attribute__((target("ssse3")))
+    size_t validateUtf8Ssse3(const char* data, size_t size) {
+        __m128i prev_input = _mm_setzero_si128();
+        __m128i prev_incomplete = _mm_setzero_si128();
+        const __m128i max_block_end = _mm_load_si128(reinterpret_cast<const __m128i*>(utf8_tables::MAX_BLOCK_END));
+
+        // The last block may read into the padding, whose zeros are valid ASCII.
+        for(size_t i = 0; i < size; i += 16) {
+            __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i error;
+            if(_mm_movemask_epi8(input) == 0)
+                error = prev_incomplete;
+            else {
+                error = checkUtf8BlockSsse3(input, prev_input);
+                prev_incomplete = _mm_subs_epu8(input, max_block_end);
+            }
+            if(_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xFFFF)
+                return locateUtf8Error(data, size, i);
+            prev_input = input;
+        }
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(prev_incomplete, _mm_setzero_si128())) != 0xFFFF)
+            return locateUtf8Error(data, size, size);
+        return size;
+    }
+
+    __attribute__((target("avx2")))
+    __m256i lookup16Avx2(const uint8_t* table, __m256i index) {
+        __m256i lookup = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table)));
+        return _mm256_shuffle_epi8(lookup, index);
+    }
+
+    __attribute__((target("avx2")))
+    __m256i checkUtf8BlockAvx2(__m256i input, __m256i prev_input) {
+        using namespace utf8_tables;
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        // The previous bytes cross the 128-bit lanes, so they are aligned against a vector of
+        // the high lane of the previous block and the low lane of this one.
+        __m256i shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+        __m256i prev1 = _mm256_alignr_epi8(input, shifted, 16 - 1);
+        __m256i prev2 = _mm256_alignr_epi8(input, shifted, 16 - 2);
+        __m256i prev3 = _mm256_alignr_epi8(input, shifted, 16 - 3);
+
+        __m256i byte_1_high = lookup16Avx2(BYTE_1_HIGH, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+        __m256i byte_1_low = lookup16Avx2(BYTE_1_LOW, _mm256_and_si256(prev1, nibble));
+        __m256i byte_2_high = lookup16Avx2(BYTE_2_HIGH, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+        __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+        __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(char(0xE0 - 0x80)));
+        __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(char(0xF0 - 0x80)));
+        __m256i must_be_continuation = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(char(0x80)));
+        return _mm256_xor_si256(must_be_continuation, special);
+    }
+
+    __attribute__((target("avx2")))
+    size_t validateUtf8Avx2(const char* data, size_t size) {
+        __m256i prev_input = _mm256_setzero_si256();
+        __m256i prev_incomplete = _mm256_setzero_si256();
+        const __m256i max_block_end = _mm256_set_m128i(
+            _mm_load_si128(reinterpret_cast<const __m128i*>(utf8_tables::MAX_BLOCK_END)),
+            _mm_set1_epi8(char(0xFF)));
+
+        // The last block may read into the padding, whose zeros are valid ASCII.
+        for(size_t i = 0; i < size; i += 32) {
+            __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i error;
+            if(_mm256_movemask_epi8(input) == 0)
+                error = prev_incomplete;
+            else {
+                error = checkUtf8BlockAvx2(input, prev_input);
+                prev_incomplete = _mm256_subs_epu8(input, max_block_end);
+            }
+            if(!_mm256_testz_si256(error, error))
+                return locateUtf8Error(data, size, i);
+            prev_input = input;
+        }
+        if(!_mm256_testz_si256(prev_incomplete, prev_incomplete))
+            return locateUtf8Error(data, size, size);
+        return size;
+    }
+#endif
+
+    struct ScanImplementation {
+        SkipResult (*skip_whitespace)(const char*);
+        size_t (*find_line_end)(const char*);
+        SkipResult (*find_star)(const char*);
+        size_t (*find_string_end)(const char*);
+        size_t (*validate_utf8)(const char*, size_t);
+    };
+
+    ScanImplementation selectImplementation() {
+#ifdef QUETZALCOATL_SCAN_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            return {skipWhitespaceAvx2, findLineEndAvx2, findStarAvx2, findStringEndAvx2, validateUtf8Avx2};
+        if(__builtin_cpu_supports("sse2")) {
+            // The table lookups need pshufb, which was only added in SSSE3.
+            auto validate_utf8 = __builtin_cpu_supports("ssse3") ? validateUtf8Ssse3 : validateUtf8Scalar;
+            return {skipWhitespaceSse2, findLineEndSse2, findStarSse2, findStringEndSse2, validate_utf8};
+        }
+#endif
+        return {skipWhitespaceScalar, findLineEndScalar, findStarScalar, findStringEndScalar, validateUtf8Scalar};
+    }
+
+    const ScanImplementation SCAN_IMPLEMENTATION = selectImplementation();
+}
+
+SkipResult skipWhitespace(const char* p) {
+    return SCAN_IMPLEMENTATION.skip_whitespace(p);
+}
+
+size_t findLineEnd(const char* p) {
+    return SCAN_IMPLEMENTATION.find_line_end(p);
+}
+
+SkipResult findStar(const char* p) {
+    return SCAN_IMPLEMENTATION.find_star(p);
+}
+
+size_t findStringEnd(const char* p) {
+    return SCAN_IMPLEMENTATION.find_string_end(p);
+}
+
+size_t validateUtf8(const char* p, size_t size) {
+    return SCAN_IMPLEMENTATION.validate_utf8(p, size);
+}
@@ -226,12 +226,22 @@ const char* tokenTypeToString(TokenType type) {
             return "COMMA";
         case TokenType::SEMICOLON:
             return "SEMICOLON";
+        case TokenType::HASH:
+            return "HASH";
+        case TokenType::HASH_HASH:
+            return "HASH_HASH";
         case TokenType::LITERAL_STRING:
             return "LITERAL_STRING";
         case TokenType::LITERAL_INTEGER:
             return "LITERAL_INTEGER";
+        case TokenType::LITERAL_FLOAT:
+            return "LITERAL_FLOAT";
         case TokenType::LITERAL_CHAR:
             return "LITERAL_CHAR";
+        case TokenType::DIRECTIVE:
+            return "DIRECTIVE";
+        case TokenType::END_OF_DIRECTIVE:
+            return "END_OF_DIRECTIVE";
     }
     return nullptr;
 }
@@ -0,0 +1,138 @@
+#include "lexer/token_buffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <utility>
+
+TokenBuffer::TokenBuffer(std::string_view source, uint32_t location_base) :
+    source(source), location_base(location_base), data() {
+    assert(source.size() <= std::numeric_limits<uint32_t>::max());
+}
+
+TokenBuffer::TokenBuffer(std::string_view source, uint32_t location_base, const Columns& columns) :
+    source(source), location_base(location_base), data(columns) {
+    assert(source.size() <= std::numeric_limits<uint32_t>::max());
+}
+
+void TokenBuffer::updateColumns() const {
+    this->data = {this->kinds, this->offsets, this->lengths, this->payloads, this->integers, this->floats};
+}
+
+void TokenBuffer::reserve(size_t num_tokens) {
+    this->kinds.reserve(num_tokens);
+    this->offsets.reserve(num_tokens);
+    this->lengths.reserve(num_tokens);
+    this->payloads.reserve(num_tokens);
+    this->updateColumns();
+}
+
+void TokenBuffer::push(const Token& token) {
+    uint32_t payload = 0;
+    switch(token.type) {
+        case TokenType::LITERAL_INTEGER:
+            payload = this->integers.size();
+            this->integers.push_back({token.integer.type, token.integer.value});
+            break;
+        case TokenType::LITERAL_FLOAT:
+            payload = this->floats.size();
+            this->floats.push_back({token.floating.type, token.floating.value});
+            break;
+        case TokenType::LITERAL_STRING:
+            payload = token.string_literal;
+            break;
+        case TokenType::LITERAL_CHAR:
+            payload = token.char_literal;
+            break;
+        default:
+            break;
+    }
+
+    this->kinds.push_back(token.type);
+    this->offsets.push_back(token.raw.data() - this->source.data());
+    this->lengths.push_back(token.raw.size());
+    this->payloads.push_back(payload);
+}
+
+void TokenBuffer::append(const TokenBuffer& other, StringId first_string, uint32_t offset) {
+    assert(offset > 0 ? other.source.size() <= this->source.size() - offset :
+        other.source.data() == this->source.data() && other.location_base == this->location_base);
+    assert(this->columns().kinds.data() == this->kinds.data());
+    const Columns& columns = other.columns();
+    size_t first_integer = this->integers.size();
+    size_t first_float = this->floats.size();
+
+    this->kinds.insert(this->kinds.end(), columns.kinds.begin(), columns.kinds.end());
+    if(offset == 0)
+        this->offsets.insert(this->offsets.end(), columns.offsets.begin(), columns.offsets.end());
+    else {
+        for(uint32_t token_offset : columns.offsets)
+            this->offsets.push_back(token_offset + offset);
+    }
+    this->lengths.insert(this->lengths.end(), columns.lengths.begin(), columns.lengths.end());
+    this->integers.insert(this->integers.end(), columns.integers.begin(), columns.integers.end());
+    this->floats.insert(this->floats.end(), columns.floats.begin(), columns.floats.end());
+
+    for(size_t i = 0; i < other.size(); ++i) {
+        uint32_t payload = columns.payloads[i];
+        switch(columns.kinds[i]) {
+            case TokenType::LITERAL_INTEGER:
+                payload += first_integer;
+                break;
+            case TokenType::LITERAL_FLOAT:
+                payload += first_float;
+                break;
+            case TokenType::LITERAL_STRING:
+                payload += first_string;
+                break;
+            default:
+                break;
+        }
+        this->payloads.push_back(payload);
+    }
+    this->updateColumns();
+}
+
+Token TokenBuffer::get(size_t index) const {
+    const Columns& columns = this->columns();
+    Token result;
+    result.type = columns.kinds[index];
+    result.raw = this->source.substr(columns.offsets[index], columns.lengths[index]);
+    result.pos = {this->location_base + columns.offsets[index]};
+
+    uint32_t payload = columns.payloads[index];
+    switch(result.type) {
+        case TokenType::LITERAL_INTEGER:
+            result.integer.type = columns.integers[payload].type;
+            result.integer.value = columns.integers[payload].value;
+            break;
+        case TokenType::LITERAL_FLOAT:
+            result.floating.type = columns.floats[payload].type;
+            result.floating.value = columns.floats[payload].value;
+            break;
+        case TokenType::LITERAL_STRING:
+            result.string_literal = payload;
+            break;
+        case TokenType::LITERAL_CHAR:
+            result.char_literal = payload;
+            break;
+        default:
+            break;
+    }
+    return result;
+}
+
+void TokenBuffer::setTrivia(std::vector<Trivia> trivia) {
+    this->trivia_runs = std::move(trivia);
+}
+
+std::span<const Trivia> TokenBuffer::leadingTrivia(size_t index) const {
+    auto before = [](const Trivia& trivia, uint32_t offset) {
+        return trivia.offset < offset;
+    };
+    const Columns& columns = this->columns();
+    uint32_t begin = index > 0 ? columns.offsets[index - 1] + columns.lengths[index - 1] : 0;
+    auto first = std::lower_bound(this->trivia_runs.begin(), this->trivia_runs.end(), begin, before);
+    auto last = std::lower_bound(first, this->trivia_runs.end(), columns.offsets[index], before);
+    return {first, last};
+}
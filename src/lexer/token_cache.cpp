@@ -0,0 +1,315 @@
+#include "lexer/token_cache.hpp"
+#include "lexer/parallel_lexer.hpp"
+#include "frontend/hash.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    constexpr const uint64_t MAGIC = 0x534e4b544c5a5451; // "QTZLTKNS"
+    // Changed whenever the layout or meaning of the contents changes, such as the ids of types.
+    constexpr const uint32_t VERSION = 1;
+    constexpr const uint32_t NUM_TOKEN_KINDS = uint32_t(TokenType::END_OF_DIRECTIVE) + 1;
+
+    enum Section {
+        KINDS,
+        OFFSETS,
+        LENGTHS,
+        PAYLOADS,
+        INTEGERS,
+        FLOATS,
+        STRINGS,
+        STRING_BYTES,
+        FILES,
+        FILE_BYTES,
+        REGIONS,
+        DIAGNOSTICS,
+        DIAGNOSTIC_BYTES,
+        NUM_SECTIONS,
+    };
+
+    struct SectionInfo {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t num_token_kinds;
+        uint64_t source_size;
+        uint64_t source_hash;
+        uint64_t file_size;
+        // Of everything after the header
+        uint64_t checksum;
+        SectionInfo sections[NUM_SECTIONS];
+    };
+
+    // A string of STRING_BYTES, FILE_BYTES or DIAGNOSTIC_BYTES
+    struct CachedString {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    struct CachedRegion {
+        uint32_t offset;
+        uint32_t line;
+        uint32_t file_id;
+        uint32_t flags;
+    };
+
+    struct CachedDiagnostic {
+        uint32_t offset;
+        uint32_t type;
+        CachedString msg;
+    };
+
+    constexpr const size_t ELEMENT_SIZES[NUM_SECTIONS] = {
+        sizeof(TokenType),
+        sizeof(uint32_t),
+        sizeof(uint32_t),
+        sizeof(uint32_t),
+        sizeof(TokenBuffer::IntegerLiteral),
+        sizeof(TokenBuffer::FloatLiteral),
+        sizeof(CachedString),
+        1,
+        sizeof(CachedString),
+        1,
+        sizeof(CachedRegion),
+        sizeof(CachedDiagnostic),
+        1,
+    };
+
+    struct FileDescriptor {
+        int fd;
+
+        ~FileDescriptor() {
+            if(this->fd >= 0)
+                ::close(this->fd);
+        }
+    };
+
+    const Header& header(const char* data) {
+        return *reinterpret_cast<const Header*>(data);
+    }
+
+    template <typename T>
+    std::span<const T> section(const char* data, Section section) {
+        const SectionInfo& info = header(data).sections[section];
+        return {reinterpret_cast<const T*>(data + info.offset), size_t(info.count)};
+    }
+
+    bool isValid(const char* data, size_t size, std::string_view source) {
+        if(size < sizeof(Header))
+            return false;
+        const Header& info = header(data);
+        if(info.magic != MAGIC || info.version != VERSION || info.num_token_kinds != NUM_TOKEN_KINDS || info.file_size != size)
+            return false;
+        if(info.source_size != source.size() || info.source_hash != hashBytes(source))
+            return false;
+        if(info.checksum != hashBytes(std::string_view(data + sizeof(Header), size - sizeof(Header))))
+            return false;
+
+        for(size_t i = 0; i < NUM_SECTIONS; ++i) {
+            const SectionInfo& section = info.sections[i];
+            if(section.offset % 8 != 0 || section.offset < sizeof(Header) || section.offset > size ||
+                section.count > (size - section.offset) / ELEMENT_SIZES[i])
+                return false;
+        }
+
+        uint64_t num_tokens = info.sections[KINDS].count;
+        if(num_tokens == 0 || info.sections[OFFSETS].count != num_tokens ||
+            info.sections[LENGTHS].count != num_tokens || info.sections[PAYLOADS].count != num_tokens)
+            return false;
+
+        // The tokens themselves are covered by the checksum only, as checking them would take
+        // about as long as lexing. The tables they refer to are small.
+        auto inBounds = [&](const CachedString& str, Section bytes) {
+            return str.offset <= info.sections[bytes].count && str.length <= info.sections[bytes].count - str.offset;
+        };
+        for(const auto& str : section<CachedString>(data, STRINGS)) {
+            if(!inBounds(str, STRING_BYTES))
+                return false;
+        }
+        for(const auto& str : section<CachedString>(data, FILES)) {
+            if(!inBounds(str, FILE_BYTES))
+                return false;
+        }
+        for(const auto& diagnostic : section<CachedDiagnostic>(data, DIAGNOSTICS)) {
+            if(!inBounds(diagnostic.msg, DIAGNOSTIC_BYTES) || diagnostic.offset > source.size() || diagnostic.type > Diagnostic::NOTE)
+                return false;
+        }
+
+        auto regions = section<CachedRegion>(data, REGIONS);
+        for(const auto& region : regions) {
+            if(region.file_id >= info.sections[FILES].count || region.offset > source.size())
+                return false;
+        }
+        return !regions.empty();
+    }
+
+    // Adds the strings of a table to a blob and an index into it
+    template <typename F>
+    void addStrings(size_t count, F&& get, std::vector<CachedString>& index, std::string& bytes) {
+        index.reserve(count);
+        for(size_t i = 0; i < count; ++i) {
+            std::string_view str = get(i);
+            index.push_back({bytes.size(), str.size()});
+            bytes.append(str);
+        }
+    }
+}
+
+TokenCache::TokenCache(const char* data, size_t size) :
+    data(data), size(size) {}
+
+TokenCache::TokenCache(TokenCache&& other) noexcept :
+    data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {}
+
+TokenCache& TokenCache::operator=(TokenCache&& other) noexcept {
+    std::swap(this->data, other.data);
+    std::swap(this->size, other.size);
+    return *this;
+}
+
+TokenCache::~TokenCache() {
+    if(this->data)
+        ::munmap(const_cast<char*>(this->data), this->size);
+}
+
+std::optional<TokenCache> TokenCache::open(const char* path, const SourceBuffer& input) {
+    FileDescriptor file = {::open(path, O_RDONLY)};
+    if(file.fd < 0)
+        return std::nullopt;
+
+    struct stat info;
+    if(::fstat(file.fd, &info) < 0 || !S_ISREG(info.st_mode) || size_t(info.st_size) < sizeof(Header))
+        return std::nullopt;
+
+    void* mapping = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if(mapping == MAP_FAILED)
+        return std::nullopt;
+
+    TokenCache cache(static_cast<const char*>(mapping), info.st_size);
+    if(!isValid(cache.data, cache.size, input.contents()))
+        return std::nullopt;
+    return cache;
+}
+
+TokenBuffer TokenCache::load(const SourceBuffer& input, CompileInfo& compile_info) const {
+    auto file_bytes = section<char>(this->data, FILE_BYTES);
+    for(const auto& [offset, length] : section<CachedString>(this->data, FILES))
+        compile_info.files.addFile(std::string_view(file_bytes.data() + offset, length));
+
+    // The first region is the one every buffer starts with.
+    auto regions = section<CachedRegion>(this->data, REGIONS);
+    SourceMap::BufferId buffer_id = compile_info.sources.addBuffer(input.contents(), regions[0].file_id);
+    for(const auto& region : regions.subspan(1))
+        compile_info.sources.addLineMarker(buffer_id, region.offset, region.line, region.file_id, region.flags);
+
+    auto diagnostic_bytes = section<char>(this->data, DIAGNOSTIC_BYTES);
+    for(const auto& [offset, type, msg] : section<CachedDiagnostic>(this->data, DIAGNOSTICS)) {
+        std::string_view text(diagnostic_bytes.data() + msg.offset, msg.length);
+        compile_info.diagnostics.add({Diagnostic::Type(type), compile_info.sources.location(buffer_id, offset), text});
+    }
+
+    auto string_bytes = section<uint8_t>(this->data, STRING_BYTES);
+    for(const auto& [offset, length] : section<CachedString>(this->data, STRINGS))
+        compile_info.strings.addReference(StringTable::View(string_bytes.data() + offset, length));
+
+    TokenBuffer::Columns columns = {
+        section<TokenType>(this->data, KINDS),
+        section<uint32_t>(this->data, OFFSETS),
+        section<uint32_t>(this->data, LENGTHS),
+        section<uint32_t>(this->data, PAYLOADS),
+        section<TokenBuffer::IntegerLiteral>(this->data, INTEGERS),
+        section<TokenBuffer::FloatLiteral>(this->data, FLOATS),
+    };
+    return TokenBuffer(input.contents(), compile_info.sources.base(buffer_id), columns);
+}
+
+bool TokenCache::write(const char* path, const SourceBuffer& input, const TokenBuffer& tokens, const CompileInfo& compile_info) {
+    std::string contents(sizeof(Header), '\0');
+    Header info = {};
+    info.magic = MAGIC;
+    info.version = VERSION;
+    info.num_token_kinds = NUM_TOKEN_KINDS;
+    info.source_size = input.contents().size();
+    info.source_hash = hashBytes(input.contents());
+
+    auto add = [&](Section section, const void* elements, size_t count) {
+        contents.resize((contents.size() + 7) / 8 * 8, '\0');
+        info.sections[section] = {contents.size(), count};
+        contents.append(static_cast<const char*>(elements), count * ELEMENT_SIZES[section]);
+    };
+
+    const TokenBuffer::Columns& columns = tokens.columns();
+    add(KINDS, columns.kinds.data(), columns.kinds.size());
+    add(OFFSETS, columns.offsets.data(), columns.offsets.size());
+    add(LENGTHS, columns.lengths.data(), columns.lengths.size());
+    add(PAYLOADS, columns.payloads.data(), columns.payloads.size());
+    add(INTEGERS, columns.integers.data(), columns.integers.size());
+    add(FLOATS, columns.floats.data(), columns.floats.size());
+
+    std::vector<CachedString> strings;
+    std::string string_bytes;
+    addStrings(compile_info.strings.size(), [&](size_t i) {
+        auto str = compile_info.strings.get(i);
+        return std::string_view(reinterpret_cast<const char*>(str.data()), str.size());
+    }, strings, string_bytes);
+    add(STRINGS, strings.data(), strings.size());
+    add(STRING_BYTES, string_bytes.data(), string_bytes.size());
+
+    std::vector<CachedString> files;
+    std::string file_bytes;
+    addStrings(compile_info.files.size(), [&](size_t i) { return compile_info.files.getFile(i); }, files, file_bytes);
+    add(FILES, files.data(), files.size());
+    add(FILE_BYTES, file_bytes.data(), file_bytes.size());
+
+    std::vector<CachedRegion> regions;
+    for(const auto& region : compile_info.sources.regions(0))
+        regions.push_back({region.offset, region.line, region.file_id, region.flags});
+    add(REGIONS, regions.data(), regions.size());
+
+    std::vector<CachedDiagnostic> diagnostics;
+    std::string diagnostic_bytes;
+    for(const auto& diagnostic : compile_info.diagnostics.messages()) {
+        diagnostics.push_back({diagnostic.loc.offset - compile_info.sources.base(0), diagnostic.type, {diagnostic_bytes.size(), diagnostic.msg.size()}});
+        diagnostic_bytes.append(diagnostic.msg);
+    }
+    add(DIAGNOSTICS, diagnostics.data(), diagnostics.size());
+    add(DIAGNOSTIC_BYTES, diagnostic_bytes.data(), diagnostic_bytes.size());
+
+    info.file_size = contents.size();
+    info.checksum = hashBytes(std::string_view(contents).substr(sizeof(Header)));
+    std::memcpy(contents.data(), &info, sizeof(Header));
+
+    std::string temp_path = std::string(path) + "." + std::to_string(::getpid()) + ".tmp";
+    std::ofstream out(temp_path, std::ios::binary);
+    out.write(contents.data(), contents.size());
+    out.close();
+    if(!out || std::rename(temp_path.c_str(), path) != 0) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+TokenBuffer lexCached(const SourceBuffer& input, CompileInfo& compile_info, const char* cache_path, std::optional<TokenCache>& cache) {
+    cache = TokenCache::open(cache_path, input);
+    if(cache)
+        return cache->load(input, compile_info);
+
+    TokenBuffer tokens = lexParallel(input, compile_info);
+    TokenCache::write(cache_path, input, tokens, compile_info);
+    return tokens;
+}
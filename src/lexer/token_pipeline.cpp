@@ -0,0 +1,83 @@
+#include "lexer/token_pipeline.hpp"
+
+TokenPipeline::TokenPipeline(Lexer& lexer, CompileInfo& compile_info) :
+    lexer(lexer), diagnostics(compile_info.diagnostics), ring(new Batch[RING_SIZE]),
+    published(0), released(0), stopped(false), read_index(0), read_diagnostic(0), finished(false) {
+    this->lexer.setDiagnostics(this->lexer_diagnostics);
+    this->thread = std::thread([this] { this->run(); });
+}
+
+TokenPipeline::~TokenPipeline() {
+    // Wake the lexer thread up if it is waiting for room, as the remaining batches are not read anymore.
+    this->stopped.store(true, std::memory_order_relaxed);
+    this->released.store(this->published.load(std::memory_order_relaxed), std::memory_order_release);
+    this->released.notify_one();
+    this->thread.join();
+    this->lexer.setDiagnostics(this->diagnostics);
+}
+
+void TokenPipeline::run() {
+    size_t num_reported = 0;
+    for(size_t batch_index = 0;; ++batch_index) {
+        size_t released = this->released.load(std::memory_order_acquire);
+        while(batch_index - released == RING_SIZE && !this->stopped.load(std::memory_order_relaxed)) {
+            this->released.wait(released, std::memory_order_acquire);
+            released = this->released.load(std::memory_order_acquire);
+        }
+        if(this->stopped.load(std::memory_order_relaxed))
+            return;
+
+        Batch& batch = this->ring[batch_index % RING_SIZE];
+        batch.size = 0;
+        batch.diagnostics.clear();
+
+        bool done = false;
+        while(!done && batch.size < BATCH_SIZE) {
+            Token token = this->lexer.lex();
+            auto messages = this->lexer_diagnostics.messages();
+            for(; num_reported < messages.size(); ++num_reported)
+                batch.diagnostics.emplace_back(batch.size, messages[num_reported]);
+            batch.tokens[batch.size++] = token;
+            done = token.type == TokenType::EOI;
+        }
+
+        this->published.store(batch_index + 1, std::memory_order_release);
+        this->published.notify_one();
+        if(done)
+            return;
+    }
+}
+
+Token TokenPipeline::next() {
+    if(this->finished)
+        return this->end;
+
+    size_t batch_index = this->released.load(std::memory_order_relaxed);
+    size_t published = this->published.load(std::memory_order_acquire);
+    while(published == batch_index) {
+        this->published.wait(published, std::memory_order_acquire);
+        published = this->published.load(std::memory_order_acquire);
+    }
+
+    const Batch& batch = this->ring[batch_index % RING_SIZE];
+    for(; this->read_diagnostic < batch.diagnostics.size(); ++this->read_diagnostic) {
+        const auto& [index, diagnostic] = batch.diagnostics[this->read_diagnostic];
+        if(index != this->read_index)
+            break;
+        this->diagnostics.add(diagnostic);
+    }
+
+    Token token = batch.tokens[this->read_index++];
+    if(token.type == TokenType::EOI) {
+        this->finished = true;
+        this->end = token;
+    }
+
+    if(this->read_index == batch.size) {
+        this->read_index = 0;
+        this->read_diagnostic = 0;
+        this->released.store(batch_index + 1, std::memory_order_release);
+        this->released.notify_one();
+    }
+    return token;
+}
@@ -1,18 +1,39 @@
 #include "lexer/lexer.hpp"
+#include "lexer/parallel_lexer.hpp"
+#include "lexer/region_cache.hpp"
+#include "lexer/token_cache.hpp"
+#include "lexer/token_pipeline.hpp"
 #include "parser/parser.hpp"
+#include "preprocessor/preprocessor.hpp"
 #include "frontend/filetable.hpp"
 #include "frontend/stringtable.hpp"
 #include "frontend/ast.hpp"
+#include "frontend/source_buffer.hpp"
+#include "frontend/source_stream.hpp"
 #include "unicode.hpp"
 
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <algorithm>
 #include <bitset>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <utility>
+#include <vector>
 
-void print_tree(CompileInfo& compile_info, AstTable& ast, size_t node, size_t indent = 0) {
+#include <unistd.h>
+
+namespace {
+    // Nodes nested deeper than this are printed at this indentation, so that deeply nested
+    // input does not take time quadratic in its depth to print.
+    constexpr const size_t MAX_PRINT_INDENT = 64;
+}
+
+void print_node(CompileInfo& compile_info, AstTable& ast, size_t node, size_t indent) {
     auto print_indent = [&]() {
-        for(size_t i = 0; i < indent; ++i) {
+        for(size_t i = 0; i < std::min(indent, MAX_PRINT_INDENT); ++i) {
             std::cout << "  ";
         }
     };
@@ -36,6 +57,24 @@ void print_tree(CompileInfo& compile_info, AstTable& ast, size_t node, size_t in
             std::cout << "integer: " << integer_node_info.integer << std::endl;
             break;
         }
+        case AstNodeType::IDENTIFIER_EXPR:
+        case AstNodeType::TYPE_NAME:
+        case AstNodeType::NAME_DECLARATOR: {
+            print_indent();
+
+            NameAstNode& name_node_info = (NameAstNode&)node_info;
+            std::cout << "name: " << name_node_info.name << std::endl;
+            break;
+        }
+        case AstNodeType::DECL_SPECIFIERS:
+        case AstNodeType::POINTER_DECLARATOR: {
+            IntegerAstNode& specifiers_node_info = (IntegerAstNode&)node_info;
+            if(specifiers_node_info.integer != 0) {
+                print_indent();
+                std::cout << "specifiers: " << specifiers_node_info.integer << std::endl;
+            }
+            break;
+        }
         case AstNodeType::SWITCH_STAT: {
             SwitchAstNode& switch_node_info = (SwitchAstNode&)node_info;
             if(switch_node_info.default_id != INVALID_ASTNODE_ID) {
@@ -66,32 +105,225 @@ void print_tree(CompileInfo& compile_info, AstTable& ast, size_t node, size_t in
     if(node_info.children.size() > 0) {
         print_indent();
         std::cout << "children:" << std::endl;
+    }
+}
+
+// Prints the tree with an explicit stack rather than recursing, as the parser does with
+// --iterative, so that deeply nested input does not overflow the stack.
+void print_tree(CompileInfo& compile_info, AstTable& ast, size_t root) {
+    // Nodes still to print, with their depth, the next one at the back
+    std::vector<std::pair<size_t, size_t>> pending = {{root, 0}};
+    while(!pending.empty()) {
+        auto [node, depth] = pending.back();
+        pending.pop_back();
 
-        for(size_t i : node_info.children) {
-            print_tree(compile_info, ast, i, indent+1);
+        print_node(compile_info, ast, node, depth);
+
+        auto& children = ast.getNode(node).children;
+        for(auto it = children.rbegin(); it != children.rend(); ++it) {
+            pending.emplace_back(*it, depth + 2);
         }
     }
 }
 
+void print_stats(const Parser::Stats& stats) {
+    std::cerr << "parser: " << stats.tentative_parses << " tentative parses, " << stats.backtracks << " backtracked ("
+        << (stats.tentative_parses ? stats.backtracks * 100 / stats.tentative_parses : 0) << "%), "
+        << stats.backtracked_tokens << " tokens read again" << std::endl;
+}
+
+// Lexes the input keeping whitespace and comments, and returns the offset of the first byte
+// that they and the raw text of the tokens do not reproduce, if there is one.
+std::optional<size_t> check_lossless(const SourceBuffer& input, CompileInfo& compile_info) {
+    BasicLexer<LosslessLexerPolicy> lexer(input, compile_info);
+    TokenBuffer tokens = lexer.lexAll();
+
+    std::string_view source = input.contents();
+    std::string output;
+    for(size_t i = 0; i < tokens.size(); ++i) {
+        for(const Trivia& trivia : tokens.leadingTrivia(i))
+            output += source.substr(trivia.offset, trivia.length);
+        output += tokens.raw(i);
+    }
+
+    auto [expected, actual] = std::mismatch(source.begin(), source.end(), output.begin(), output.end());
+    if(expected == source.end() && actual == output.end())
+        return std::nullopt;
+    return expected - source.begin();
+}
+
 int main(int argc, char* argv[]) {
+    // With --pipeline, a file is lexed on another thread while it is parsed, rather than up front.
+    // With --preprocess, it is run through the preprocessor, using -I and -D options.
+    // With --region-cache, every argument is a preprocessed translation unit, and headers
+    // they have in common are lexed once. With --token-cache=<file>, the tokens are saved
+    // to the file, and read from it again while the input is unchanged. With --iterative, the
+    // parser keeps its own stack rather than recursing, for deeply nested input. With
+    // --max-errors=<n>, parsing stops after n errors. With --stats, parser statistics are printed.
+    // With --lossless, a file is only lexed, checking that its tokens and trivia reproduce it.
+    bool pipeline = false;
+    bool preprocess = false;
+    bool region_cache = false;
+    bool iterative = false;
+    bool show_stats = false;
+    bool lossless = false;
+    size_t max_errors = Parser::DEFAULT_MAX_ERRORS;
+    const char* token_cache_path = nullptr;
+    std::vector<std::string_view> include_paths;
+    std::vector<std::pair<std::string_view, std::string_view>> defines;
+    for(; argc > 2 && argv[1][0] == '-' && argv[1][1] != '\0'; --argc, ++argv) {
+        std::string_view option = argv[1];
+        if(option == "--pipeline")
+            pipeline = true;
+        else if(option == "--preprocess")
+            preprocess = true;
+        else if(option == "--region-cache")
+            region_cache = true;
+        else if(option == "--iterative")
+            iterative = true;
+        else if(option == "--stats")
+            show_stats = true;
+        else if(option == "--lossless")
+            lossless = true;
+        else if(option.starts_with("--max-errors="))
+            max_errors = std::strtoull(argv[1] + std::strlen("--max-errors="), nullptr, 10);
+        else if(option.starts_with("--token-cache="))
+            token_cache_path = argv[1] + std::strlen("--token-cache=");
+        else if(option.starts_with("-I"))
+            include_paths.push_back(option.substr(2));
+        else if(option.starts_with("-D")) {
+            std::string_view definition = option.substr(2);
+            size_t equals = definition.find('=');
+            if(equals == std::string_view::npos)
+                defines.emplace_back(definition, "1");
+            else
+                defines.emplace_back(definition.substr(0, equals), definition.substr(equals + 1));
+        }
+        else {
+            std::cerr << "unknown option " << option << std::endl;
+            return 1;
+        }
+    }
     if(argc < 2)
         return 1;
-    std::ifstream input(argv[1]);
-    std::stringstream ss;
-    ss << input.rdbuf();
 
-    std::string input_str = ss.str();
+    if(region_cache) {
+        RegionCache cache;
+        for(int i = 1; i < argc; ++i) {
+            auto input = SourceBuffer::open(argv[i]);
+            if(!input) {
+                std::cerr << "could not open " << argv[i] << std::endl;
+                return 1;
+            }
 
-    CompileInfo compile_info;
-    Lexer lexer(input_str, compile_info);
+            CompileInfo compile_info;
+            AstTable ast;
+            TokenBuffer tokens = cache.lex(*input, compile_info);
+            Parser parser(tokens, compile_info, ast);
+            parser.setIterative(iterative);
+            parser.setMaxErrors(max_errors);
+            size_t root_node = parser.parse();
+            if(show_stats)
+                print_stats(parser.stats());
+            if(root_node != INVALID_ASTNODE_ID)
+                print_tree(compile_info, ast, root_node);
+            compile_info.diagnostics.sortByLocation();
+            compile_info.printDiagnostics(std::cout, true);
+        }
 
+        const auto& stats = cache.stats();
+        size_t lookups = stats.hits + stats.misses;
+        std::cerr << "region cache: " << stats.hits << " hits, " << stats.misses << " misses ("
+            << (lookups ? stats.hits * 100 / lookups : 0) << "% hit rate), "
+            << stats.saved_bytes << " of " << stats.total_bytes << " bytes not lexed" << std::endl;
+        return 0;
+    }
+
+    // The source map refers to the input when printing diagnostics, so it has to outlive them.
+    std::optional<SourceBuffer> input;
+    std::optional<TokenCache> token_cache;
+    CompileInfo compile_info;
+    std::optional<Preprocessor> preprocessor;
     AstTable ast;
-    Parser parser(lexer, compile_info, ast);
+    size_t root_node;
+
+    if(preprocess) {
+        preprocessor.emplace(compile_info);
+        for(auto path : include_paths)
+            preprocessor->addIncludePath(path);
+        for(auto [name, value] : defines)
+            preprocessor->define(name, value);
+        if(!preprocessor->open(argv[1])) {
+            std::cerr << "could not open " << argv[1] << std::endl;
+            return 1;
+        }
+
+        Parser parser(*preprocessor, compile_info, ast);
+        parser.setIterative(iterative);
+        parser.setMaxErrors(max_errors);
+        root_node = parser.parse();
+        if(show_stats)
+            print_stats(parser.stats());
+    }
+    else if(std::string_view(argv[1]) == "-") {
+        // Standard input is lexed as a stream while parsing, so that preprocessor output
+        // of any size can be piped in without keeping all of it in memory.
+        SourceStream input(STDIN_FILENO);
+        Lexer lexer(input, compile_info);
+        Parser parser(lexer, compile_info, ast);
+        parser.setIterative(iterative);
+        parser.setMaxErrors(max_errors);
+        root_node = parser.parse();
+        if(show_stats)
+            print_stats(parser.stats());
+    }
+    else {
+        input = SourceBuffer::open(argv[1]);
+        if(!input) {
+            std::cerr << "could not open " << argv[1] << std::endl;
+            return 1;
+        }
+
+        if(lossless) {
+            auto mismatch = check_lossless(*input, compile_info);
+            compile_info.printDiagnostics(std::cout, true);
+            if(mismatch) {
+                std::cerr << "tokens and trivia differ from the input at offset " << *mismatch << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+
+        if(pipeline) {
+            Lexer lexer(*input, compile_info);
+            TokenPipeline tokens(lexer, compile_info);
+            Parser parser(tokens, compile_info, ast);
+            parser.setIterative(iterative);
+            parser.setMaxErrors(max_errors);
+            root_node = parser.parse();
+            if(show_stats)
+                print_stats(parser.stats());
+        }
+        else {
+            TokenBuffer tokens = token_cache_path ? lexCached(*input, compile_info, token_cache_path, token_cache) : lexParallel(*input, compile_info);
+            Parser parser(tokens, compile_info, ast);
+            parser.setIterative(iterative);
+            parser.setMaxErrors(max_errors);
+            root_node = parser.parse();
+            if(show_stats)
+                print_stats(parser.stats());
+        }
+    }
 
-    size_t root_node = parser.parse();
     if(root_node != INVALID_ASTNODE_ID)
         print_tree(compile_info, ast, root_node);
 
+    // Lexer diagnostics of a buffer lexed up front all come before those of the parser, while
+    // lexing along with parsing interleaves them, so they are put in source order for all modes
+    // to agree. Included files of the preprocessor are separate buffers, which stay in the order
+    // they were reported in.
+    if(!preprocess)
+        compile_info.diagnostics.sortByLocation();
     compile_info.printDiagnostics(std::cout, true);
     return 0;
 }
@@ -1,79 +1,535 @@
 #include "parser/parser.hpp"
-#include "parser/parseexception.hpp"
 
-#include <sstream>
+#include <array>
+#include <cassert>
+#include <optional>
+#include <string>
 #include <limits>
+#include <algorithm>
 
 #include <iostream>
 
+namespace {
+    constexpr const size_t NUM_TOKEN_TYPES = size_t(TokenType::END_OF_DIRECTIVE) + 1;
+
+    // Binary operators below assignment, which all associate to the left. Operators with
+    // a higher power bind tighter; 0 means the token is not a binary operator.
+    struct BinaryOperator {
+        uint8_t power;
+        AstNodeType node;
+    };
+
+    constexpr const uint8_t LOWEST_BINARY_POWER = 1;
+
+    constexpr std::array<BinaryOperator, NUM_TOKEN_TYPES> buildBinaryOperators() {
+        std::array<BinaryOperator, NUM_TOKEN_TYPES> operators = {};
+        auto add = [&](TokenType token, uint8_t power, AstNodeType node) {
+            operators[size_t(token)] = {power, node};
+        };
+        add(TokenType::OR, 1, AstNodeType::LOGICAL_OR_EXPR);
+        add(TokenType::AND, 2, AstNodeType::LOGICAL_AND_EXPR);
+        add(TokenType::BITOR, 3, AstNodeType::BITWISE_OR_EXPR);
+        add(TokenType::XOR, 4, AstNodeType::BITWISE_XOR_EXPR);
+        add(TokenType::BITAND, 5, AstNodeType::BITWISE_AND_EXPR);
+        add(TokenType::EQUAL, 6, AstNodeType::EQUAL_EXPR);
+        add(TokenType::NOTEQUAL, 6, AstNodeType::NOTEQUAL_EXPR);
+        add(TokenType::LESS, 7, AstNodeType::LESS_EXPR);
+        add(TokenType::GREATER, 7, AstNodeType::GREATER_EXPR);
+        add(TokenType::LESSEQ, 7, AstNodeType::LESSEQ_EXPR);
+        add(TokenType::GREATEREQ, 7, AstNodeType::GREATEREQ_EXPR);
+        add(TokenType::LSHIFT, 8, AstNodeType::LSHIFT_EXPR);
+        add(TokenType::RSHIFT, 8, AstNodeType::RSHIFT_EXPR);
+        add(TokenType::PLUS, 9, AstNodeType::ADD_EXPR);
+        add(TokenType::MINUS, 9, AstNodeType::SUB_EXPR);
+        add(TokenType::STAR, 10, AstNodeType::MUL_EXPR);
+        add(TokenType::DIV, 10, AstNodeType::DIV_EXPR);
+        add(TokenType::MOD, 10, AstNodeType::MOD_EXPR);
+        add(TokenType::DOTSTAR, 11, AstNodeType::POINTER_TO_MEMBER_EXPR);
+        add(TokenType::STARROW, 11, AstNodeType::INDIRECT_POINTER_TO_MEMBER_EXPR);
+        return operators;
+    }
+
+    constexpr std::array<BinaryOperator, NUM_TOKEN_TYPES> BINARY_OPERATORS = buildBinaryOperators();
+
+    // Nodes of the prefix and assignment operators, used when parsing iteratively.
+    // AstNodeType::INVALID means the token is not such an operator.
+    constexpr std::array<AstNodeType, NUM_TOKEN_TYPES> buildPrefixOperators() {
+        std::array<AstNodeType, NUM_TOKEN_TYPES> operators = {};
+        operators[size_t(TokenType::INCREMENT)] = AstNodeType::PREFIX_INCREMENT_EXPR;
+        operators[size_t(TokenType::DECREMENT)] = AstNodeType::PREFIX_DECREMENT_EXPR;
+        operators[size_t(TokenType::PLUS)] = AstNodeType::UNARY_PLUS_EXPR;
+        operators[size_t(TokenType::MINUS)] = AstNodeType::UNARY_MINUS_EXPR;
+        operators[size_t(TokenType::NOT)] = AstNodeType::LOGICAL_NOT_EXPR;
+        operators[size_t(TokenType::BITNOT)] = AstNodeType::BITWISE_NOT_EXPR;
+        operators[size_t(TokenType::STAR)] = AstNodeType::DEREF_EXPR;
+        operators[size_t(TokenType::BITAND)] = AstNodeType::ADDRESS_OF_EXPR;
+        operators[size_t(TokenType::KEY_SIZEOF)] = AstNodeType::SIZEOF_EXPR;
+        return operators;
+    }
+
+    constexpr std::array<AstNodeType, NUM_TOKEN_TYPES> buildAssignmentOperators() {
+        std::array<AstNodeType, NUM_TOKEN_TYPES> operators = {};
+        operators[size_t(TokenType::ASSIGN)] = AstNodeType::ASSIGN_EXPR;
+        operators[size_t(TokenType::ADD_ASSIGN)] = AstNodeType::ADD_ASSIGN_EXPR;
+        operators[size_t(TokenType::SUB_ASSIGN)] = AstNodeType::SUB_ASSIGN_EXPR;
+        operators[size_t(TokenType::MUL_ASSIGN)] = AstNodeType::MUL_ASSIGN_EXPR;
+        operators[size_t(TokenType::DIV_ASSIGN)] = AstNodeType::DIV_ASSIGN_EXPR;
+        operators[size_t(TokenType::MOD_ASSIGN)] = AstNodeType::MOD_ASSIGN_EXPR;
+        operators[size_t(TokenType::LSHIFT_ASSIGN)] = AstNodeType::LSHIFT_ASSIGN_EXPR;
+        operators[size_t(TokenType::RSHIFT_ASSIGN)] = AstNodeType::RSHIFT_ASSIGN_EXPR;
+        operators[size_t(TokenType::BITAND_ASSIGN)] = AstNodeType::BITAND_ASSIGN_EXPR;
+        operators[size_t(TokenType::BITOR_ASSIGN)] = AstNodeType::BITOR_ASSIGN_EXPR;
+        operators[size_t(TokenType::XOR_ASSIGN)] = AstNodeType::BITXOR_ASSIGN_EXPR;
+        return operators;
+    }
+
+    constexpr std::array<AstNodeType, NUM_TOKEN_TYPES> PREFIX_OPERATORS = buildPrefixOperators();
+    constexpr std::array<AstNodeType, NUM_TOKEN_TYPES> ASSIGNMENT_OPERATORS = buildAssignmentOperators();
+
+    //TODO: add other expression initial tokens
+    bool isExpressionStart(TokenType type) {
+        switch(type) {
+            case TokenType::ID:
+            case TokenType::LITERAL_INTEGER:
+            case TokenType::INCREMENT:
+            case TokenType::DECREMENT:
+            case TokenType::OPEN_PAR:
+            case TokenType::NOT:
+            case TokenType::BITNOT:
+            case TokenType::STAR:
+            case TokenType::BITAND:
+            case TokenType::KEY_SIZEOF:
+            case TokenType::KEY_THROW:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool isPostfixStart(TokenType type) {
+        switch(type) {
+            case TokenType::INCREMENT:
+            case TokenType::DECREMENT:
+            case TokenType::OPEN_PAR:
+            case TokenType::OPEN_SB:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    const std::vector<TokenType> STATEMENT_STARTS = {
+        TokenType::ID,
+        TokenType::LITERAL_INTEGER,
+        TokenType::INCREMENT,
+        TokenType::DECREMENT,
+        TokenType::OPEN_PAR,
+        TokenType::NOT,
+        TokenType::BITNOT,
+        TokenType::STAR,
+        TokenType::BITAND,
+        TokenType::KEY_SIZEOF,
+        TokenType::KEY_THROW,
+        TokenType::SEMICOLON,
+        TokenType::OPEN_CB,
+        TokenType::KEY_IF,
+        TokenType::KEY_SWITCH,
+        TokenType::KEY_DEFAULT,
+        TokenType::KEY_CASE,
+        TokenType::KEY_WHILE,
+        TokenType::KEY_DO,
+        TokenType::KEY_FOR,
+        TokenType::KEY_BREAK,
+        TokenType::KEY_CONTINUE,
+        TokenType::KEY_RETURN
+    };
+
+    // Tokens synchronize stops at, apart from a semicolon that it skips. These start statements
+    // that are not expressions, or end a compound statement.
+    bool isSynchronizingToken(TokenType type) {
+        switch(type) {
+            case TokenType::OPEN_CB:
+            case TokenType::CLOSE_CB:
+            case TokenType::KEY_IF:
+            case TokenType::KEY_SWITCH:
+            case TokenType::KEY_DEFAULT:
+            case TokenType::KEY_CASE:
+            case TokenType::KEY_WHILE:
+            case TokenType::KEY_DO:
+            case TokenType::KEY_FOR:
+            case TokenType::KEY_BREAK:
+            case TokenType::KEY_CONTINUE:
+            case TokenType::KEY_RETURN:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Specifiers of declarations other than type specifiers, see DeclSpecifier. 0 means the
+    // token is not such a specifier.
+    constexpr std::array<uint64_t, NUM_TOKEN_TYPES> buildDeclSpecifiers() {
+        std::array<uint64_t, NUM_TOKEN_TYPES> specifiers = {};
+        specifiers[size_t(TokenType::KEY_CONST)] = DECL_CONST;
+        specifiers[size_t(TokenType::KEY_VOLATILE)] = DECL_VOLATILE;
+        specifiers[size_t(TokenType::KEY_TYPEDEF)] = DECL_TYPEDEF;
+        specifiers[size_t(TokenType::KEY_STATIC)] = DECL_STATIC;
+        specifiers[size_t(TokenType::KEY_EXTERN)] = DECL_EXTERN;
+        specifiers[size_t(TokenType::KEY_REGISTER)] = DECL_REGISTER;
+        specifiers[size_t(TokenType::KEY_MUTABLE)] = DECL_MUTABLE;
+        return specifiers;
+    }
+
+    constexpr std::array<uint64_t, NUM_TOKEN_TYPES> DECL_SPECIFIERS = buildDeclSpecifiers();
+    // At most one of these can be given
+    constexpr const uint64_t STORAGE_CLASSES = DECL_TYPEDEF | DECL_STATIC | DECL_EXTERN | DECL_REGISTER | DECL_MUTABLE;
+
+    bool isBuiltinTypeSpecifier(TokenType type) {
+        switch(type) {
+            case TokenType::KEY_VOID:
+            case TokenType::KEY_BOOL:
+            case TokenType::KEY_WCHAR_T:
+            case TokenType::KEY_SHORT:
+            case TokenType::KEY_INT:
+            case TokenType::KEY_LONG:
+            case TokenType::KEY_SIGNED:
+            case TokenType::KEY_UNSIGNED:
+            case TokenType::KEY_FLOAT:
+            case TokenType::KEY_DOUBLE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Keywords that start a declaration, rather than an identifier that might name a type
+    bool isDeclSpecifier(TokenType type) {
+        return DECL_SPECIFIERS[size_t(type)] != 0 || isBuiltinTypeSpecifier(type);
+    }
+
+    // Built-in type specifiers, which can be given in any order
+    struct TypeSpecifiers {
+        // Of void, bool, wchar_t, int, float and double
+        TokenType type;
+        size_t longs;
+        bool is_short;
+        bool is_signed;
+        bool is_unsigned;
+    };
+
+    std::optional<PrimitiveType::Kind> primitiveType(const TypeSpecifiers& specifiers) {
+        bool has_sign = specifiers.is_signed || specifiers.is_unsigned;
+        if(specifiers.is_signed && specifiers.is_unsigned)
+            return std::nullopt;
+
+        switch(specifiers.type) {
+            case TokenType::KEY_DOUBLE:
+                if(has_sign || specifiers.is_short || specifiers.longs > 1)
+                    return std::nullopt;
+                return specifiers.longs > 0 ? PrimitiveType::LONG_DOUBLE : PrimitiveType::DOUBLE;
+            case TokenType::INVALID:
+            case TokenType::KEY_INT:
+                if((specifiers.is_short && specifiers.longs > 0) || specifiers.longs > 2)
+                    return std::nullopt;
+                if(specifiers.is_short)
+                    return specifiers.is_unsigned ? PrimitiveType::UNSIGNED_SHORT : PrimitiveType::SHORT;
+                if(specifiers.longs == 1)
+                    return specifiers.is_unsigned ? PrimitiveType::UNSIGNED_LONG : PrimitiveType::LONG;
+                if(specifiers.longs == 2)
+                    return specifiers.is_unsigned ? PrimitiveType::UNSIGNED_LONG_LONG : PrimitiveType::LONG_LONG;
+                return specifiers.is_unsigned ? PrimitiveType::UNSIGNED_INT : PrimitiveType::INT;
+            default:
+                break;
+        }
+
+        if(has_sign || specifiers.is_short || specifiers.longs > 0)
+            return std::nullopt;
+        switch(specifiers.type) {
+            case TokenType::KEY_VOID:
+                return PrimitiveType::VOID;
+            case TokenType::KEY_BOOL:
+                return PrimitiveType::BOOL;
+            case TokenType::KEY_WCHAR_T:
+                return PrimitiveType::WCHAR_T;
+            default:
+                return PrimitiveType::FLOAT;
+        }
+    }
+
+    // The iterative parser keeps the constructs it is in on a stack of frames. A frame either
+    // starts parsing a construct, or continues one after the constructs it contains have been
+    // parsed. Parsed nodes are kept on a stack of operands until the node containing them is
+    // built.
+    enum class State : uint8_t {
+        STATEMENT_LIST,
+        STATEMENT_LIST_NEXT,
+        STATEMENT,
+        STATEMENT_END,
+        EXPR_STAT_END,
+        COMPOUND_END,
+        CONDITION,
+        CONDITION_END,
+        DECLARATION_INITIALIZER,
+        DECLARATION_INITIALIZER_END,
+        DECLARATION_NEXT,
+        IF_CONDITION,
+        IF_BODY,
+        IF_ELSE_BODY,
+        SWITCH_CONDITION,
+        SWITCH_BODY,
+        CASE_END,
+        WHILE_CONDITION,
+        WHILE_BODY,
+        DO_BODY,
+        DO_CONDITION,
+        FOR_INIT_END,
+        FOR_CONDITION,
+        FOR_CONDITION_END,
+        FOR_INCREMENT_END,
+        FOR_BODY,
+        RETURN_END,
+
+        COMMA_NEXT,
+        COMMA_END,
+        ASSIGN,
+        ASSIGN_NEXT,
+        ASSIGN_END,
+        TERNARY_MIDDLE,
+        TERNARY_END,
+        THROW_END,
+        BINARY_NEXT,
+        BINARY_END,
+        PREFIX,
+        PREFIX_END,
+        PAREN_END,
+        POSTFIX_NEXT,
+        SUBSCRIPT_END,
+        CALL_ARGUMENT,
+    };
+
+    struct Frame {
+        State state;
+        // Lowest power of the binary operators that are parsed next
+        uint8_t power;
+        // Node of the operator that is parsed
+        AstNodeType node;
+        // Number of operands below the elements of a list or declaration, or the node of a switch
+        size_t base;
+        // Switch enclosing the one that is parsed
+        size_t outer_switch;
+        // Of a case label
+        SourceLocation pos;
+    };
+}
+
 Parser::Parser(Lexer& lexer, CompileInfo& compile_info, AstTable& ast) :
-        lexer(lexer), compile_info(compile_info), ast(ast), nearest_switch(INVALID_ASTNODE_ID) {
+        lexer(&lexer), pipeline(nullptr), preprocessor(nullptr), tokens(nullptr), token_index(0), furthest_token_index(0), lookahead_first(0), lookahead_count(0),
+        compile_info(compile_info), ast(ast), nearest_switch(INVALID_ASTNODE_ID), iterative(false),
+        panicking(false), stopped(false), num_errors(0), max_errors(DEFAULT_MAX_ERRORS),
+        replay_index(0), tentative(0), statistics{0, 0, 0} {
 
 }
 
-Token Parser::next_token() {
-    if(this->token_stack.size() > 0) {
-        Token result = this->token_stack.back();
-        this->token_stack.pop_back();
-        return result;
+Parser::Parser(TokenPipeline& pipeline, CompileInfo& compile_info, AstTable& ast) :
+        lexer(nullptr), pipeline(&pipeline), preprocessor(nullptr), tokens(nullptr), token_index(0), furthest_token_index(0), lookahead_first(0), lookahead_count(0),
+        compile_info(compile_info), ast(ast), nearest_switch(INVALID_ASTNODE_ID), iterative(false),
+        panicking(false), stopped(false), num_errors(0), max_errors(DEFAULT_MAX_ERRORS),
+        replay_index(0), tentative(0), statistics{0, 0, 0} {
+
+}
+
+Parser::Parser(Preprocessor& preprocessor, CompileInfo& compile_info, AstTable& ast) :
+        lexer(nullptr), pipeline(nullptr), preprocessor(&preprocessor), tokens(nullptr), token_index(0), furthest_token_index(0), lookahead_first(0), lookahead_count(0),
+        compile_info(compile_info), ast(ast), nearest_switch(INVALID_ASTNODE_ID), iterative(false),
+        panicking(false), stopped(false), num_errors(0), max_errors(DEFAULT_MAX_ERRORS),
+        replay_index(0), tentative(0), statistics{0, 0, 0} {
+
+}
+
+Parser::Parser(const TokenBuffer& tokens, CompileInfo& compile_info, AstTable& ast) :
+        lexer(nullptr), pipeline(nullptr), preprocessor(nullptr), tokens(&tokens), token_index(0), furthest_token_index(0), lookahead_first(0), lookahead_count(0),
+        compile_info(compile_info), ast(ast), nearest_switch(INVALID_ASTNODE_ID), iterative(false),
+        panicking(false), stopped(false), num_errors(0), max_errors(DEFAULT_MAX_ERRORS),
+        replay_index(0), tentative(0), statistics{0, 0, 0} {
+
+}
+
+Token Parser::lex() {
+    if(this->stopped) {
+        Token end = {};
+        end.type = TokenType::EOI;
+        return end;
+    }
+    if(this->tokens) {
+        // Past the end, keep returning the end of input token
+        size_t index = std::min(this->token_index++, this->tokens->size() - 1);
+        return this->tokens->get(index);
     }
-    return this->lexer.lex();
+    if(this->replay_index < this->replay.size())
+        return this->replay[this->replay_index++];
+    if(this->tentative == 0 && !this->replay.empty()) {
+        this->replay.clear();
+        this->replay_index = 0;
+    }
+
+    Token token = this->pipeline ? this->pipeline->next() : this->preprocessor ? this->preprocessor->next() : this->lexer->lex();
+    if(this->tentative > 0) {
+        this->replay.push_back(token);
+        ++this->replay_index;
+    }
+    return token;
 }
 
-Token Parser::peek_token() {
-    if(this->token_stack.size() > 0)
-        return this->token_stack.back();
-    Token result = this->lexer.lex();
-    this->token_stack.push_back(result);
+Token Parser::next_token() {
+    if(this->lookahead_count == 0)
+        return this->lex();
+
+    Token result = this->lookahead[this->lookahead_first];
+    this->lookahead_first = (this->lookahead_first + 1) % LOOKAHEAD;
+    --this->lookahead_count;
     return result;
 }
 
+const Token& Parser::peek(size_t k) {
+    assert(k < LOOKAHEAD);
+    while(this->lookahead_count <= k) {
+        this->lookahead[(this->lookahead_first + this->lookahead_count) % LOOKAHEAD] = this->lex();
+        ++this->lookahead_count;
+    }
+    return this->lookahead[(this->lookahead_first + k) % LOOKAHEAD];
+}
+
 void Parser::unread(const Token& t) {
-    this->token_stack.push_back(t);
+    assert(this->lookahead_count < LOOKAHEAD);
+    this->lookahead_first = (this->lookahead_first + LOOKAHEAD - 1) % LOOKAHEAD;
+    this->lookahead[this->lookahead_first] = t;
+    ++this->lookahead_count;
 }
 
 Token Parser::expect(TokenType token) {
-    Token lookahead = this->next_token();
-    if(lookahead.type != token)
-        this->throwError(lookahead, {token});
-    return lookahead;
+    const Token& lookahead = this->peek();
+    // While recovering, tokens are left for synchronize to skip.
+    if(this->panicking || lookahead.type != token) {
+        this->reportUnexpected(lookahead, {token});
+        return lookahead;
+    }
+    return this->next_token();
 }
 
 void Parser::consume() {
-    this->next_token();
+    if(this->lookahead_count == 0) {
+        this->lex();
+        return;
+    }
+    this->lookahead_first = (this->lookahead_first + 1) % LOOKAHEAD;
+    --this->lookahead_count;
+}
+
+// The number of tokens read from the source, including those looked ahead at
+size_t Parser::position() const {
+    return this->tokens ? this->token_index : this->replay_index;
 }
 
-void Parser::throwError(const Token& err_token, const std::vector<TokenType>& expected) {
-    std::stringstream ss;
-    ss << "unexpected ";
+Parser::Checkpoint Parser::checkpoint() {
+    assert(!this->panicking);
+    ++this->tentative;
+    ++this->statistics.tentative_parses;
+    return {this->position(), this->lookahead, this->lookahead_first, this->lookahead_count, this->ast.size()};
+}
+
+void Parser::rewind(const Checkpoint& checkpoint) {
+    ++this->statistics.backtracks;
+    this->statistics.backtracked_tokens += (this->position() - this->lookahead_count) - (checkpoint.position - checkpoint.lookahead_count);
+
+    if(this->tokens) {
+        this->furthest_token_index = std::max(this->furthest_token_index, this->token_index);
+        this->token_index = checkpoint.position;
+    }
+    else
+        this->replay_index = checkpoint.position;
+    this->lookahead = checkpoint.lookahead;
+    this->lookahead_first = checkpoint.lookahead_first;
+    this->lookahead_count = checkpoint.lookahead_count;
+    this->ast.truncate(checkpoint.ast_size);
+    this->panicking = false;
+    --this->tentative;
+}
+
+void Parser::commit() {
+    --this->tentative;
+}
+
+void Parser::reportError(SourceLocation pos, std::string_view msg) {
+    // A tentative parse fails instead
+    if(this->tentative > 0) {
+        this->panicking = true;
+        return;
+    }
+    if(this->stopped)
+        return;
+
+    this->compile_info.diagnostics.error(pos, msg);
+    if(++this->num_errors == this->max_errors) {
+        // A buffer was lexed before parsing. Like a lexer running along with the parser, it
+        // should only report what it found up to the end of the last token that was read.
+        if(this->tokens) {
+            size_t last = std::min(std::max(this->furthest_token_index, this->token_index), this->tokens->size()) - 1;
+            this->compile_info.diagnostics.dropAfter({uint32_t(this->tokens->location(last).offset + this->tokens->raw(last).size())});
+        }
+        this->compile_info.diagnostics.note(pos, "too many errors, stopping here");
+        this->stopped = true;
+        this->panicking = true;
+        this->lookahead_count = 0;
+    }
+}
+
+void Parser::reportUnexpected(const Token& err_token, const std::vector<TokenType>& expected) {
+    if(this->panicking)
+        return;
+    this->panicking = true;
+    if(this->tentative > 0)
+        return;
+
+    std::string msg = "unexpected ";
     if(err_token.type == TokenType::EOI)
-        ss << "eof";
+        msg += "eof";
     else
-        ss << err_token.raw;
+        msg += err_token.raw;
 
     if(expected.size() > 0) {
-        ss << ", expected ";
+        msg += ", expected ";
         bool first = true;
         for(TokenType t : expected) {
             if(first)
                 first = false;
             else
-                ss << ", ";
-            ss << tokenTypeToString(t);
+                msg += ", ";
+            msg += tokenTypeToString(t);
         }
     }
 
-    this->compile_info.diagnostics.error(err_token.pos, ss.str());
-    throw ParseException();
+    this->reportError(err_token.pos, msg);
+}
+
+void Parser::synchronize() {
+    for(;;) {
+        TokenType type = this->peek().type;
+        if(type == TokenType::EOI || isSynchronizingToken(type))
+            break;
+        this->consume();
+        if(type == TokenType::SEMICOLON)
+            break;
+    }
+    this->panicking = false;
 }
 
 std::vector<size_t> Parser::parseList(TokenType expected_end) {
-    Token lookahead = this->peek_token();
+    TokenType lookahead = this->peek().type;
 
     std::vector<size_t> result;
     bool first = true;
 
-    while(lookahead.type != expected_end) {
+    while(lookahead != expected_end && !this->panicking) {
         if(first)
             first = false;
         else
@@ -82,39 +538,52 @@ std::vector<size_t> Parser::parseList(TokenType expected_end) {
         size_t next_expr = this->parseAssign();
         result.push_back(next_expr);
 
-        lookahead = this->peek_token();
+        lookahead = this->peek().type;
     }
 
+    this->expect(expected_end);
+    return result;
+}
+
+size_t Parser::parseName(AstNodeType type) {
+    size_t result = this->ast.addNameNode(type, this->peek().raw);
     this->consume();
     return result;
 }
 
 size_t Parser::parseAtom() {
-    Token lookahead = this->next_token();
+    const Token& lookahead = this->peek();
 
     switch(lookahead.type) {
-        case TokenType::LITERAL_INTEGER:
-            return this->ast.addIntegerNode(AstNodeType::INTEGER_CONSTANT, lookahead.integer.type, lookahead.integer.value);
+        case TokenType::ID:
+            return this->parseName(AstNodeType::IDENTIFIER_EXPR);
+        case TokenType::LITERAL_INTEGER: {
+            size_t result = this->ast.addIntegerNode(AstNodeType::INTEGER_CONSTANT, lookahead.integer.type, lookahead.integer.value);
+            this->consume();
+            return result;
+        }
         case TokenType::OPEN_PAR: {
+            this->consume();
             size_t result = this->parseExpr();
             this->expect(TokenType::CLOSE_PAR);
             return result;
         }
         default:
-            this->throwError(lookahead, {TokenType::LITERAL_INTEGER});
+            this->reportUnexpected(lookahead, {TokenType::LITERAL_INTEGER, TokenType::ID});
+            return this->ast.addNode(AstNodeType::ERROR_EXPR);
     }
 }
 
 size_t Parser::parsePostfix() {
     size_t lop = this->parseAtom();
 
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::INCREMENT ||
-            lookahead.type == TokenType::DECREMENT ||
-            lookahead.type == TokenType::OPEN_SB ||
-            lookahead.type == TokenType::OPEN_PAR) {
+    TokenType lookahead = this->peek().type;
+    while(lookahead == TokenType::INCREMENT ||
+            lookahead == TokenType::DECREMENT ||
+            lookahead == TokenType::OPEN_SB ||
+            lookahead == TokenType::OPEN_PAR) {
         this->consume();
-        switch(lookahead.type) {
+        switch(lookahead) {
             case TokenType::INCREMENT:
                 lop = this->ast.addNode(AstNodeType::POSTFIX_INCREMENT_EXPR, {lop});
                 break;
@@ -135,17 +604,17 @@ size_t Parser::parsePostfix() {
                 break;
         }
 
-        lookahead = this->peek_token();
+        lookahead = this->peek().type;
     }
     return lop;
 }
 
 size_t Parser::parsePrefix(bool disable_ccast) {
-    Token lookahead = this->peek_token();
+    TokenType lookahead = this->peek().type;
 
     //TODO: implement c-style casts and disable them when the flag is set
 
-    switch(lookahead.type) {
+    switch(lookahead) {
         case TokenType::INCREMENT:
             this->consume();
             return this->ast.addNode(AstNodeType::PREFIX_INCREMENT_EXPR, {this->parsePrefix()});
@@ -179,258 +648,33 @@ size_t Parser::parsePrefix(bool disable_ccast) {
     }
 }
 
-size_t Parser::parsePtrToMember() {
+size_t Parser::parseBinary(uint8_t min_power) {
     size_t lop = this->parsePrefix();
 
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::DOTSTAR ||
-        lookahead.type == TokenType::STARROW) {
-        this->consume();
-
-        size_t rop = this->parsePrefix();
-
-        switch(lookahead.type) {
-            case TokenType::DOTSTAR:
-                lop = this->ast.addNode(AstNodeType::POINTER_TO_MEMBER_EXPR, {lop, rop});
-                break;
-            case TokenType::STARROW:
-                lop = this->ast.addNode(AstNodeType::INDIRECT_POINTER_TO_MEMBER_EXPR, {lop, rop});
-                break;
-            default:
-                break;
-        }
-
-        lookahead = this->peek_token();
-    }
-    return lop;
-}
-
-size_t Parser::parseMultiply() {
-    size_t lop = this->parsePtrToMember();
-
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::STAR ||
-        lookahead.type == TokenType::DIV ||
-        lookahead.type == TokenType::MOD) {
-        this->consume();
-
-        size_t rop = this->parsePtrToMember();
-
-        switch(lookahead.type) {
-            case TokenType::STAR:
-                lop = this->ast.addNode(AstNodeType::MUL_EXPR, {lop, rop});
-                break;
-            case TokenType::DIV:
-                lop = this->ast.addNode(AstNodeType::DIV_EXPR, {lop, rop});
-                break;
-            case TokenType::MOD:
-                lop = this->ast.addNode(AstNodeType::MOD_EXPR, {lop, rop});
-                break;
-            default:
-                break;
-        }
-
-        lookahead = this->peek_token();
-    }
-    return lop;
-}
-
-size_t Parser::parseAdd() {
-    size_t lop = this->parseMultiply();
-
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::PLUS ||
-        lookahead.type == TokenType::MINUS) {
+    TokenType lookahead = this->peek().type;
+    const BinaryOperator* op = &BINARY_OPERATORS[size_t(lookahead)];
+    while(op->power >= min_power) {
         this->consume();
 
-        size_t rop = this->parseMultiply();
+        size_t rop = this->parseBinary(op->power + 1);
+        lop = this->ast.addNode(op->node, {lop, rop});
 
-        switch(lookahead.type) {
-            case TokenType::PLUS:
-                lop = this->ast.addNode(AstNodeType::ADD_EXPR, {lop, rop});
-                break;
-            case TokenType::MINUS:
-                lop = this->ast.addNode(AstNodeType::SUB_EXPR, {lop, rop});
-                break;
-            default:
-                break;
-        }
-
-        lookahead = this->peek_token();
-    }
-    return lop;
-}
-
-size_t Parser::parseShift() {
-    size_t lop = this->parseAdd();
-
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::LSHIFT ||
-        lookahead.type == TokenType::RSHIFT) {
-        this->consume();
-
-        size_t rop = this->parseAdd();
-
-        switch(lookahead.type) {
-            case TokenType::LSHIFT:
-                lop = this->ast.addNode(AstNodeType::LSHIFT_EXPR, {lop, rop});
-                break;
-            case TokenType::RSHIFT:
-                lop = this->ast.addNode(AstNodeType::RSHIFT_EXPR, {lop, rop});
-                break;
-            default:
-                break;
-        }
-
-        lookahead = this->peek_token();
-    }
-    return lop;
-}
-
-size_t Parser::parseRelational() {
-    size_t lop = this->parseShift();
-
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::LESS ||
-        lookahead.type == TokenType::GREATER ||
-        lookahead.type == TokenType::LESSEQ ||
-        lookahead.type == TokenType::GREATEREQ) {
-        this->consume();
-
-        size_t rop = this->parseShift();
-
-        switch(lookahead.type) {
-            case TokenType::LESS:
-                lop = this->ast.addNode(AstNodeType::LESS_EXPR, {lop, rop});
-                break;
-            case TokenType::GREATER:
-                lop = this->ast.addNode(AstNodeType::GREATER_EXPR, {lop, rop});
-                break;
-            case TokenType::LESSEQ:
-                lop = this->ast.addNode(AstNodeType::LESSEQ_EXPR, {lop, rop});
-                break;
-            case TokenType::GREATEREQ:
-                lop = this->ast.addNode(AstNodeType::GREATEREQ_EXPR, {lop, rop});
-                break;
-            default:
-                break;
-        }
-
-        lookahead = this->peek_token();
-    }
-    return lop;
-}
-
-size_t Parser::parseEquality() {
-    size_t lop = this->parseRelational();
-
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::EQUAL ||
-        lookahead.type == TokenType::NOTEQUAL) {
-        this->consume();
-
-        size_t rop = this->parseRelational();
-
-        switch(lookahead.type) {
-            case TokenType::EQUAL:
-                lop = this->ast.addNode(AstNodeType::EQUAL_EXPR, {lop, rop});
-                break;
-            case TokenType::NOTEQUAL:
-                lop = this->ast.addNode(AstNodeType::NOTEQUAL_EXPR, {lop, rop});
-                break;
-            default:
-                break;
-        }
-
-        lookahead = this->peek_token();
-    }
-    return lop;
-}
-
-size_t Parser::parseBitand() {
-    size_t lop = this->parseEquality();
-
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::BITAND) {
-        this->consume();
-
-        size_t rop = this->parseEquality();
-        lop = this->ast.addNode(AstNodeType::BITWISE_AND_EXPR, {lop, rop});
-
-        lookahead = this->peek_token();
-    }
-    return lop;
-}
-
-size_t Parser::parseBitxor() {
-    size_t lop = this->parseBitand();
-
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::XOR) {
-        this->consume();
-
-        size_t rop = this->parseBitand();
-        lop = this->ast.addNode(AstNodeType::BITWISE_XOR_EXPR, {lop, rop});
-
-        lookahead = this->peek_token();
-    }
-    return lop;
-}
-
-size_t Parser::parseBitor() {
-    size_t lop = this->parseBitxor();
-
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::BITOR) {
-        this->consume();
-
-        size_t rop = this->parseBitxor();
-        lop = this->ast.addNode(AstNodeType::BITWISE_OR_EXPR, {lop, rop});
-
-        lookahead = this->peek_token();
-    }
-    return lop;
-}
-
-size_t Parser::parseAnd() {
-    size_t lop = this->parseBitor();
-
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::AND) {
-        this->consume();
-
-        size_t rop = this->parseBitor();
-        lop = this->ast.addNode(AstNodeType::LOGICAL_AND_EXPR, {lop, rop});
-
-        lookahead = this->peek_token();
-    }
-    return lop;
-}
-
-size_t Parser::parseOr() {
-    size_t lop = this->parseAnd();
-
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::OR) {
-        this->consume();
-
-        size_t rop = this->parseAnd();
-        lop = this->ast.addNode(AstNodeType::LOGICAL_OR_EXPR, {lop, rop});
-
-        lookahead = this->peek_token();
+        lookahead = this->peek().type;
+        op = &BINARY_OPERATORS[size_t(lookahead)];
     }
     return lop;
 }
 
 size_t Parser::parseAssign() {
-    Token lookahead = this->peek_token();
+    TokenType lookahead = this->peek().type;
 
-    if(lookahead.type == TokenType::KEY_THROW) {
+    if(lookahead == TokenType::KEY_THROW) {
         this->consume();
 
-        lookahead = this->peek_token();
-        switch(lookahead.type) {
+        lookahead = this->peek().type;
+        switch(lookahead) {
             //TODO: add other expression initial tokens
+            case TokenType::ID:
             case TokenType::LITERAL_INTEGER:
             case TokenType::INCREMENT:
             case TokenType::DECREMENT:
@@ -447,10 +691,10 @@ size_t Parser::parseAssign() {
         }
     }
 
-    size_t lop = this->parseOr();
+    size_t lop = this->parseBinary(LOWEST_BINARY_POWER);
 
-    lookahead = this->peek_token();
-    switch(lookahead.type) {
+    lookahead = this->peek().type;
+    switch(lookahead) {
         case TokenType::ASSIGN:
             this->consume();
             lop = this->ast.addNode(AstNodeType::ASSIGN_EXPR, {lop, this->parseAssign()});
@@ -512,13 +756,13 @@ size_t Parser::parseAssign() {
 size_t Parser::parseComma() {
     size_t lop = this->parseAssign();
 
-    Token lookahead = this->peek_token();
-    while(lookahead.type == TokenType::COMMA) {
+    TokenType lookahead = this->peek().type;
+    while(lookahead == TokenType::COMMA) {
         this->consume();
 
         size_t rop = this->parseAssign();
         lop = this->ast.addNode(AstNodeType::COMMA_EXPR, {lop, rop});
-        lookahead = this->peek_token();
+        lookahead = this->peek().type;
     }
     return lop;
 }
@@ -538,14 +782,14 @@ size_t Parser::parseIf() {
     this->expect(TokenType::KEY_IF);
     this->expect(TokenType::OPEN_PAR);
 
-    size_t expr = this->parseExpr();
+    size_t expr = this->parseCondition();
 
     this->expect(TokenType::CLOSE_PAR);
 
     size_t stat = this->parseStatement();
 
-    Token lookahead = this->peek_token();
-    if(lookahead.type == TokenType::KEY_ELSE) {
+    TokenType lookahead = this->peek().type;
+    if(lookahead == TokenType::KEY_ELSE) {
         this->consume();
 
         size_t else_stat = this->parseStatement();
@@ -562,7 +806,7 @@ size_t Parser::parseSwitch() {
 
     this->expect(TokenType::KEY_SWITCH);
     this->expect(TokenType::OPEN_PAR);
-    size_t expr = this->parseExpr();
+    size_t expr = this->parseCondition();
     this->expect(TokenType::CLOSE_PAR);
 
     std::cout << "Parsed expression" << std::endl;
@@ -588,16 +832,16 @@ size_t Parser::parseDefault() {
     Token def_tok = this->expect(TokenType::KEY_DEFAULT);
     this->expect(TokenType::COLON);
 
+    size_t def_node = this->ast.addNode(AstNodeType::DEFAULT_LABEL);
     if(this->nearest_switch == INVALID_ASTNODE_ID) {
-        this->compile_info.diagnostics.error(def_tok.pos, "default outside of switch");
-        throw ParseException();
+        this->reportError(def_tok.pos, "default outside of switch");
+        return def_node;
     }
 
-    size_t def_node = this->ast.addNode(AstNodeType::DEFAULT_LABEL);
     SwitchAstNode& switch_node = (SwitchAstNode&)this->ast.getNode(this->nearest_switch);
     if(switch_node.default_id != INVALID_ASTNODE_ID) {
-        this->compile_info.diagnostics.error(def_tok.pos, "multiple default in switch");
-        throw ParseException();
+        this->reportError(def_tok.pos, "multiple default in switch");
+        return def_node;
     }
 
     switch_node.default_id = def_node;
@@ -608,13 +852,16 @@ size_t Parser::parseCase() {
     Token case_tok = this->expect(TokenType::KEY_CASE);
     size_t case_expr = this->parseExpr();
     this->expect(TokenType::COLON);
+    return this->addCaseLabel(case_tok.pos, case_expr);
+}
 
+size_t Parser::addCaseLabel(SourceLocation pos, size_t case_expr) {
+    size_t case_node = this->ast.addNode(AstNodeType::CASE_LABEL, {case_expr});
     if(this->nearest_switch == INVALID_ASTNODE_ID) {
-        this->compile_info.diagnostics.error(case_tok.pos, "case outside of switch");
-        throw ParseException();
+        this->reportError(pos, "case outside of switch");
+        return case_node;
     }
 
-    size_t case_node = this->ast.addNode(AstNodeType::CASE_LABEL, {case_expr});
     SwitchAstNode& switch_node = (SwitchAstNode&)this->ast.getNode(this->nearest_switch);
     switch_node.case_nodes.push_back(case_node);
 
@@ -623,8 +870,14 @@ size_t Parser::parseCase() {
 }
 
 size_t Parser::parseCondition() {
-    //TODO: allow declarations here
-    return this->parseExpr();
+    auto start = this->parseDeclarationStart(true);
+    if(!start)
+        return this->parseExpr();
+
+    this->expect(TokenType::ASSIGN);
+    size_t initializer = this->parseAssign();
+    size_t declarator = this->ast.addNode(AstNodeType::INIT_DECLARATOR, {start->declarator, initializer});
+    return this->ast.addNode(AstNodeType::SIMPLE_DECL, {start->specifiers, declarator});
 }
 
 size_t Parser::parseWhile() {
@@ -649,23 +902,198 @@ size_t Parser::parseDoWhile() {
     return this->ast.addNode(AstNodeType::DO_WHILE_STAT, {stat, cond});
 }
 
-size_t Parser::parseSimpleDecl() {
-    Token lookahead = this->peek_token();
-    switch(lookahead.type) {
-        case TokenType::SEMICOLON:
+uint64_t Parser::parseCvQualifiers() {
+    uint64_t qualifiers = 0;
+    for(;;) {
+        TokenType type = this->peek().type;
+        if(type != TokenType::KEY_CONST && type != TokenType::KEY_VOLATILE)
+            return qualifiers;
+        qualifiers |= DECL_SPECIFIERS[size_t(type)];
+        this->consume();
+    }
+}
+
+// An identifier is a type name if no type was given before it, otherwise it is the declarator.
+size_t Parser::parseDeclSpecifiers() {
+    uint64_t flags = 0;
+    TypeSpecifiers builtin = {TokenType::INVALID, 0, false, false, false};
+    bool has_builtin = false;
+    size_t type_name = INVALID_ASTNODE_ID;
+    SourceLocation pos = this->peek().pos;
+
+    for(;;) {
+        const Token& lookahead = this->peek();
+        uint64_t flag = DECL_SPECIFIERS[size_t(lookahead.type)];
+        if(flag != 0) {
+            if((flag & STORAGE_CLASSES) && (flags & STORAGE_CLASSES))
+                this->reportError(lookahead.pos, "multiple storage classes in declaration");
+            flags |= flag;
+        }
+        else if(isBuiltinTypeSpecifier(lookahead.type)) {
+            bool is_base = false;
+            switch(lookahead.type) {
+                case TokenType::KEY_SHORT:
+                    builtin.is_short = true;
+                    break;
+                case TokenType::KEY_LONG:
+                    ++builtin.longs;
+                    break;
+                case TokenType::KEY_SIGNED:
+                    builtin.is_signed = true;
+                    break;
+                case TokenType::KEY_UNSIGNED:
+                    builtin.is_unsigned = true;
+                    break;
+                default:
+                    is_base = true;
+                    break;
+            }
+            if(type_name != INVALID_ASTNODE_ID || (is_base && builtin.type != TokenType::INVALID))
+                this->reportError(lookahead.pos, "multiple types in declaration");
+            if(is_base)
+                builtin.type = lookahead.type;
+            has_builtin = true;
+        }
+        else if(lookahead.type == TokenType::ID && !has_builtin && type_name == INVALID_ASTNODE_ID) {
+            type_name = this->parseName(AstNodeType::TYPE_NAME);
+            continue;
+        }
+        else
+            break;
+        this->consume();
+    }
+
+    TypeId datatype = 0;
+    if(has_builtin) {
+        auto kind = primitiveType(builtin);
+        if(kind)
+            datatype = this->compile_info.types.getPrimitiveType(*kind);
+        else
+            this->reportError(pos, "invalid combination of type specifiers");
+    }
+    else if(type_name == INVALID_ASTNODE_ID)
+        this->reportError(pos, "declaration without a type");
+
+    size_t result = this->ast.addIntegerNode(AstNodeType::DECL_SPECIFIERS, datatype, flags);
+    if(type_name != INVALID_ASTNODE_ID)
+        this->ast.getNode(result).children.push_back(type_name);
+    return result;
+}
+
+size_t Parser::parseDeclarator() {
+    // Operators and opening parentheses before the name, innermost last. They are kept rather
+    // than parsed recursively, as deep input may only turn out not to be a declarator at the end.
+    struct Prefix {
+        TokenType type;
+        uint64_t qualifiers;
+    };
+    std::vector<Prefix> prefixes;
+    for(;;) {
+        TokenType type = this->peek().type;
+        if(type != TokenType::STAR && type != TokenType::BITAND && type != TokenType::OPEN_PAR)
+            break;
+        this->consume();
+        prefixes.push_back({type, type == TokenType::STAR ? this->parseCvQualifiers() : 0});
+    }
+
+    size_t result;
+    const Token& lookahead = this->peek();
+    if(lookahead.type == TokenType::ID)
+        result = this->parseName(AstNodeType::NAME_DECLARATOR);
+    else {
+        this->reportUnexpected(lookahead, {TokenType::ID});
+        result = this->ast.addNode(AstNodeType::ERROR_EXPR);
+    }
+
+    // Array bounds bind tighter than the operators before them
+    auto parseArrays = [&] {
+        while(this->peek().type == TokenType::OPEN_SB && !this->panicking) {
             this->consume();
-            return this->ast.addNode(AstNodeType::EMPTY_EXPR);
-        default:
-            this->throwError(lookahead, {
-                TokenType::SEMICOLON
-            });
+            size_t size = this->peek().type == TokenType::CLOSE_SB ? this->ast.addNode(AstNodeType::EMPTY_EXPR) : this->parseAssign();
+            this->expect(TokenType::CLOSE_SB);
+            result = this->ast.addNode(AstNodeType::ARRAY_DECLARATOR, {result, size});
+        }
+    };
+
+    parseArrays();
+    while(!prefixes.empty()) {
+        Prefix prefix = prefixes.back();
+        prefixes.pop_back();
+        switch(prefix.type) {
+            case TokenType::OPEN_PAR:
+                this->expect(TokenType::CLOSE_PAR);
+                parseArrays();
+                break;
+            case TokenType::STAR: {
+                size_t declarator = result;
+                result = this->ast.addIntegerNode(AstNodeType::POINTER_DECLARATOR, 0, prefix.qualifiers);
+                this->ast.getNode(result).children.push_back(declarator);
+                break;
+            }
+            default:
+                result = this->ast.addNode(AstNodeType::REFERENCE_DECLARATOR, {result});
+                break;
+        }
     }
+    return result;
+}
+
+// Starting with an identifier, the specifiers and first declarator are parsed tentatively. Where
+// both are possible, a declaration is what is parsed, and as names are not looked up, identifiers
+// are taken to name types whenever that makes the tokens a declaration.
+std::optional<Parser::DeclarationStart> Parser::parseDeclarationStart(bool condition) {
+    TokenType type = this->peek().type;
+    if(isDeclSpecifier(type)) {
+        size_t specifiers = this->parseDeclSpecifiers();
+        return DeclarationStart{specifiers, this->parseDeclarator()};
+    }
+    if(type != TokenType::ID || this->panicking)
+        return std::nullopt;
+
+    Checkpoint checkpoint = this->checkpoint();
+    size_t specifiers = this->parseDeclSpecifiers();
+    size_t declarator = this->parseDeclarator();
+
+    TokenType next = this->peek().type;
+    bool is_declaration = next == TokenType::ASSIGN || (!condition && (next == TokenType::SEMICOLON || next == TokenType::COMMA));
+    if(this->panicking || !is_declaration) {
+        this->rewind(checkpoint);
+        return std::nullopt;
+    }
+    this->commit();
+    return DeclarationStart{specifiers, declarator};
+}
+
+size_t Parser::parseSimpleDecl(const DeclarationStart& start) {
+    std::vector<size_t> children = {start.specifiers};
+    size_t declarator = start.declarator;
+    for(;;) {
+        if(this->peek().type == TokenType::ASSIGN) {
+            this->consume();
+            size_t initializer = this->parseAssign();
+            children.push_back(this->ast.addNode(AstNodeType::INIT_DECLARATOR, {declarator, initializer}));
+        }
+        else
+            children.push_back(this->ast.addNode(AstNodeType::INIT_DECLARATOR, {declarator}));
+
+        if(this->peek().type != TokenType::COMMA || this->panicking)
+            break;
+        this->consume();
+        declarator = this->parseDeclarator();
+    }
+
+    this->expect(TokenType::SEMICOLON);
+    return this->ast.addNode(AstNodeType::SIMPLE_DECL, children);
 }
 
 size_t Parser::parseForInit() {
-    Token lookahead = this->peek_token();
+    if(auto start = this->parseDeclarationStart(false))
+        return this->parseSimpleDecl(*start);
+
+    const Token& lookahead = this->peek();
     switch(lookahead.type) {
         //TODO: add other expression initial tokens
+        case TokenType::ID:
         case TokenType::LITERAL_INTEGER:
         case TokenType::INCREMENT:
         case TokenType::DECREMENT:
@@ -681,11 +1109,12 @@ size_t Parser::parseForInit() {
             return result;
             break;
         }
-        //TODO: add simple declaration initial tokens
         case TokenType::SEMICOLON:
-            return this->parseSimpleDecl();
+            this->consume();
+            return this->ast.addNode(AstNodeType::EMPTY_EXPR);
         default:
-            this->throwError(lookahead, {
+            this->reportUnexpected(lookahead, {
+                TokenType::ID,
                 TokenType::LITERAL_INTEGER,
                 TokenType::INCREMENT,
                 TokenType::DECREMENT,
@@ -698,6 +1127,7 @@ size_t Parser::parseForInit() {
                 TokenType::KEY_THROW,
                 TokenType::SEMICOLON
             });
+            return this->ast.addNode(AstNodeType::ERROR_EXPR);
     }
 }
 
@@ -706,17 +1136,17 @@ size_t Parser::parseFor() {
     this->expect(TokenType::OPEN_PAR);
     size_t for_init = this->parseForInit();
 
-    Token lookahead = this->peek_token();
+    TokenType lookahead = this->peek().type;
     size_t cond = INVALID_ASTNODE_ID;
-    if(lookahead.type != TokenType::SEMICOLON)
+    if(lookahead != TokenType::SEMICOLON)
         cond = this->parseCondition();
     else
         cond = this->ast.addNode(AstNodeType::EMPTY_EXPR);
     this->expect(TokenType::SEMICOLON);
 
-    lookahead = this->peek_token();
+    lookahead = this->peek().type;
     size_t incr = INVALID_ASTNODE_ID;
-    if(lookahead.type != TokenType::CLOSE_PAR)
+    if(lookahead != TokenType::CLOSE_PAR)
         incr = this->parseExpr();
     else
         incr = this->ast.addNode(AstNodeType::EMPTY_EXPR);
@@ -729,8 +1159,8 @@ size_t Parser::parseFor() {
 size_t Parser::parseReturn() {
     this->expect(TokenType::KEY_RETURN);
 
-    Token lookahead = this->peek_token();
-    if(lookahead.type == TokenType::SEMICOLON) {
+    TokenType lookahead = this->peek().type;
+    if(lookahead == TokenType::SEMICOLON) {
         this->consume();
         return this->ast.addNode(AstNodeType::RETURN_STAT);
     }
@@ -742,10 +1172,21 @@ size_t Parser::parseReturn() {
 }
 
 size_t Parser::parseStatement() {
-    Token lookahead = this->peek_token();
+    size_t result = this->panicking ? this->ast.addNode(AstNodeType::ERROR_STAT) : this->dispatchStatement();
+    if(this->panicking)
+        this->synchronize();
+    return result;
+}
+
+size_t Parser::dispatchStatement() {
+    if(auto start = this->parseDeclarationStart(false))
+        return this->parseSimpleDecl(*start);
+
+    const Token& lookahead = this->peek();
     //TODO: add lookahead for various other statement types
     switch(lookahead.type) {
         //TODO: add other expression initial tokens
+        case TokenType::ID:
         case TokenType::LITERAL_INTEGER:
         case TokenType::INCREMENT:
         case TokenType::DECREMENT:
@@ -790,80 +1231,577 @@ size_t Parser::parseStatement() {
         case TokenType::KEY_RETURN:
             return this->parseReturn();
         default:
-            this->throwError(lookahead, {
-                TokenType::LITERAL_INTEGER,
-                TokenType::INCREMENT,
-                TokenType::DECREMENT,
-                TokenType::OPEN_PAR,
-                TokenType::NOT,
-                TokenType::BITNOT,
-                TokenType::STAR,
-                TokenType::BITAND,
-                TokenType::KEY_SIZEOF,
-                TokenType::KEY_THROW,
-                TokenType::SEMICOLON,
-                TokenType::OPEN_CB,
-                TokenType::KEY_IF,
-                TokenType::KEY_SWITCH,
-                TokenType::KEY_DEFAULT,
-                TokenType::KEY_CASE,
-                TokenType::KEY_WHILE,
-                TokenType::KEY_DO,
-                TokenType::KEY_FOR,
-                TokenType::KEY_BREAK,
-                TokenType::KEY_CONTINUE,
-                TokenType::KEY_RETURN
-            });
+            this->reportUnexpected(lookahead, STATEMENT_STARTS);
+            return this->ast.addNode(AstNodeType::ERROR_STAT);
     }
 }
 
 size_t Parser::parseStatementList() {
-    Token lookahead = this->peek_token();
+    TokenType lookahead = this->peek().type;
     std::vector<size_t> children;
 
-    //TODO: update lookaheads to all possible statement starters
-    //TODO: add other expression initial tokens
-    while(lookahead.type == TokenType::LITERAL_INTEGER
-            || lookahead.type == TokenType::INCREMENT
-            || lookahead.type == TokenType::DECREMENT
-            || lookahead.type == TokenType::OPEN_PAR
-            || lookahead.type == TokenType::NOT
-            || lookahead.type == TokenType::BITNOT
-            || lookahead.type == TokenType::STAR
-            || lookahead.type == TokenType::BITAND
-            || lookahead.type == TokenType::KEY_SIZEOF
-            || lookahead.type == TokenType::KEY_THROW
-            || lookahead.type == TokenType::SEMICOLON
-            || lookahead.type == TokenType::OPEN_CB
-            || lookahead.type == TokenType::KEY_IF
-            || lookahead.type == TokenType::KEY_SWITCH
-            || lookahead.type == TokenType::KEY_DEFAULT
-            || lookahead.type == TokenType::KEY_CASE
-            || lookahead.type == TokenType::KEY_WHILE
-            || lookahead.type == TokenType::KEY_DO
-            || lookahead.type == TokenType::KEY_FOR
-            || lookahead.type == TokenType::KEY_BREAK
-            || lookahead.type == TokenType::KEY_CONTINUE
-            || lookahead.type == TokenType::KEY_RETURN) {
+    while(lookahead != TokenType::CLOSE_CB && lookahead != TokenType::EOI) {
         size_t sub_stat = this->parseStatement();
         children.push_back(sub_stat);
 
-        lookahead = this->peek_token();
+        lookahead = this->peek().type;
     }
     return this->ast.addNode(AstNodeType::STATEMENT_LIST, children);
 }
 
+size_t Parser::parseIteratively() {
+    std::vector<Frame> frames;
+    std::vector<size_t> operands;
+
+    auto push = [&](State state, AstNodeType node = AstNodeType::INVALID, size_t base = 0) -> Frame& {
+        return frames.emplace_back(Frame{state, 0, node, base, INVALID_ASTNODE_ID, {0}});
+    };
+    auto pop = [&]() {
+        size_t operand = operands.back();
+        operands.pop_back();
+        return operand;
+    };
+    auto popList = [&](size_t base) {
+        std::vector<size_t> elements(operands.begin() + base, operands.end());
+        operands.resize(base);
+        return elements;
+    };
+    // Most operands are a single identifier or integer, which is parsed here rather than through
+    // frames. Returns the state that parses the rest of the operand, if any.
+    auto parseOperand = [&]() -> std::optional<State> {
+        const Token& lookahead = this->peek();
+        if(lookahead.type == TokenType::ID)
+            operands.push_back(this->parseName(AstNodeType::IDENTIFIER_EXPR));
+        else if(lookahead.type == TokenType::LITERAL_INTEGER) {
+            operands.push_back(this->ast.addIntegerNode(AstNodeType::INTEGER_CONSTANT, lookahead.integer.type, lookahead.integer.value));
+            this->consume();
+        }
+        else
+            return State::PREFIX;
+
+        if(isPostfixStart(this->peek().type))
+            return State::POSTFIX_NEXT;
+        return std::nullopt;
+    };
+    // Takes the binary operators of at least the given power that follow the operand on top.
+    // Operators with operands parsed by parseOperand are taken in a loop, which continues with
+    // the power of the operator while the next one binds tighter.
+    auto parseBinaryNext = [&](uint8_t power) {
+        while(true) {
+            const BinaryOperator& op = BINARY_OPERATORS[size_t(this->peek().type)];
+            if(op.power < power)
+                break;
+            this->consume();
+
+            if(auto rest = parseOperand()) {
+                push(State::BINARY_END, op.node).power = power;
+                push(State::BINARY_NEXT).power = op.power + 1;
+                push(*rest);
+                break;
+            }
+            if(BINARY_OPERATORS[size_t(this->peek().type)].power > op.power) {
+                push(State::BINARY_END, op.node).power = power;
+                power = op.power + 1;
+            }
+            else {
+                size_t rop = pop();
+                size_t lop = pop();
+                operands.push_back(this->ast.addNode(op.node, {lop, rop}));
+            }
+        }
+    };
+    // Start an assignment expression or an expression right away, rather than pushing a frame
+    // that would be popped again at once
+    auto startAssign = [&]() {
+        if(this->peek().type == TokenType::KEY_THROW) {
+            this->consume();
+            if(isExpressionStart(this->peek().type)) {
+                push(State::THROW_END);
+                push(State::ASSIGN);
+            }
+            else
+                operands.push_back(this->ast.addNode(AstNodeType::RETHROW_EXPR, this->compile_info.types.getPrimitiveType(PrimitiveType::VOID)));
+            return;
+        }
+        push(State::ASSIGN_NEXT);
+        if(auto rest = parseOperand()) {
+            push(State::BINARY_NEXT).power = LOWEST_BINARY_POWER;
+            push(*rest);
+        }
+        else
+            parseBinaryNext(LOWEST_BINARY_POWER);
+    };
+    auto startExpr = [&]() {
+        push(State::COMMA_NEXT);
+        startAssign();
+    };
+
+    push(State::STATEMENT_LIST);
+    while(!frames.empty()) {
+        Frame frame = frames.back();
+        frames.pop_back();
+
+        switch(frame.state) {
+            case State::STATEMENT_LIST:
+                push(State::STATEMENT_LIST_NEXT, AstNodeType::INVALID, operands.size());
+                break;
+            case State::STATEMENT_LIST_NEXT: {
+                TokenType type = this->peek().type;
+                if(type != TokenType::CLOSE_CB && type != TokenType::EOI) {
+                    frames.push_back(frame);
+                    push(State::STATEMENT);
+                }
+                else
+                    operands.push_back(this->ast.addNode(AstNodeType::STATEMENT_LIST, popList(frame.base)));
+                break;
+            }
+            case State::STATEMENT: {
+                if(this->panicking) {
+                    operands.push_back(this->ast.addNode(AstNodeType::ERROR_STAT));
+                    this->synchronize();
+                    break;
+                }
+
+                push(State::STATEMENT_END);
+                if(auto start = this->parseDeclarationStart(false)) {
+                    operands.push_back(start->specifiers);
+                    push(State::DECLARATION_INITIALIZER, AstNodeType::INVALID, operands.size() - 1);
+                    operands.push_back(start->declarator);
+                    break;
+                }
+
+                const Token& lookahead = this->peek();
+                if(isExpressionStart(lookahead.type)) {
+                    push(State::EXPR_STAT_END);
+                    startExpr();
+                    break;
+                }
+
+                switch(lookahead.type) {
+                    case TokenType::SEMICOLON:
+                        this->consume();
+                        operands.push_back(this->ast.addNode(AstNodeType::EMPTY_STAT));
+                        break;
+                    case TokenType::OPEN_CB:
+                        this->consume();
+                        push(State::COMPOUND_END);
+                        push(State::STATEMENT_LIST);
+                        break;
+                    case TokenType::KEY_IF:
+                        this->consume();
+                        this->expect(TokenType::OPEN_PAR);
+                        push(State::IF_CONDITION);
+                        push(State::CONDITION);
+                        break;
+                    case TokenType::KEY_SWITCH: {
+                        size_t switch_stat = this->ast.addSwitchNode(AstNodeType::SWITCH_STAT);
+                        this->consume();
+                        this->expect(TokenType::OPEN_PAR);
+                        push(State::SWITCH_CONDITION, AstNodeType::INVALID, switch_stat);
+                        push(State::CONDITION);
+                        break;
+                    }
+                    case TokenType::KEY_DEFAULT:
+                        operands.push_back(this->parseDefault());
+                        break;
+                    case TokenType::KEY_CASE:
+                        push(State::CASE_END).pos = lookahead.pos;
+                        this->consume();
+                        startExpr();
+                        break;
+                    case TokenType::KEY_WHILE:
+                        this->consume();
+                        this->expect(TokenType::OPEN_PAR);
+                        push(State::WHILE_CONDITION);
+                        push(State::CONDITION);
+                        break;
+                    case TokenType::KEY_DO:
+                        this->consume();
+                        push(State::DO_BODY);
+                        push(State::STATEMENT);
+                        break;
+                    case TokenType::KEY_FOR:
+                        this->consume();
+                        this->expect(TokenType::OPEN_PAR);
+                        if(auto start = this->parseDeclarationStart(false)) {
+                            push(State::FOR_CONDITION);
+                            operands.push_back(start->specifiers);
+                            push(State::DECLARATION_INITIALIZER, AstNodeType::INVALID, operands.size() - 1);
+                            operands.push_back(start->declarator);
+                        }
+                        else if(isExpressionStart(this->peek().type)) {
+                            push(State::FOR_INIT_END);
+                            startExpr();
+                        }
+                        else {
+                            operands.push_back(this->parseForInit());
+                            push(State::FOR_CONDITION);
+                        }
+                        break;
+                    case TokenType::KEY_BREAK:
+                        this->consume();
+                        this->expect(TokenType::SEMICOLON);
+                        operands.push_back(this->ast.addNode(AstNodeType::BREAK_STAT));
+                        break;
+                    case TokenType::KEY_CONTINUE:
+                        this->consume();
+                        this->expect(TokenType::SEMICOLON);
+                        operands.push_back(this->ast.addNode(AstNodeType::CONTINUE_STAT));
+                        break;
+                    case TokenType::KEY_RETURN:
+                        this->consume();
+                        if(this->peek().type == TokenType::SEMICOLON) {
+                            this->consume();
+                            operands.push_back(this->ast.addNode(AstNodeType::RETURN_STAT));
+                        }
+                        else {
+                            push(State::RETURN_END);
+                            startExpr();
+                        }
+                        break;
+                    default:
+                        this->reportUnexpected(lookahead, STATEMENT_STARTS);
+                        operands.push_back(this->ast.addNode(AstNodeType::ERROR_STAT));
+                }
+                break;
+            }
+            case State::STATEMENT_END:
+                if(this->panicking)
+                    this->synchronize();
+                break;
+            case State::CONDITION:
+                if(auto start = this->parseDeclarationStart(true)) {
+                    operands.push_back(start->specifiers);
+                    operands.push_back(start->declarator);
+                    this->expect(TokenType::ASSIGN);
+                    push(State::CONDITION_END);
+                    startAssign();
+                }
+                else
+                    startExpr();
+                break;
+            case State::CONDITION_END: {
+                size_t initializer = pop();
+                size_t declarator = pop();
+                size_t specifiers = pop();
+                size_t init_declarator = this->ast.addNode(AstNodeType::INIT_DECLARATOR, {declarator, initializer});
+                operands.push_back(this->ast.addNode(AstNodeType::SIMPLE_DECL, {specifiers, init_declarator}));
+                break;
+            }
+            case State::DECLARATION_INITIALIZER:
+                if(this->peek().type == TokenType::ASSIGN) {
+                    this->consume();
+                    push(State::DECLARATION_INITIALIZER_END, AstNodeType::INVALID, frame.base);
+                    startAssign();
+                }
+                else {
+                    operands.push_back(this->ast.addNode(AstNodeType::INIT_DECLARATOR, {pop()}));
+                    push(State::DECLARATION_NEXT, AstNodeType::INVALID, frame.base);
+                }
+                break;
+            case State::DECLARATION_INITIALIZER_END: {
+                size_t initializer = pop();
+                size_t declarator = pop();
+                operands.push_back(this->ast.addNode(AstNodeType::INIT_DECLARATOR, {declarator, initializer}));
+                push(State::DECLARATION_NEXT, AstNodeType::INVALID, frame.base);
+                break;
+            }
+            case State::DECLARATION_NEXT:
+                if(this->peek().type == TokenType::COMMA && !this->panicking) {
+                    this->consume();
+                    operands.push_back(this->parseDeclarator());
+                    push(State::DECLARATION_INITIALIZER, AstNodeType::INVALID, frame.base);
+                }
+                else {
+                    this->expect(TokenType::SEMICOLON);
+                    operands.push_back(this->ast.addNode(AstNodeType::SIMPLE_DECL, popList(frame.base)));
+                }
+                break;
+            case State::EXPR_STAT_END:
+                this->expect(TokenType::SEMICOLON);
+                operands.push_back(this->ast.addNode(AstNodeType::EXPR_STAT, {pop()}));
+                break;
+            case State::COMPOUND_END:
+                this->expect(TokenType::CLOSE_CB);
+                break;
+            case State::IF_CONDITION:
+                this->expect(TokenType::CLOSE_PAR);
+                push(State::IF_BODY);
+                push(State::STATEMENT);
+                break;
+            case State::IF_BODY:
+                if(this->peek().type == TokenType::KEY_ELSE) {
+                    this->consume();
+                    push(State::IF_ELSE_BODY);
+                    push(State::STATEMENT);
+                }
+                else {
+                    size_t stat = pop();
+                    size_t expr = pop();
+                    operands.push_back(this->ast.addNode(AstNodeType::IF_STAT, {expr, stat}));
+                }
+                break;
+            case State::IF_ELSE_BODY: {
+                size_t else_stat = pop();
+                size_t stat = pop();
+                size_t expr = pop();
+                operands.push_back(this->ast.addNode(AstNodeType::IF_ELSE_STAT, {expr, stat, else_stat}));
+                break;
+            }
+            case State::SWITCH_CONDITION:
+                this->expect(TokenType::CLOSE_PAR);
+                push(State::SWITCH_BODY, AstNodeType::INVALID, frame.base).outer_switch = this->nearest_switch;
+                this->nearest_switch = frame.base;
+                push(State::STATEMENT);
+                break;
+            case State::SWITCH_BODY: {
+                size_t stat = pop();
+                size_t expr = pop();
+                AstNode& switch_node = this->ast.getNode(frame.base);
+                switch_node.children.push_back(expr);
+                switch_node.children.push_back(stat);
+                this->nearest_switch = frame.outer_switch;
+                operands.push_back(frame.base);
+                break;
+            }
+            case State::CASE_END:
+                this->expect(TokenType::COLON);
+                operands.push_back(this->addCaseLabel(frame.pos, pop()));
+                break;
+            case State::WHILE_CONDITION:
+                this->expect(TokenType::CLOSE_PAR);
+                push(State::WHILE_BODY);
+                push(State::STATEMENT);
+                break;
+            case State::WHILE_BODY: {
+                size_t stat = pop();
+                size_t cond = pop();
+                operands.push_back(this->ast.addNode(AstNodeType::WHILE_STAT, {cond, stat}));
+                break;
+            }
+            case State::DO_BODY:
+                this->expect(TokenType::KEY_WHILE);
+                this->expect(TokenType::OPEN_PAR);
+                push(State::DO_CONDITION);
+                startExpr();
+                break;
+            case State::DO_CONDITION: {
+                this->expect(TokenType::CLOSE_PAR);
+                size_t cond = pop();
+                size_t stat = pop();
+                operands.push_back(this->ast.addNode(AstNodeType::DO_WHILE_STAT, {stat, cond}));
+                break;
+            }
+            case State::FOR_INIT_END:
+                this->expect(TokenType::SEMICOLON);
+                push(State::FOR_CONDITION);
+                break;
+            case State::FOR_CONDITION:
+                push(State::FOR_CONDITION_END);
+                if(this->peek().type != TokenType::SEMICOLON)
+                    push(State::CONDITION);
+                else
+                    operands.push_back(this->ast.addNode(AstNodeType::EMPTY_EXPR));
+                break;
+            case State::FOR_CONDITION_END:
+                this->expect(TokenType::SEMICOLON);
+                push(State::FOR_INCREMENT_END);
+                if(this->peek().type != TokenType::CLOSE_PAR)
+                    startExpr();
+                else
+                    operands.push_back(this->ast.addNode(AstNodeType::EMPTY_EXPR));
+                break;
+            case State::FOR_INCREMENT_END:
+                this->expect(TokenType::CLOSE_PAR);
+                push(State::FOR_BODY);
+                push(State::STATEMENT);
+                break;
+            case State::FOR_BODY: {
+                size_t stat = pop();
+                size_t incr = pop();
+                size_t cond = pop();
+                size_t for_init = pop();
+                operands.push_back(this->ast.addNode(AstNodeType::FOR_STAT, {for_init, cond, incr, stat}));
+                break;
+            }
+            case State::RETURN_END:
+                this->expect(TokenType::SEMICOLON);
+                operands.push_back(this->ast.addNode(AstNodeType::RETURN_STAT, {pop()}));
+                break;
+
+            case State::COMMA_NEXT:
+                if(this->peek().type == TokenType::COMMA) {
+                    this->consume();
+                    push(State::COMMA_END);
+                    startAssign();
+                }
+                break;
+            case State::COMMA_END: {
+                size_t rop = pop();
+                size_t lop = pop();
+                operands.push_back(this->ast.addNode(AstNodeType::COMMA_EXPR, {lop, rop}));
+                push(State::COMMA_NEXT);
+                break;
+            }
+            case State::ASSIGN:
+                startAssign();
+                break;
+            case State::ASSIGN_NEXT: {
+                TokenType type = this->peek().type;
+                if(ASSIGNMENT_OPERATORS[size_t(type)] != AstNodeType::INVALID) {
+                    this->consume();
+                    push(State::ASSIGN_END, ASSIGNMENT_OPERATORS[size_t(type)]);
+                    startAssign();
+                }
+                else if(type == TokenType::QUESTION) {
+                    this->consume();
+                    push(State::TERNARY_MIDDLE);
+                    startExpr();
+                }
+                break;
+            }
+            case State::ASSIGN_END: {
+                size_t rop = pop();
+                size_t lop = pop();
+                operands.push_back(this->ast.addNode(frame.node, {lop, rop}));
+                break;
+            }
+            case State::TERNARY_MIDDLE:
+                this->expect(TokenType::COLON);
+                push(State::TERNARY_END);
+                startAssign();
+                break;
+            case State::TERNARY_END: {
+                size_t rop = pop();
+                size_t middle_op = pop();
+                size_t lop = pop();
+                operands.push_back(this->ast.addNode(AstNodeType::TERNARY_EXPR, {lop, middle_op, rop}));
+                break;
+            }
+            case State::THROW_END:
+                operands.push_back(this->ast.addNode(AstNodeType::THROW_EXPR, this->compile_info.types.getPrimitiveType(PrimitiveType::VOID), {pop()}));
+                break;
+            case State::BINARY_NEXT:
+                parseBinaryNext(frame.power);
+                break;
+            case State::BINARY_END: {
+                size_t rop = pop();
+                size_t lop = pop();
+                operands.push_back(this->ast.addNode(frame.node, {lop, rop}));
+                parseBinaryNext(frame.power);
+                break;
+            }
+            case State::PREFIX: {
+                const Token& lookahead = this->peek();
+                AstNodeType node = PREFIX_OPERATORS[size_t(lookahead.type)];
+                if(node != AstNodeType::INVALID) {
+                    this->consume();
+                    push(State::PREFIX_END, node);
+                    push(State::PREFIX);
+                    break;
+                }
+
+                switch(lookahead.type) {
+                    case TokenType::ID:
+                    case TokenType::LITERAL_INTEGER:
+                        if(auto rest = parseOperand())
+                            push(*rest);
+                        break;
+                    case TokenType::OPEN_PAR:
+                        this->consume();
+                        push(State::PAREN_END);
+                        startExpr();
+                        break;
+                    default:
+                        this->reportUnexpected(lookahead, {TokenType::LITERAL_INTEGER, TokenType::ID});
+                        operands.push_back(this->ast.addNode(AstNodeType::ERROR_EXPR));
+                        push(State::POSTFIX_NEXT);
+                }
+                break;
+            }
+            case State::PREFIX_END:
+                operands.push_back(this->ast.addNode(frame.node, {pop()}));
+                break;
+            case State::PAREN_END:
+                this->expect(TokenType::CLOSE_PAR);
+                if(isPostfixStart(this->peek().type))
+                    push(State::POSTFIX_NEXT);
+                break;
+            case State::POSTFIX_NEXT:
+                switch(this->peek().type) {
+                    case TokenType::INCREMENT:
+                        this->consume();
+                        operands.push_back(this->ast.addNode(AstNodeType::POSTFIX_INCREMENT_EXPR, {pop()}));
+                        push(State::POSTFIX_NEXT);
+                        break;
+                    case TokenType::DECREMENT:
+                        this->consume();
+                        operands.push_back(this->ast.addNode(AstNodeType::POSTFIX_DECREMENT_EXPR, {pop()}));
+                        push(State::POSTFIX_NEXT);
+                        break;
+                    case TokenType::OPEN_PAR:
+                        this->consume();
+                        push(State::CALL_ARGUMENT, AstNodeType::INVALID, operands.size() - 1);
+                        if(this->peek().type != TokenType::CLOSE_PAR && !this->panicking)
+                            startAssign();
+                        break;
+                    case TokenType::OPEN_SB:
+                        this->consume();
+                        push(State::SUBSCRIPT_END);
+                        startExpr();
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case State::SUBSCRIPT_END: {
+                size_t rop = pop();
+                size_t lop = pop();
+                operands.push_back(this->ast.addNode(AstNodeType::SUBSCRIPT_EXPR, {lop, rop}));
+                this->expect(TokenType::CLOSE_SB);
+                push(State::POSTFIX_NEXT);
+                break;
+            }
+            case State::CALL_ARGUMENT:
+                if(this->peek().type == TokenType::CLOSE_PAR || this->panicking) {
+                    this->expect(TokenType::CLOSE_PAR);
+                    operands.push_back(this->ast.addNode(AstNodeType::CALL_EXPR, popList(frame.base)));
+                    push(State::POSTFIX_NEXT);
+                }
+                else {
+                    this->expect(TokenType::COMMA);
+                    frames.push_back(frame);
+                    startAssign();
+                }
+                break;
+        }
+    }
+    return operands.back();
+}
+
+void Parser::setIterative(bool iterative) {
+    this->iterative = iterative;
+}
+
+void Parser::setMaxErrors(size_t max_errors) {
+    this->max_errors = max_errors;
+}
+
 size_t Parser::parse() {
     //TODO, change to actual root
-    try {
-        size_t result = this->parseStatementList();
+    size_t result = this->iterative ? this->parseIteratively() : this->parseStatementList();
 
-        Token lookahead = this->next_token();
-        if(lookahead.type != TokenType::EOI)
-            this->throwError(lookahead, {TokenType::EOI});
-        return result;
-    }
-    catch(const ParseException& p) {
-        return INVALID_ASTNODE_ID;
+    // Statements only end early at a closing brace without an opening one. It is skipped,
+    // and the statements after it are added to the others.
+    while(this->peek().type != TokenType::EOI) {
+        this->reportUnexpected(this->peek(), {TokenType::EOI});
+        this->consume();
+        this->panicking = false;
+
+        size_t rest = this->iterative ? this->parseIteratively() : this->parseStatementList();
+        const auto& rest_children = this->ast.getNode(rest).children;
+        auto& children = this->ast.getNode(result).children;
+        children.insert(children.end(), rest_children.begin(), rest_children.end());
     }
+    return result;
 }
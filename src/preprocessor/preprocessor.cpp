@@ -0,0 +1,1222 @@
+#include "preprocessor/preprocessor.hpp"
+#include "lexer/lexer.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <system_error>
+
+namespace {
+    bool isIdentifierLike(TokenType type) {
+        return type >= TokenType::KEY_ASM && type <= TokenType::ID;
+    }
+
+    // Whether there was whitespace between two tokens, as far as can be told from their text.
+    bool isAdjacent(const Token& first, const Token& second) {
+        return first.raw.data() + first.raw.size() == second.raw.data();
+    }
+
+    // Value of a preprocessor expression, which is computed in intmax_t or uintmax_t.
+    struct Value {
+        uint64_t bits;
+        bool is_unsigned;
+
+        bool isTrue() const {
+            return this->bits != 0;
+        }
+    };
+
+    // Evaluates the expression of an #if or #elif after macro expansion and defined.
+    // Errors in operands that are not evaluated, such as division by zero after a false &&,
+    // are not reported, like in the compiler proper.
+    class ConditionEvaluator {
+    private:
+        std::span<const Token> tokens;
+        size_t index;
+        CompileInfo& compile_info;
+        SourceLocation directive_loc;
+        bool failed;
+
+        const Token* peek() const {
+            return this->index < this->tokens.size() ? &this->tokens[this->index] : nullptr;
+        }
+
+        void error(std::string_view msg) {
+            if(this->failed)
+                return;
+            const Token* token = this->peek();
+            this->compile_info.diagnostics.error(token ? token->pos : this->directive_loc, msg);
+            this->failed = true;
+        }
+
+        static int precedence(TokenType type) {
+            switch(type) {
+                case TokenType::STAR:
+                case TokenType::DIV:
+                case TokenType::MOD:
+                    return 10;
+                case TokenType::PLUS:
+                case TokenType::MINUS:
+                    return 9;
+                case TokenType::LSHIFT:
+                case TokenType::RSHIFT:
+                    return 8;
+                case TokenType::LESS:
+                case TokenType::LESSEQ:
+                case TokenType::GREATER:
+                case TokenType::GREATEREQ:
+                    return 7;
+                case TokenType::EQUAL:
+                case TokenType::NOTEQUAL:
+                    return 6;
+                case TokenType::BITAND:
+                    return 5;
+                case TokenType::XOR:
+                    return 4;
+                case TokenType::BITOR:
+                    return 3;
+                case TokenType::AND:
+                    return 2;
+                case TokenType::OR:
+                    return 1;
+                default:
+                    return 0;
+            }
+        }
+
+        Value binary(TokenType op, Value lhs, Value rhs, bool evaluated) {
+            bool is_unsigned = lhs.is_unsigned || rhs.is_unsigned;
+            int64_t l = int64_t(lhs.bits);
+            int64_t r = int64_t(rhs.bits);
+            auto compare = [&](auto signed_less, auto unsigned_less) {
+                return Value{is_unsigned ? unsigned_less(lhs.bits, rhs.bits) : signed_less(l, r), false};
+            };
+
+            switch(op) {
+                case TokenType::STAR:
+                    return {lhs.bits * rhs.bits, is_unsigned};
+                case TokenType::DIV:
+                case TokenType::MOD:
+                    if(rhs.bits == 0) {
+                        if(evaluated)
+                            this->error("division by zero in #if");
+                        return {0, is_unsigned};
+                    }
+                    if(is_unsigned)
+                        return {op == TokenType::DIV ? lhs.bits / rhs.bits : lhs.bits % rhs.bits, true};
+                    if(l == std::numeric_limits<int64_t>::min() && r == -1)
+                        return {op == TokenType::DIV ? lhs.bits : 0, false};
+                    return {uint64_t(op == TokenType::DIV ? l / r : l % r), false};
+                case TokenType::PLUS:
+                    return {lhs.bits + rhs.bits, is_unsigned};
+                case TokenType::MINUS:
+                    return {lhs.bits - rhs.bits, is_unsigned};
+                case TokenType::LSHIFT:
+                    return {rhs.bits >= 64 ? 0 : lhs.bits << rhs.bits, lhs.is_unsigned};
+                case TokenType::RSHIFT:
+                    if(lhs.is_unsigned)
+                        return {rhs.bits >= 64 ? 0 : lhs.bits >> rhs.bits, true};
+                    return {uint64_t(l >> std::min<uint64_t>(rhs.bits, 63)), false};
+                case TokenType::LESS:
+                    return compare([](int64_t a, int64_t b) { return a < b; }, [](uint64_t a, uint64_t b) { return a < b; });
+                case TokenType::LESSEQ:
+                    return compare([](int64_t a, int64_t b) { return a <= b; }, [](uint64_t a, uint64_t b) { return a <= b; });
+                case TokenType::GREATER:
+                    return compare([](int64_t a, int64_t b) { return a > b; }, [](uint64_t a, uint64_t b) { return a > b; });
+                case TokenType::GREATEREQ:
+                    return compare([](int64_t a, int64_t b) { return a >= b; }, [](uint64_t a, uint64_t b) { return a >= b; });
+                case TokenType::EQUAL:
+                    return {lhs.bits == rhs.bits, false};
+                case TokenType::NOTEQUAL:
+                    return {lhs.bits != rhs.bits, false};
+                case TokenType::BITAND:
+                    return {lhs.bits & rhs.bits, is_unsigned};
+                case TokenType::XOR:
+                    return {lhs.bits ^ rhs.bits, is_unsigned};
+                case TokenType::BITOR:
+                    return {lhs.bits | rhs.bits, is_unsigned};
+                default:
+                    return {0, false};
+            }
+        }
+
+        Value parsePrimary(bool evaluated) {
+            const Token* token = this->peek();
+            if(!token) {
+                this->error("expected value in expression");
+                return {0, false};
+            }
+
+            ++this->index;
+            switch(token->type) {
+                case TokenType::LITERAL_INTEGER: {
+                    TypeTable& types = this->compile_info.types;
+                    bool is_unsigned = token->integer.type == types.getPrimitiveType(PrimitiveType::UNSIGNED_INT) ||
+                        token->integer.type == types.getPrimitiveType(PrimitiveType::UNSIGNED_LONG) ||
+                        token->integer.type == types.getPrimitiveType(PrimitiveType::UNSIGNED_LONG_LONG);
+                    return {token->integer.value, is_unsigned};
+                }
+                case TokenType::LITERAL_CHAR:
+                    return {token->char_literal, false};
+                case TokenType::KEY_TRUE:
+                    return {1, false};
+                case TokenType::OPEN_PAR: {
+                    Value result = this->parseConditional(evaluated);
+                    const Token* close = this->peek();
+                    if(!close || close->type != TokenType::CLOSE_PAR)
+                        this->error("missing ')' in expression");
+                    else
+                        ++this->index;
+                    return result;
+                }
+                case TokenType::PLUS:
+                    return this->parsePrimary(evaluated);
+                case TokenType::MINUS: {
+                    Value operand = this->parsePrimary(evaluated);
+                    return {0 - operand.bits, operand.is_unsigned};
+                }
+                case TokenType::BITNOT: {
+                    Value operand = this->parsePrimary(evaluated);
+                    return {~operand.bits, operand.is_unsigned};
+                }
+                case TokenType::NOT:
+                    return {!this->parsePrimary(evaluated).isTrue(), false};
+                case TokenType::LITERAL_FLOAT:
+                    --this->index;
+                    this->error("floating constant in preprocessor expression");
+                    return {0, false};
+                default:
+                    break;
+            }
+
+            if(!isIdentifierLike(token->type)) {
+                --this->index;
+                this->error("invalid token in preprocessor expression");
+                return {0, false};
+            }
+
+            // Identifiers left after expansion are 0. Feature checks such as __has_builtin that
+            // are not defined as macros are taken to find nothing.
+            const Token* open = this->peek();
+            if(token->raw.starts_with("__has_") && open && open->type == TokenType::OPEN_PAR) {
+                size_t depth = 0;
+                for(; this->index < this->tokens.size(); ++this->index) {
+                    TokenType type = this->tokens[this->index].type;
+                    depth += type == TokenType::OPEN_PAR;
+                    if(type == TokenType::CLOSE_PAR && --depth == 0) {
+                        ++this->index;
+                        break;
+                    }
+                }
+            }
+            return {0, false};
+        }
+
+        Value parseBinary(int min_precedence, bool evaluated) {
+            Value lhs = this->parsePrimary(evaluated);
+            while(const Token* op = this->peek()) {
+                int op_precedence = precedence(op->type);
+                if(op_precedence == 0 || op_precedence < min_precedence)
+                    break;
+                ++this->index;
+
+                if(op->type == TokenType::AND || op->type == TokenType::OR) {
+                    bool short_circuit = op->type == TokenType::AND ? !lhs.isTrue() : lhs.isTrue();
+                    Value rhs = this->parseBinary(op_precedence + 1, evaluated && !short_circuit);
+                    lhs = {op->type == TokenType::AND ? lhs.isTrue() && rhs.isTrue() : lhs.isTrue() || rhs.isTrue(), false};
+                }
+                else {
+                    Value rhs = this->parseBinary(op_precedence + 1, evaluated);
+                    lhs = this->binary(op->type, lhs, rhs, evaluated);
+                }
+            }
+            return lhs;
+        }
+
+        Value parseConditional(bool evaluated) {
+            Value condition = this->parseBinary(1, evaluated);
+            const Token* question = this->peek();
+            if(!question || question->type != TokenType::QUESTION)
+                return condition;
+            ++this->index;
+
+            Value if_true = this->parseConditional(evaluated && condition.isTrue());
+            const Token* colon = this->peek();
+            if(!colon || colon->type != TokenType::COLON) {
+                this->error("expected ':' in conditional expression");
+                return {0, false};
+            }
+            ++this->index;
+            Value if_false = this->parseConditional(evaluated && !condition.isTrue());
+
+            Value result = condition.isTrue() ? if_true : if_false;
+            result.is_unsigned = if_true.is_unsigned || if_false.is_unsigned;
+            return result;
+        }
+    public:
+        ConditionEvaluator(std::span<const Token> tokens, CompileInfo& compile_info, SourceLocation directive_loc) :
+            tokens(tokens), index(0), compile_info(compile_info), directive_loc(directive_loc), failed(false) {}
+
+        bool evaluate() {
+            if(this->tokens.empty()) {
+                this->error("#if with no expression");
+                return false;
+            }
+
+            Value result = this->parseConditional(true);
+            if(this->index < this->tokens.size())
+                this->error("missing binary operator in expression");
+            return !this->failed && result.isTrue();
+        }
+    };
+}
+
+Preprocessor::Preprocessor(CompileInfo& compile_info) :
+    compile_info(compile_info), num_disabled(0), depth(0) {
+    this->predefines =
+        "#define __cplusplus 202002L\n"
+        "#define __STDC_HOSTED__ 1\n"
+        "#define __quetzalcoatl__ 1\n";
+    this->addBuiltinMacro("__FILE__", Macro::FILE_NAME);
+    this->addBuiltinMacro("__LINE__", Macro::LINE_NUMBER);
+}
+
+void Preprocessor::addIncludePath(std::string_view path) {
+    this->include_paths.emplace_back(path);
+}
+
+void Preprocessor::define(std::string_view name, std::string_view value) {
+    this->predefines.append("#define ").append(name).append(" ").append(value).append("\n");
+}
+
+bool Preprocessor::open(const char* path) {
+    File* file = this->loadFile(path);
+    if(!file)
+        return false;
+    this->enterFile(file, {});
+
+    // Predefined macros are handled first, as if they were at the start of the main file.
+    auto& builtins = this->builtin_files.emplace_back(this->makeFile(SourceBuffer(this->predefines), "<built-in>"));
+    this->enterFile(builtins.get(), {});
+    return true;
+}
+
+Token Preprocessor::next() {
+    ExpandedToken result;
+    this->nextExpanded(result, 0);
+    return result.token;
+}
+
+Preprocessor::File* Preprocessor::loadFile(const std::string& path) {
+    std::error_code error;
+    std::string canonical = std::filesystem::canonical(path, error).string();
+    if(error)
+        return nullptr;
+
+    auto it = this->files.find(canonical);
+    if(it != this->files.end())
+        return it->second.get();
+
+    auto buffer = SourceBuffer::open(path.c_str());
+    if(!buffer)
+        return nullptr;
+    auto& file = this->files[canonical] = this->makeFile(std::move(*buffer), path);
+    return file.get();
+}
+
+// Lexes a whole file up front. Lexer diagnostics are held back until their token is reached,
+// as the lexer has no way to know which parts of the file are skipped.
+std::unique_ptr<Preprocessor::File> Preprocessor::makeFile(SourceBuffer&& buffer, std::string_view path) {
+    auto file = std::make_unique<File>(std::move(buffer), path);
+    BasicLexer<PreprocessorLexerPolicy> lexer(file->buffer, this->compile_info, file->path);
+    Diagnostics diagnostics;
+    lexer.setDiagnostics(diagnostics);
+
+    file->tokens.reserve(file->buffer.contents().size() / 4);
+    size_t num_reported = 0;
+    while(true) {
+        Token token = lexer.lex();
+        auto messages = diagnostics.messages();
+        for(; num_reported < messages.size(); ++num_reported)
+            file->diagnostics.emplace_back(file->tokens.size(), messages[num_reported]);
+
+        if(token.type == TokenType::DIRECTIVE)
+            file->directives.push_back(file->tokens.size());
+        file->tokens.push_back(token);
+        if(token.type == TokenType::EOI)
+            break;
+    }
+
+    this->detectGuard(*file);
+    return file;
+}
+
+// A file has an include guard if it consists of one #ifndef X or #if !defined X conditional
+// without #else or #elif. When X is defined, including the file again has no effect.
+void Preprocessor::detectGuard(File& file) {
+    const auto& tokens = file.tokens;
+    if(file.directives.empty() || file.directives[0] != 0)
+        return;
+
+    auto name = [&](size_t directive) {
+        return tokens[directive + 1].raw;
+    };
+
+    std::string_view guard;
+    size_t i = 1;
+    auto is = [&](TokenType type) {
+        return i < tokens.size() && tokens[i].type == type;
+    };
+
+    if(name(0) == "ifndef") {
+        i = 2;
+        if(!is(TokenType::ID))
+            return;
+        guard = tokens[i++].raw;
+    }
+    else if(name(0) == "if") {
+        i = 2;
+        if(!is(TokenType::NOT))
+            return;
+        ++i;
+        if(!is(TokenType::ID) || tokens[i].raw != "defined")
+            return;
+        ++i;
+        bool parenthesized = is(TokenType::OPEN_PAR);
+        i += parenthesized;
+        if(!is(TokenType::ID))
+            return;
+        guard = tokens[i++].raw;
+        if(parenthesized) {
+            if(!is(TokenType::CLOSE_PAR))
+                return;
+            ++i;
+        }
+    }
+    else
+        return;
+
+    if(!is(TokenType::END_OF_DIRECTIVE))
+        return;
+
+    size_t depth = 0;
+    for(size_t d = 1; d < file.directives.size(); ++d) {
+        std::string_view directive = name(file.directives[d]);
+        if(directive == "if" || directive == "ifdef" || directive == "ifndef")
+            ++depth;
+        else if(depth == 0 && (directive == "else" || directive == "elif"))
+            return;
+        else if(directive == "endif" && depth-- == 0) {
+            // Nothing but the rest of the #endif line may follow.
+            size_t end = file.directives[d];
+            while(tokens[end].type != TokenType::END_OF_DIRECTIVE && tokens[end].type != TokenType::EOI)
+                ++end;
+            if(tokens[end].type == TokenType::END_OF_DIRECTIVE && tokens[end + 1].type == TokenType::EOI)
+                file.guard = guard;
+            return;
+        }
+    }
+}
+
+std::optional<std::string> Preprocessor::findInclude(std::string_view name, bool angled) const {
+    namespace fs = std::filesystem;
+    std::error_code error;
+
+    if(fs::path(name).is_absolute())
+        return fs::is_regular_file(name, error) ? std::optional<std::string>(name) : std::nullopt;
+
+    if(!angled && !this->file_stack.empty()) {
+        fs::path candidate = fs::path(this->file_stack.back().file->path).parent_path() / name;
+        if(fs::is_regular_file(candidate, error))
+            return candidate.string();
+    }
+
+    for(const auto& dir : this->include_paths) {
+        fs::path candidate = fs::path(dir) / name;
+        if(fs::is_regular_file(candidate, error))
+            return candidate.string();
+    }
+    return std::nullopt;
+}
+
+// Finds the file of an include, caching where names were found from each directory.
+Preprocessor::File* Preprocessor::resolveInclude(std::string_view name, bool angled) {
+    std::string key;
+    if(!angled)
+        key = std::filesystem::path(this->file_stack.back().file->path).parent_path().string();
+    key.append(angled ? "<" : "\"").append(name);
+
+    auto it = this->include_cache.find(key);
+    if(it != this->include_cache.end())
+        return it->second;
+
+    auto path = this->findInclude(name, angled);
+    File* file = path ? this->loadFile(path.value()) : nullptr;
+    this->include_cache.emplace(std::move(key), file);
+    return file;
+}
+
+void Preprocessor::enterFile(File* file, SourceLocation loc) {
+    if(this->file_stack.size() >= MAX_INCLUDE_DEPTH) {
+        this->compile_info.diagnostics.error(loc, "#include nested too deeply");
+        return;
+    }
+
+    file->included = true;
+    this->file_stack.push_back({file, 0, 0, {}});
+}
+
+// Returns the token at the current position of a file and moves past it, reporting the
+// diagnostics of the lexer for it. The end of input token is never moved past.
+const Token& Preprocessor::takeToken(FileState& state) {
+    const File& file = *state.file;
+    size_t index = state.index;
+    while(state.next_diagnostic < file.diagnostics.size() && file.diagnostics[state.next_diagnostic].first <= index) {
+        const auto& [token_index, diagnostic] = file.diagnostics[state.next_diagnostic++];
+        if(token_index == index)
+            this->compile_info.diagnostics.add(diagnostic);
+    }
+
+    const Token& token = file.tokens[index];
+    if(token.type != TokenType::EOI)
+        ++state.index;
+    return token;
+}
+
+// Returns the tokens of the rest of a directive and moves past its end.
+std::span<const Token> Preprocessor::directiveLine(FileState& state) {
+    size_t begin = state.index;
+    while(this->takeToken(state).type != TokenType::END_OF_DIRECTIVE)
+        ;
+    return std::span<const Token>(state.file->tokens).subspan(begin, state.index - 1 - begin);
+}
+
+// Returns the next token of the current file that is not part of a directive, handling the
+// directives on the way. At the end of an included file, continues with the file including it.
+Token Preprocessor::readFileToken() {
+    while(true) {
+        FileState& state = this->file_stack.back();
+        const Token& token = this->takeToken(state);
+        if(token.type == TokenType::DIRECTIVE) {
+            this->handleDirective();
+            continue;
+        }
+
+        if(token.type == TokenType::EOI) {
+            for(const auto& conditional : state.conditionals)
+                this->compile_info.diagnostics.error(conditional.loc, "unterminated conditional directive");
+            state.conditionals.clear();
+
+            if(this->file_stack.size() > 1) {
+                this->file_stack.pop_back();
+                continue;
+            }
+        }
+        return token;
+    }
+}
+
+void Preprocessor::handleDirective() {
+    FileState& state = this->file_stack.back();
+    const Token& name_token = this->takeToken(state);
+    if(name_token.type == TokenType::END_OF_DIRECTIVE)
+        return;
+
+    std::string_view name = name_token.raw;
+    SourceLocation loc = name_token.pos;
+    std::span<const Token> line = this->directiveLine(state);
+
+    if(name == "include") {
+        this->handleInclude(line, loc);
+    }
+    else if(name == "define") {
+        this->handleDefine(line, loc);
+    }
+    else if(name == "undef") {
+        this->handleUndef(line, loc);
+    }
+    else if(name == "if" || name == "ifdef" || name == "ifndef") {
+        bool value;
+        if(name == "if")
+            value = this->evaluateCondition(line, loc);
+        else if(line.empty() || !isIdentifierLike(line[0].type)) {
+            this->compile_info.diagnostics.error(loc, "no macro name given in #" + std::string(name) + " directive");
+            value = false;
+        }
+        else {
+            this->checkEndOfDirective(line.subspan(1), name);
+            value = this->isDefined(line[0].raw) == (name == "ifdef");
+        }
+
+        state.conditionals.push_back({loc, value, false});
+        if(!value)
+            this->skipGroup(state);
+    }
+    else if(name == "elif" || name == "else") {
+        if(state.conditionals.empty()) {
+            this->compile_info.diagnostics.error(loc, "#" + std::string(name) + " without #if");
+            return;
+        }
+        Conditional& conditional = state.conditionals.back();
+        if(conditional.seen_else)
+            this->compile_info.diagnostics.error(loc, "#" + std::string(name) + " after #else");
+        if(name == "else") {
+            this->checkEndOfDirective(line, name);
+            conditional.seen_else = true;
+        }
+        // The group before was taken, so all that follow are skipped.
+        this->skipGroup(state);
+    }
+    else if(name == "endif") {
+        if(state.conditionals.empty()) {
+            this->compile_info.diagnostics.error(loc, "#endif without #if");
+            return;
+        }
+        this->checkEndOfDirective(line, name);
+        state.conditionals.pop_back();
+    }
+    else if(name == "pragma") {
+        this->handlePragma(line);
+    }
+    else if(name == "error" || name == "warning") {
+        std::string_view msg;
+        if(!line.empty())
+            msg = std::string_view(line.front().raw.data(), line.back().raw.data() + line.back().raw.size());
+        std::string text = "#" + std::string(name) + " " + std::string(msg);
+        if(name == "error")
+            this->compile_info.diagnostics.error(loc, text);
+        else
+            this->compile_info.diagnostics.warning(loc, text);
+    }
+    else {
+        this->compile_info.diagnostics.error(loc, "invalid preprocessing directive #" + std::string(name));
+    }
+}
+
+void Preprocessor::checkEndOfDirective(std::span<const Token> rest, std::string_view directive) {
+    if(!rest.empty())
+        this->compile_info.diagnostics.warning(rest[0].pos, "extra tokens at end of #" + std::string(directive) + " directive");
+}
+
+void Preprocessor::handleInclude(std::span<const Token> line, SourceLocation loc) {
+    // A header name is either a string literal or everything between < and >, with the spelling
+    // it has in the source. If it is neither, the line is macro expanded first.
+    std::vector<ExpandedToken> expanded;
+    std::vector<Token> expanded_line;
+    if(!line.empty() && line[0].type != TokenType::LITERAL_STRING && line[0].type != TokenType::LESS) {
+        std::vector<ExpandedToken> input;
+        for(const Token& token : line)
+            input.push_back({token, false});
+        this->expandTokens(input, expanded);
+        for(const auto& token : expanded)
+            expanded_line.push_back(token.token);
+        line = expanded_line;
+    }
+
+    std::string name;
+    bool angled = false;
+    if(!line.empty() && line[0].type == TokenType::LITERAL_STRING && line[0].raw.size() >= 2 && line[0].raw[0] == '"') {
+        name = line[0].raw.substr(1, line[0].raw.size() - 2);
+        this->checkEndOfDirective(line.subspan(1), "include");
+    }
+    else if(!line.empty() && line[0].type == TokenType::LESS) {
+        auto close = std::find_if(line.begin(), line.end(), [](const Token& token) { return token.type == TokenType::GREATER; });
+        if(close == line.end()) {
+            this->compile_info.diagnostics.error(loc, "missing terminating > character");
+            return;
+        }
+        // Tokens from a single line of the source are contiguous, those of an expansion may not be.
+        for(auto it = line.begin() + 1; it != close; ++it) {
+            if(it != line.begin() + 1 && !isAdjacent(*(it - 1), *it) && it->raw.data() > (it - 1)->raw.data())
+                name.append(std::string_view((it - 1)->raw.data() + (it - 1)->raw.size(), it->raw.data()));
+            name.append(it->raw);
+        }
+        angled = true;
+        this->checkEndOfDirective(std::span<const Token>(close + 1, line.end()), "include");
+    }
+    else {
+        this->compile_info.diagnostics.error(loc, "#include expects \"FILENAME\" or <FILENAME>");
+        return;
+    }
+
+    File* file = this->resolveInclude(name, angled);
+    if(!file) {
+        this->compile_info.diagnostics.error(loc, name + ": no such file");
+        return;
+    }
+
+    // Once a guarded file has been included, including it again has no effect.
+    if(file->included && (file->once || (!file->guard.empty() && this->isDefined(file->guard))))
+        return;
+    this->enterFile(file, loc);
+}
+
+void Preprocessor::handleDefine(std::span<const Token> line, SourceLocation loc) {
+    if(line.empty() || !isIdentifierLike(line[0].type)) {
+        this->compile_info.diagnostics.error(loc, "macro names must be identifiers");
+        return;
+    }
+    const Token& name = line[0];
+    if(name.raw == "defined") {
+        this->compile_info.diagnostics.error(name.pos, "\"defined\" cannot be used as a macro name");
+        return;
+    }
+
+    Macro macro = {Macro::OBJECT, false, false, uint32_t(this->macro_params.size()), 0, uint32_t(this->macro_tokens.size()), 0};
+    size_t i = 1;
+
+    // A macro is function-like if the parenthesis directly follows its name.
+    if(i < line.size() && line[i].type == TokenType::OPEN_PAR && isAdjacent(name, line[i])) {
+        macro.kind = Macro::FUNCTION;
+        ++i;
+        auto fail = [&](std::string_view msg) {
+            this->compile_info.diagnostics.error(i < line.size() ? line[i].pos : loc, msg);
+            this->macro_params.resize(macro.first_param);
+        };
+        auto isEllipsis = [&](size_t at) {
+            return at + 2 < line.size() && line[at].type == TokenType::DOT &&
+                line[at + 1].type == TokenType::DOT && line[at + 2].type == TokenType::DOT;
+        };
+
+        bool expect_param = false;
+        while(true) {
+            if(i < line.size() && line[i].type == TokenType::CLOSE_PAR && !expect_param)
+                break;
+            if(isEllipsis(i)) {
+                macro.variadic = true;
+                this->macro_params.push_back("__VA_ARGS__");
+                i += 3;
+            }
+            else if(i < line.size() && isIdentifierLike(line[i].type)) {
+                this->macro_params.push_back(line[i].raw);
+                ++i;
+                // GNU named variadic parameter
+                if(isEllipsis(i)) {
+                    macro.variadic = true;
+                    i += 3;
+                }
+            }
+            else
+                return fail("expected parameter name");
+
+            if(i < line.size() && line[i].type == TokenType::COMMA && !macro.variadic) {
+                ++i;
+                expect_param = true;
+                continue;
+            }
+            if(i >= line.size() || line[i].type != TokenType::CLOSE_PAR)
+                return fail("missing ')' in macro parameter list");
+            break;
+        }
+        ++i;
+        macro.num_params = this->macro_params.size() - macro.first_param;
+    }
+
+    std::span<const std::string_view> params(this->macro_params.data() + macro.first_param, macro.num_params);
+    std::span<const Token> body = line.subspan(i);
+    if(!body.empty() && (body.front().type == TokenType::HASH_HASH || body.back().type == TokenType::HASH_HASH)) {
+        this->compile_info.diagnostics.error(body.front().type == TokenType::HASH_HASH ? body.front().pos : body.back().pos,
+            "'##' cannot appear at either end of a macro expansion");
+        this->macro_params.resize(macro.first_param);
+        return;
+    }
+
+    for(size_t j = 0; j < body.size(); ++j) {
+        const Token& token = body[j];
+        uint32_t param = NO_PARAM;
+        if(isIdentifierLike(token.type)) {
+            auto it = std::find(params.begin(), params.end(), token.raw);
+            if(it != params.end())
+                param = it - params.begin();
+        }
+        if(macro.kind == Macro::FUNCTION && token.type == TokenType::HASH) {
+            const Token* next = j + 1 < body.size() ? &body[j + 1] : nullptr;
+            if(!next || std::find(params.begin(), params.end(), next->raw) == params.end() || !isIdentifierLike(next->type)) {
+                this->compile_info.diagnostics.error(token.pos, "'#' is not followed by a macro parameter");
+                this->macro_params.resize(macro.first_param);
+                this->macro_tokens.resize(macro.first_token);
+                return;
+            }
+        }
+        this->macro_tokens.push_back({token, param});
+    }
+    macro.num_tokens = this->macro_tokens.size() - macro.first_token;
+
+    size_t existing = this->findMacro(name.raw);
+    if(existing != NO_MACRO) {
+        const Macro& old = this->macros[existing];
+        bool same = old.kind == macro.kind && old.variadic == macro.variadic &&
+            old.num_params == macro.num_params && old.num_tokens == macro.num_tokens;
+        for(size_t j = 0; same && j < macro.num_params; ++j)
+            same = this->macro_params[old.first_param + j] == this->macro_params[macro.first_param + j];
+        for(size_t j = 0; same && j < macro.num_tokens; ++j)
+            same = this->macro_tokens[old.first_token + j].token.raw == this->macro_tokens[macro.first_token + j].token.raw;
+
+        if(!same)
+            this->compile_info.diagnostics.warning(name.pos, "\"" + std::string(name.raw) + "\" redefined");
+        this->macros[existing] = macro;
+        return;
+    }
+
+    this->macro_lookup.emplace(name.raw, this->macros.size());
+    this->macros.push_back(macro);
+}
+
+void Preprocessor::handleUndef(std::span<const Token> line, SourceLocation loc) {
+    if(line.empty() || !isIdentifierLike(line[0].type)) {
+        this->compile_info.diagnostics.error(loc, "no macro name given in #undef directive");
+        return;
+    }
+    this->checkEndOfDirective(line.subspan(1), "undef");
+    // The macro itself stays in place, as a context may still refer to it.
+    this->macro_lookup.erase(line[0].raw);
+}
+
+void Preprocessor::handlePragma(std::span<const Token> line) {
+    // Other pragmas have no meaning to the compiler yet.
+    if(!line.empty() && line[0].raw == "once")
+        this->file_stack.back().file->once = true;
+}
+
+// Skips the rest of a group of a conditional, up to the next group that is taken or the end of
+// the conditional. Only the directives of the file need to be looked at.
+void Preprocessor::skipGroup(FileState& state) {
+    const File& file = *state.file;
+    size_t depth = 0;
+    auto it = std::lower_bound(file.directives.begin(), file.directives.end(), state.index);
+
+    for(; it != file.directives.end(); ++it) {
+        state.index = *it + 1;
+        const Token& name_token = file.tokens[state.index];
+        std::string_view name = name_token.raw;
+        if(name_token.type == TokenType::END_OF_DIRECTIVE)
+            continue;
+
+        if(name == "if" || name == "ifdef" || name == "ifndef") {
+            ++depth;
+            continue;
+        }
+        if(depth > 0) {
+            depth -= name == "endif";
+            continue;
+        }
+
+        Conditional& conditional = state.conditionals.back();
+        if(name == "endif") {
+            ++state.index;
+            this->directiveLine(state);
+            state.conditionals.pop_back();
+            return;
+        }
+        if(name == "else") {
+            ++state.index;
+            if(conditional.seen_else)
+                this->compile_info.diagnostics.error(name_token.pos, "#else after #else");
+            this->directiveLine(state);
+            conditional.seen_else = true;
+            if(!conditional.taken) {
+                conditional.taken = true;
+                return;
+            }
+        }
+        else if(name == "elif") {
+            ++state.index;
+            if(conditional.seen_else)
+                this->compile_info.diagnostics.error(name_token.pos, "#elif after #else");
+            std::span<const Token> line = this->directiveLine(state);
+            if(!conditional.taken && this->evaluateCondition(line, name_token.pos)) {
+                conditional.taken = true;
+                return;
+            }
+        }
+    }
+
+    // Unterminated, which is reported at the end of the file.
+    state.index = file.tokens.size() - 1;
+}
+
+bool Preprocessor::evaluateCondition(std::span<const Token> line, SourceLocation loc) {
+    // defined and __has_include are handled before macro expansion.
+    std::vector<ExpandedToken> input;
+    std::vector<ExpandedToken> expanded;
+    auto makeInteger = [&](const Token& at, bool value) {
+        Token result = at;
+        result.type = TokenType::LITERAL_INTEGER;
+        result.integer.type = this->compile_info.types.getPrimitiveType(PrimitiveType::INT);
+        result.integer.value = value;
+        result.raw = value ? "1" : "0";
+        return ExpandedToken{result, true};
+    };
+
+    for(size_t i = 0; i < line.size(); ++i) {
+        const Token& token = line[i];
+        bool is_defined = token.raw == "defined";
+        bool is_has_include = token.raw == "__has_include";
+        if(!isIdentifierLike(token.type) || (!is_defined && !is_has_include)) {
+            input.push_back({token, false});
+            continue;
+        }
+
+        size_t j = i + 1;
+        bool parenthesized = j < line.size() && line[j].type == TokenType::OPEN_PAR;
+        j += parenthesized;
+
+        if(is_defined) {
+            if(j >= line.size() || !isIdentifierLike(line[j].type)) {
+                this->compile_info.diagnostics.error(token.pos, "macro name missing after defined");
+                return false;
+            }
+            bool value = this->isDefined(line[j].raw);
+            if(parenthesized && (++j >= line.size() || line[j].type != TokenType::CLOSE_PAR)) {
+                this->compile_info.diagnostics.error(token.pos, "missing ')' after defined");
+                return false;
+            }
+            input.push_back(makeInteger(token, value));
+            i = j;
+            continue;
+        }
+
+        // __has_include("name") or __has_include(<name>)
+        std::optional<std::string> name;
+        bool angled = false;
+        if(parenthesized && j < line.size() && line[j].type == TokenType::LITERAL_STRING && line[j].raw.size() >= 2) {
+            name = std::string(line[j].raw.substr(1, line[j].raw.size() - 2));
+        }
+        else if(parenthesized && j < line.size() && line[j].type == TokenType::LESS) {
+            size_t close = j;
+            while(close < line.size() && line[close].type != TokenType::GREATER)
+                ++close;
+            if(close < line.size()) {
+                name = std::string(line[j].raw.data() + 1, line[close].raw.data());
+                angled = true;
+                j = close;
+            }
+        }
+        if(!name || ++j >= line.size() || line[j].type != TokenType::CLOSE_PAR) {
+            this->compile_info.diagnostics.error(token.pos, "invalid argument to __has_include");
+            return false;
+        }
+        input.push_back(makeInteger(token, this->findInclude(name.value(), angled).has_value()));
+        i = j;
+    }
+
+    this->expandTokens(input, expanded);
+    std::vector<Token> tokens;
+    tokens.reserve(expanded.size());
+    for(const auto& token : expanded)
+        tokens.push_back(token.token);
+    return ConditionEvaluator(tokens, this->compile_info, loc).evaluate();
+}
+
+size_t Preprocessor::findMacro(std::string_view name) const {
+    auto it = this->macro_lookup.find(name);
+    return it == this->macro_lookup.end() ? NO_MACRO : it->second;
+}
+
+bool Preprocessor::isDefined(std::string_view name) const {
+    return this->macro_lookup.find(name) != this->macro_lookup.end();
+}
+
+void Preprocessor::addBuiltinMacro(std::string_view name, Macro::Kind kind) {
+    this->macro_lookup.emplace(name, this->macros.size());
+    this->macros.push_back({kind, false, false, 0, 0, 0, 0});
+}
+
+Preprocessor::Context& Preprocessor::pushContext(size_t macro) {
+    if(this->depth == this->contexts.size())
+        this->contexts.emplace_back();
+    Context& context = this->contexts[this->depth++];
+    context.tokens.clear();
+    context.index = 0;
+    context.macro = macro;
+    if(macro != NO_MACRO) {
+        this->macros[macro].disabled = true;
+        ++this->num_disabled;
+    }
+    return context;
+}
+
+void Preprocessor::popContext() {
+    size_t macro = this->contexts[--this->depth].macro;
+    if(macro != NO_MACRO) {
+        this->macros[macro].disabled = false;
+        --this->num_disabled;
+    }
+}
+
+void Preprocessor::pushBack(const ExpandedToken& token) {
+    this->pushContext(NO_MACRO).tokens.push_back(token);
+}
+
+// Reads the next token without expanding it. A floor of 0 reads everything including the file,
+// otherwise only the contexts at a depth of at least `floor` are read. Returns false if there is
+// nothing left to read.
+bool Preprocessor::read(ExpandedToken& result, size_t floor) {
+    while(this->depth > 0 && this->depth >= floor) {
+        Context& context = this->contexts[this->depth - 1];
+        if(context.index < context.tokens.size()) {
+            result = context.tokens[context.index++];
+            if(this->num_disabled > 0 && !result.no_expand && isIdentifierLike(result.token.type)) {
+                size_t macro = this->findMacro(result.token.raw);
+                result.no_expand = macro != NO_MACRO && this->macros[macro].disabled;
+            }
+            return true;
+        }
+        this->popContext();
+    }
+
+    if(floor > 0)
+        return false;
+    result = {this->readFileToken(), false};
+    return true;
+}
+
+bool Preprocessor::nextExpanded(ExpandedToken& result, size_t floor) {
+    while(this->read(result, floor)) {
+        if(result.no_expand || !isIdentifierLike(result.token.type))
+            return true;
+
+        size_t macro = this->findMacro(result.token.raw);
+        if(macro == NO_MACRO)
+            return true;
+        if(this->macros[macro].disabled) {
+            result.no_expand = true;
+            return true;
+        }
+        if(!this->expand(macro, result, floor))
+            return true;
+    }
+    return false;
+}
+
+// Pushes the expansion of a macro, to be read next. Returns false if the macro is not expanded
+// after all, because a function-like macro is not followed by arguments.
+bool Preprocessor::expand(size_t macro_index, const ExpandedToken& name, size_t floor) {
+    Macro macro = this->macros[macro_index];
+    std::vector<ExpandedToken> result;
+
+    switch(macro.kind) {
+        case Macro::FILE_NAME:
+        case Macro::LINE_NUMBER: {
+            ResolvedLocation loc = this->compile_info.sources.resolve(name.token.pos);
+            Token token = name.token;
+            if(macro.kind == Macro::LINE_NUMBER) {
+                std::string& spelling = this->scratch_spellings.emplace_back(std::to_string(loc.line));
+                token.type = TokenType::LITERAL_INTEGER;
+                token.integer.type = this->compile_info.types.getPrimitiveType(PrimitiveType::INT);
+                token.integer.value = loc.line;
+                token.raw = spelling;
+            }
+            else {
+                std::string_view file = this->compile_info.files.getFile(loc.file_id);
+                std::string& spelling = this->scratch_spellings.emplace_back("\"" + std::string(file) + "\"");
+                token.type = TokenType::LITERAL_STRING;
+                token.string_literal = this->compile_info.strings.add(StringTable::View(reinterpret_cast<const uint8_t*>(file.data()), file.size()));
+                token.raw = spelling;
+            }
+            this->pushContext(NO_MACRO).tokens.push_back({token, false});
+            return true;
+        }
+        case Macro::OBJECT: {
+            std::vector<std::vector<ExpandedToken>> no_args;
+            this->substitute(macro, name.token, no_args, result);
+            break;
+        }
+        case Macro::FUNCTION: {
+            ExpandedToken open;
+            if(!this->read(open, floor))
+                return false;
+            if(open.token.type != TokenType::OPEN_PAR) {
+                this->pushBack(open);
+                return false;
+            }
+
+            std::vector<std::vector<ExpandedToken>> args;
+            if(!this->collectArguments(macro, name.token, floor, args))
+                return true;
+            this->substitute(macro, name.token, args, result);
+            break;
+        }
+    }
+
+    Context& context = this->pushContext(macro_index);
+    context.tokens = std::move(result);
+    return true;
+}
+
+bool Preprocessor::collectArguments(const Macro& macro, const Token& name, size_t floor, std::vector<std::vector<ExpandedToken>>& args) {
+    args.emplace_back();
+    size_t depth = 0;
+    while(true) {
+        ExpandedToken token;
+        if(!this->read(token, floor) || token.token.type == TokenType::EOI) {
+            this->compile_info.diagnostics.error(name.pos, "unterminated argument list invoking macro \"" + std::string(name.raw) + "\"");
+            if(token.token.type == TokenType::EOI)
+                this->pushBack(token);
+            return false;
+        }
+
+        TokenType type = token.token.type;
+        if(type == TokenType::OPEN_PAR)
+            ++depth;
+        else if(type == TokenType::CLOSE_PAR && depth-- == 0)
+            break;
+        else if(type == TokenType::COMMA && depth == 0 && !(macro.variadic && args.size() == macro.num_params)) {
+            args.emplace_back();
+            continue;
+        }
+        args.back().push_back(token);
+    }
+
+    if(macro.num_params == 0 && args.size() == 1 && args[0].empty())
+        args.clear();
+    // The variadic arguments may be left out entirely
+    if(macro.variadic && args.size() == macro.num_params - 1)
+        args.emplace_back();
+
+    if(args.size() != macro.num_params) {
+        this->compile_info.diagnostics.error(name.pos, "macro \"" + std::string(name.raw) + "\" requires " +
+            std::to_string(macro.num_params) + " arguments, but " + std::to_string(args.size()) + " given");
+        return false;
+    }
+    return true;
+}
+
+// Replaces the parameters in the body of a macro by their arguments, handling # and ##.
+// Tokens of the body get the location of the macro name, so errors point at the use of the macro.
+void Preprocessor::substitute(const Macro& macro, const Token& name, std::vector<std::vector<ExpandedToken>>& args, std::vector<ExpandedToken>& result) {
+    std::span<const MacroToken> body(this->macro_tokens.data() + macro.first_token, macro.num_tokens);
+    std::vector<std::optional<std::vector<ExpandedToken>>> expanded_args(args.size());
+
+    auto bodyToken = [&](const MacroToken& token) {
+        ExpandedToken result{token.token, false};
+        result.token.pos = name.pos;
+        return result;
+    };
+
+    // The tokens that a body token stands for, without expanding arguments.
+    std::vector<ExpandedToken> single;
+    auto operand = [&](size_t& i) -> std::span<const ExpandedToken> {
+        if(body[i].param != NO_PARAM)
+            return args[body[i].param];
+        single.clear();
+        if(macro.kind == Macro::FUNCTION && body[i].token.type == TokenType::HASH) {
+            ++i;
+            single.push_back({this->stringize(args[body[i].param], name.pos), false});
+        }
+        else
+            single.push_back(bodyToken(body[i]));
+        return single;
+    };
+
+    for(size_t i = 0; i < body.size(); ++i) {
+        const MacroToken& token = body[i];
+        bool pasted = i + 1 < body.size() && body[i + 1].token.type == TokenType::HASH_HASH;
+
+        if(token.token.type == TokenType::HASH_HASH) {
+            ++i;
+            // GNU extension: , ## __VA_ARGS__ drops the comma if there are no variadic arguments.
+            bool va_args = macro.variadic && body[i].param == macro.num_params - 1;
+            if(va_args && !result.empty() && result.back().token.type == TokenType::COMMA && body[i - 2].token.type == TokenType::COMMA) {
+                if(args[body[i].param].empty())
+                    result.pop_back();
+                else
+                    result.insert(result.end(), args[body[i].param].begin(), args[body[i].param].end());
+                continue;
+            }
+            this->paste(result, operand(i), name.pos);
+            continue;
+        }
+
+        if(token.param == NO_PARAM || pasted) {
+            std::span<const ExpandedToken> tokens = operand(i);
+            // An empty operand of ## leaves a placemarker, which only matters for what it is pasted with.
+            if(tokens.empty() && pasted) {
+                ++i;
+                std::span<const ExpandedToken> rhs = operand(++i);
+                result.insert(result.end(), rhs.begin(), rhs.end());
+                continue;
+            }
+            result.insert(result.end(), tokens.begin(), tokens.end());
+            continue;
+        }
+
+        auto& expanded = expanded_args[token.param];
+        if(!expanded) {
+            expanded.emplace();
+            this->expandTokens(args[token.param], expanded.value());
+        }
+        result.insert(result.end(), expanded->begin(), expanded->end());
+    }
+}
+
+// Fully macro expands a list of tokens on its own, as is done for arguments and #if lines.
+void Preprocessor::expandTokens(std::span<const ExpandedToken> tokens, std::vector<ExpandedToken>& result) {
+    size_t floor = this->depth + 1;
+    Context& context = this->pushContext(NO_MACRO);
+    context.tokens.assign(tokens.begin(), tokens.end());
+
+    ExpandedToken token;
+    while(this->nextExpanded(token, floor))
+        result.push_back(token);
+}
+
+// Lexes text made by # or ## from a buffer of its own, giving the tokens the location `loc`.
+std::vector<Token> Preprocessor::lexScratch(std::string_view text, SourceLocation loc) {
+    const SourceBuffer& buffer = this->scratch.emplace_back(text);
+    BasicLexer<PreprocessorLexerPolicy> lexer(buffer, this->compile_info, "<scratch>");
+
+    std::vector<Token> result;
+    for(Token token = lexer.lex(); token.type != TokenType::EOI; token = lexer.lex()) {
+        if(token.type == TokenType::END_OF_DIRECTIVE)
+            continue;
+        if(token.type == TokenType::DIRECTIVE)
+            token.type = TokenType::HASH;
+        token.pos = loc;
+        result.push_back(token);
+    }
+    return result;
+}
+
+Token Preprocessor::stringize(std::span<const ExpandedToken> tokens, SourceLocation loc) {
+    std::string text = "\"";
+    for(size_t i = 0; i < tokens.size(); ++i) {
+        const Token& token = tokens[i].token;
+        if(i > 0 && !isAdjacent(tokens[i - 1].token, token))
+            text += ' ';
+
+        bool literal = token.type == TokenType::LITERAL_STRING || token.type == TokenType::LITERAL_CHAR;
+        for(char c : token.raw) {
+            if(literal && (c == '"' || c == '\\'))
+                text += '\\';
+            text += c;
+        }
+    }
+    text += '"';
+
+    std::vector<Token> result = this->lexScratch(text, loc);
+    return result.at(0);
+}
+
+// Pastes the first of `rhs` to the last token of `result`, and appends the rest.
+void Preprocessor::paste(std::vector<ExpandedToken>& result, std::span<const ExpandedToken> rhs, SourceLocation loc) {
+    if(rhs.empty())
+        return;
+    if(result.empty()) {
+        result.insert(result.end(), rhs.begin(), rhs.end());
+        return;
+    }
+
+    const Token& lhs = result.back().token;
+    std::string text = std::string(lhs.raw) + std::string(rhs[0].token.raw);
+    std::vector<Token> tokens = this->lexScratch(text, loc);
+    if(tokens.size() != 1) {
+        this->compile_info.diagnostics.error(loc, "pasting \"" + std::string(lhs.raw) + "\" and \"" + std::string(rhs[0].token.raw) +
+            "\" does not give a valid preprocessing token");
+        result.insert(result.end(), rhs.begin(), rhs.end());
+        return;
+    }
+
+    result.back() = {tokens[0], false};
+    result.insert(result.end(), rhs.begin() + 1, rhs.end());
+}
@@ -1,4 +1,5 @@
 #include "unicode.hpp"
+#include "xid_tables.hpp"
 
 #include <ostream>
 #include <cassert>
@@ -55,6 +56,20 @@ bool CodePoint::isValidUtf8() const {
     return !((this->value >= 0xD800 && this->value <= 0xDFFF) || this->value >= 0x110000); 
 }
 
+bool CodePoint::isXidStart() const {
+    if(this->value > 0x10FFFF)
+        return false;
+    const uint64_t* block = XID_START_BLOCKS[XID_START_INDEX[this->value >> XID_BLOCK_BITS]];
+    return (block[(this->value >> 6) & 3] >> (this->value & 63)) & 1;
+}
+
+bool CodePoint::isXidContinue() const {
+    if(this->value > 0x10FFFF)
+        return false;
+    const uint64_t* block = XID_CONTINUE_BLOCKS[XID_CONTINUE_INDEX[this->value >> XID_BLOCK_BITS]];
+    return (block[(this->value >> 6) & 3] >> (this->value & 63)) & 1;
+}
+
 std::ostream& operator<<(std::ostream& os, CodePoint::ToUtf8 cp) {
     for(auto c : cp) {
         os << c;
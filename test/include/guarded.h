@@ -0,0 +1,6 @@
+#ifndef GUARDED_H
+#define GUARDED_H
+
+#define SQUARE(x) ((x) * (x))
+
+#endif
@@ -0,0 +1,3 @@
+#pragma once
+
+#define TWICE(x) (2 * (x))
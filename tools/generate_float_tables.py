@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+# Generates the table of 128-bit approximations of powers of five used by the
+# Eisel-Lemire floating point literal conversion in src/lexer/float_literal.cpp.
+#
+# For every q in [SMALLEST, LARGEST], the table holds the 128 most significant bits
+# of 5^q, normalized so that the top bit is set. Positive powers are truncated and
+# negative powers are rounded up, as required by the algorithm.
+
+import sys
+
+SMALLEST = -342
+LARGEST = 308
+
+
+def power_of_five_128(q):
+    if q >= 0:
+        power = 5 ** q
+        while power < 1 << 127:
+            power *= 2
+        while power >= 1 << 128:
+            power //= 2
+        return power
+
+    power = 5 ** -q
+    z = power.bit_length()
+    b = 2 * z + 2 * 64 if q < -27 else z + 127
+    c = 2 ** b // power + 1
+    while c >= 1 << 128:
+        c //= 2
+    return c
+
+
+def main():
+    out = sys.stdout if len(sys.argv) < 2 else open(sys.argv[1], 'w')
+    out.write('// Generated by tools/generate_float_tables.py, do not edit.\n')
+    out.write('#ifndef _QUETZALCOATL_LEXER_FLOAT_TABLES_HPP\n')
+    out.write('#define _QUETZALCOATL_LEXER_FLOAT_TABLES_HPP\n\n')
+    out.write('#include <cstdint>\n\n')
+    out.write(f'constexpr int SMALLEST_POWER_OF_FIVE = {SMALLEST};\n')
+    out.write(f'constexpr int LARGEST_POWER_OF_FIVE = {LARGEST};\n\n')
+    out.write('// High and low 64 bits of each power, starting at SMALLEST_POWER_OF_FIVE.\n')
+    out.write('constexpr uint64_t POWERS_OF_FIVE_128[] = {\n')
+    for q in range(SMALLEST, LARGEST + 1):
+        power = power_of_five_128(q)
+        out.write(f'    0x{power >> 64:016x}, 0x{power & ((1 << 64) - 1):016x},\n')
+    out.write('};\n\n')
+    out.write('#endif\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# Generates the two-stage lookup tables for the UAX #31 XID_Start and XID_Continue
+# properties used by identifiers, see src/unicode.cpp.
+#
+# The properties are taken from Python's own identifier rules (PEP 3131), which are
+# defined as XID_Start and XID_Continue of the Unicode version of the interpreter.
+#
+# Code points are split into blocks of 256. The first stage maps the block number to
+# an index into the second stage, which holds each distinct block once as a bitmap.
+
+import sys
+import unicodedata
+
+MAX_CODE_POINT = 0x10FFFF
+BLOCK_BITS = 8
+BLOCK_SIZE = 1 << BLOCK_BITS
+NUM_BLOCKS = (MAX_CODE_POINT + 1) // BLOCK_SIZE
+
+
+def is_xid_start(cp):
+    c = chr(cp)
+    return c != '_' and c.isidentifier()
+
+
+def is_xid_continue(cp):
+    return ('a' + chr(cp)).isidentifier()
+
+
+def build(predicate):
+    index = []
+    blocks = []
+    seen = {}
+    for block in range(NUM_BLOCKS):
+        bits = 0
+        for offset in range(BLOCK_SIZE):
+            if predicate(block * BLOCK_SIZE + offset):
+                bits |= 1 << offset
+        words = tuple((bits >> (64 * i)) & ((1 << 64) - 1) for i in range(BLOCK_SIZE // 64))
+        if words not in seen:
+            seen[words] = len(blocks)
+            blocks.append(words)
+        index.append(seen[words])
+    assert len(blocks) <= 256
+    return index, blocks
+
+
+def write_table(out, name, predicate):
+    index, blocks = build(predicate)
+    out.write(f'constexpr uint8_t {name}_INDEX[{len(index)}] = {{\n')
+    for i in range(0, len(index), 16):
+        out.write('    ' + ', '.join(str(x) for x in index[i:i + 16]) + ',\n')
+    out.write('};\n\n')
+    out.write(f'constexpr uint64_t {name}_BLOCKS[{len(blocks)}][{BLOCK_SIZE // 64}] = {{\n')
+    for words in blocks:
+        out.write('    {' + ', '.join(f'0x{w:016x}' for w in words) + '},\n')
+    out.write('};\n\n')
+
+
+def main():
+    out = sys.stdout if len(sys.argv) < 2 else open(sys.argv[1], 'w')
+    out.write('// Generated by tools/generate_xid_tables.py, do not edit.\n')
+    out.write('#ifndef _QUETZALCOATL_XID_TABLES_HPP\n')
+    out.write('#define _QUETZALCOATL_XID_TABLES_HPP\n\n')
+    out.write('#include <cstdint>\n\n')
+    out.write(f'// Unicode {unicodedata.unidata_version}\n')
+    out.write(f'constexpr int XID_BLOCK_BITS = {BLOCK_BITS};\n\n')
+    write_table(out, 'XID_START', is_xid_start)
+    write_table(out, 'XID_CONTINUE', is_xid_continue)
+    out.write('#endif\n')
+
+
+if __name__ == '__main__':
+    main()